@@ -0,0 +1,636 @@
+﻿#include "FRTBendKernel.h"
+
+#include "Math/FRTSimd.h"
+#include "FRTGraphColoring.h"
+#include "RTClothMesh.h"
+
+using RTCloth::Simd::Width;
+
+FRTBendKernel::FRTBendKernel()
+{
+	SetParams(0, 0);
+}
+
+void FRTBendKernel::Reset(int32 Num, float InitTheta)
+{
+	for (auto *Arr : {&I0, &I1, &I2, &I3})
+	{
+		Arr->Reset(Num);
+	}
+	L.Reset(Num);
+	ColorOffsets.Reset();
+	BatchValid.Reset();
+	Conditions.Reset();
+	ConditionOffsets.Reset();
+	NumOfHinges = 0;
+	Theta_0 = InitTheta;
+}
+
+void FRTBendKernel::Add(uint32 V0, uint32 V1, uint32 V2, uint32 V3, TArray<FVector2D> const& UV)
+{
+	I0.Add(V0);
+	I1.Add(V1);
+	I2.Add(V2);
+	I3.Add(V3);
+	L.Add((UV[V1] - UV[V2]).Size());
+	NumOfHinges ++;
+}
+
+void FRTBendKernel::Finalize(int32 NumOfVertices)
+{
+	// hinges of one color share no vertex
+	TArray<uint32> HingeVertices;
+	HingeVertices.Reserve(4 * NumOfHinges);
+	for (int32 i = 0; i < NumOfHinges; i ++)
+	{
+		HingeVertices.Add(I0[i]);
+		HingeVertices.Add(I1[i]);
+		HingeVertices.Add(I2[i]);
+		HingeVertices.Add(I3[i]);
+	}
+	FRTGraphColoring Coloring;
+	Coloring.Build(HingeVertices, 4, NumOfVertices);
+
+	if (!RTCloth::Simd::HasAVX2())
+	{
+		ConditionOffsets = Coloring.Offsets;
+		Conditions.Reset(NumOfHinges);
+		for (int32 const i : Coloring.Order)
+		{
+			Conditions.Add({uint32(I0[i]), uint32(I1[i]), uint32(I2[i]), uint32(I3[i]), Theta_0});
+		}
+	}
+
+	// lay out hinges in color order, pad each color to whole batches
+	TArray<int32> const Src[4] = {MoveTemp(I0), MoveTemp(I1), MoveTemp(I2), MoveTemp(I3)};
+	TArray<float> const SrcL = MoveTemp(L);
+	TArray<int32> *Dst[4] = {&I0, &I1, &I2, &I3};
+	int32 const Padded = NumOfHinges + Coloring.NumOfColors() * (Width - 1);
+	for (auto *Arr : Dst)
+	{
+		Arr->Reset(Padded);
+	}
+	L.Reset(Padded);
+	ColorOffsets.Reset(Coloring.NumOfColors() + 1);
+	BatchValid.Reset(Padded / Width);
+	ColorOffsets.Add(0);
+	for (int32 c = 0; c < Coloring.NumOfColors(); c ++)
+	{
+		int32 const Begin = Coloring.Offsets[c], End = Coloring.Offsets[c + 1];
+		int32 const NumInColor = End - Begin;
+		int32 const PaddedNum = (NumInColor + Width - 1) / Width * Width;
+		for (int32 k = 0; k < PaddedNum; k ++)
+		{
+			int32 const i = Coloring.Order[std::min(Begin + k, End - 1)];
+			for (int32 j = 0; j < 4; j ++)
+			{
+				Dst[j]->Add(Src[j][i]);
+			}
+			L.Add(SrcL[i]);
+		}
+		for (int32 k = 0; k < PaddedNum; k += Width)
+		{
+			BatchValid.Add(uint8(std::min(Width, NumInColor - k)));
+		}
+		ColorOffsets.Add(I0.Num());
+	}
+
+	HingeEnergy.SetNumZeroed(RTCloth::Simd::HasAVX2() ? I0.Num() : Conditions.Num());
+	KScale.Init(1.f, I0.Num());
+	DScale.Init(1.f, I0.Num());
+	// conditions are in color order like the padded hinges, condition k of color c is hinge ColorOffsets[c] + k
+	ConditionHinges.Reset(Conditions.Num());
+	for (int32 c = 0; c < ConditionOffsets.Num() - 1; c ++)
+	{
+		for (int32 i = ConditionOffsets[c]; i < ConditionOffsets[c + 1]; i ++)
+		{
+			ConditionHinges.Add(ColorOffsets[c] + i - ConditionOffsets[c]);
+		}
+	}
+	ScatterMode = ERTScatterMode::Coloring;
+	if (RTCloth::Simd::HasAVX2())
+	{
+		PrivateBuffers.Init(I0.Num(), NumOfVertices, Width);
+	}
+	else
+	{
+		PrivateBuffers.Init(Conditions.Num(), NumOfVertices);
+	}
+}
+
+void FRTBendKernel::SetParams(float InK, float InD)
+{
+	K = InK;
+	D = InD;
+	ComputePass = D != 0 ? &FRTBendKernel::Compute<true> : &FRTBendKernel::Compute<false>;
+}
+
+void FRTBendKernel::SetScaleMaps(TArray<float> const& VertexK, TArray<float> const& VertexD)
+{
+	for (int32 T = 0; T < I0.Num(); T ++)
+	{
+		KScale[T] = VertexK.Num() > 0 ? 0.5f * (VertexK[I1[T]] + VertexK[I2[T]]) : 1.f;
+		DScale[T] = VertexD.Num() > 0 ? 0.5f * (VertexD[I1[T]] + VertexD[I2[T]]) : 1.f;
+	}
+}
+
+float FRTBendKernel::LastEnergy() const
+{
+	double Sum = 0;
+	if (Conditions.Num() > 0)
+	{
+		for (float const E : HingeEnergy)
+		{
+			Sum += E;
+		}
+		return float(Sum);
+	}
+	// skip padded lanes
+	for (int32 b = 0; b < BatchValid.Num(); b ++)
+	{
+		for (int32 T = b * Width; T < b * Width + BatchValid[b]; T ++)
+		{
+			Sum += HingeEnergy[T];
+		}
+	}
+	return float(Sum);
+}
+
+void FRTBendKernel::SelectScatterMode(TArray<FVector> const& X, TArray<FVector2D> const& UV, TOptional<ERTScatterMode> const& Pinned)
+{
+	if (Pinned.IsSet())
+	{
+		ScatterMode = Pinned.GetValue();
+	}
+	else
+	{
+		TArray<FVector> V, F;
+		V.SetNumZeroed(X.Num());
+		F.SetNumZeroed(X.Num());
+		ScatterMode = PickFasterScatterMode([&](ERTScatterMode Mode)
+		{
+			ScatterMode = Mode;
+			ComputeForces(X, V, UV, F);
+		});
+	}
+	if (ScatterMode == ERTScatterMode::Coloring)
+	{
+		PrivateBuffers.Reset();
+	}
+	UE_LOG(LogRTCloth, Log, TEXT("Bend kernel: %d hinges, %d colors, scatter by %s (%s)"), NumOfHinges, ColorOffsets.Num() - 1,
+		ScatterMode == ERTScatterMode::Coloring ? TEXT("coloring") : TEXT("private buffers"), Pinned.IsSet() ? TEXT("pinned") : TEXT("timed"));
+}
+
+#if RTCLOTH_WITH_AVX2
+using namespace RTCloth::Simd;
+
+struct FHingeArrays
+{
+	int32 const *I0, *I1, *I2, *I3;
+	float const *L, *KScale, *DScale;
+};
+
+// per batch results, [vertex][component][lane]
+struct FBendForceBatch
+{
+	alignas(32) float F[4][3][Width];
+};
+
+// per batch Hessian blocks, [vertex m][vertex n][3 * i + j][lane]
+struct FBendHessianBatch
+{
+	alignas(32) float DFDX[4][4][9][Width];
+	alignas(32) float DDDX[4][4][9][Width];
+	alignas(32) float DDDV[4][4][9][Width];
+};
+
+// 3x3 matrices in lanes
+struct FMat8
+{
+	FFloat8 M[9];
+};
+
+RTCLOTH_AVX2_FUNC static FORCEINLINE FMat8 MatZero()
+{
+	FMat8 Res;
+	for (int32 i = 0; i < 9; i ++) Res.M[i] = Zero();
+	return Res;
+}
+
+// A x B^T
+RTCLOTH_AVX2_FUNC static FORCEINLINE FMat8 Outer(FVec8 const& A, FVec8 const& B)
+{
+	FMat8 Res;
+	for (int32 i = 0; i < 3; i ++)
+		for (int32 j = 0; j < 3; j ++)
+			Res.M[3 * i + j] = Mul(Component(A, i), Component(B, j));
+	return Res;
+}
+
+// A * S + B
+RTCLOTH_AVX2_FUNC static FORCEINLINE FMat8 MatScaleAdd(FMat8 const& A, FFloat8 const S, FMat8 const& B)
+{
+	FMat8 Res;
+	for (int32 i = 0; i < 9; i ++) Res.M[i] = MulAdd(A.M[i], S, B.M[i]);
+	return Res;
+}
+
+RTCLOTH_AVX2_FUNC static FORCEINLINE void StoreMat(float Out[9][Width], FMat8 const& A, FFloat8 const S)
+{
+	for (int32 i = 0; i < 9; i ++) Store(Out[i], Mul(A.M[i], S));
+}
+
+// refer to FRTBendCondition::UpdateCondition and FRTBendCondition::ComputeDerivatives, same math in lanes.
+// without damping the velocities are not gathered and the damping blocks are not computed
+template <bool bDamping>
+RTCLOTH_AVX2_FUNC static void BendBatchAVX2(
+	FHingeArrays const& Arr, int32 T, FVector const* X, FVector const* V,
+	float K, float D, float Theta0,
+	FBendForceBatch &Out, float *Energy, FBendHessianBatch *Hessian)
+{
+	FInt8 const Idx[4] = {
+		Times3(Load(Arr.I0 + T)), Times3(Load(Arr.I1 + T)),
+		Times3(Load(Arr.I2 + T)), Times3(Load(Arr.I3 + T))
+	};
+	FVec8 const X0 = Gather(X, Idx[0]), X1 = Gather(X, Idx[1]), X2 = Gather(X, Idx[2]), X3 = Gather(X, Idx[3]);
+	FFloat8 const One = Set1(1.f);
+
+	// get edge vectors
+	FVec8 const E01 = Sub(X1, X0);
+	FVec8 const E02 = Sub(X2, X0);
+	FVec8 const E32 = Sub(X2, X3);
+	FVec8 const E31 = Sub(X1, X3);
+	FVec8 const E21 = Sub(X1, X2);
+
+	// get normalized edge vectors
+	FVec8 const NE01 = Normalize(E01);
+	FVec8 const NE02 = Normalize(E02);
+	FVec8 const NE32 = Normalize(E32);
+	FVec8 const NE31 = Normalize(E31);
+	FVec8 const NE21 = Normalize(E21);
+
+	// Get Cosine Value at each vertex
+	FFloat8 const c01 = Dot(NE01, NE21);
+	FFloat8 const c02 = Neg(Dot(NE02, NE21));
+	FFloat8 const c11 = Dot(NE21, NE31);
+	FFloat8 const c12 = Neg(Dot(NE32, NE21));
+
+	// normalized triangle normals:
+	FVec8 const n0 = Normalize(Cross(NE21, NE01));
+	FVec8 const n1 = Normalize(Cross(NE32, NE21));
+
+	// normalized bi-normals:
+	FVec8 const b00 = Normalize(Sub(NE01, Scale(NE21, Dot(NE21, NE01))));
+	FVec8 const b01 = Normalize(Sub(Scale(NE02, Dot(NE02, NE01)), NE01));
+	FVec8 const b02 = Normalize(Sub(Scale(NE01, Dot(NE01, NE02)), NE02));
+	FVec8 const b13 = Normalize(Sub(NE32, Scale(NE21, Dot(NE21, NE32))));
+	FVec8 const b12 = Normalize(Sub(Scale(NE31, Dot(NE31, NE32)), NE32));
+	FVec8 const b11 = Normalize(Sub(Scale(NE32, Dot(NE32, NE31)), NE31));
+
+	// triangle heights at each vertex
+	FFloat8 const d00 = Dot(b00, E01);
+	FFloat8 const d01 = Neg(Dot(b01, E21));
+	FFloat8 const d02 = Neg(Dot(b02, E02));
+	FFloat8 const d11 = Neg(Dot(b11, E31));
+	FFloat8 const d12 = Dot(b12, E21);
+	FFloat8 const d13 = Dot(b13, E31);
+
+	// angle between triangles
+	FFloat8 const Theta = Sub(Atan2(Dot(n1, b00), Dot(n0, n1)), Set1(Theta0));
+
+	// derivatives of theta with respect to the different vertex positions:
+	FVec8 const G[4] = {
+		Scale(n0, Neg(Div(One, d00))),
+		ScaleAdd(n0, Div(c02, d01), Scale(n1, Div(c12, d11))),
+		ScaleAdd(n0, Div(c01, d02), Scale(n1, Div(c11, d12))),
+		Scale(n1, Neg(Div(One, d13)))
+	};
+
+	// derivatives of theta with time
+	FFloat8 dTheta_dt = Zero();
+	if (bDamping)
+	{
+		for (int32 m = 0; m < 4; m ++)
+		{
+			dTheta_dt = Add(dTheta_dt, Dot(G[m], Gather(V, Idx[m])));
+		}
+	}
+
+	FFloat8 const Len = Load(Arr.L + T);
+	FFloat8 const KL = Mul(Mul(Set1(K), Load(Arr.KScale + T)), Len);
+	FFloat8 const DL = Mul(Mul(Set1(D), Load(Arr.DScale + T)), Len);
+
+	// f_m = -(K * L * theta + D * L * dTheta/dt) * dTheta/dX_m
+	FFloat8 const KLTheta = Mul(KL, Theta);
+	FFloat8 const S = Neg(bDamping ? MulAdd(DL, dTheta_dt, KLTheta) : KLTheta);
+	Store(Energy, Mul(Set1(0.5f), Mul(KLTheta, Theta)));
+	for (int32 m = 0; m < 4; m ++)
+	{
+		Store(Out.F[m][0], Out.F[m][1], Out.F[m][2], Scale(G[m], S));
+	}
+
+	if (!Hessian) return;
+
+	// derivatives of normal with respect to the different vertex positions:
+	FMat8 const dn0[4] = {MatScaleAdd(Outer(b00, n0), Div(One, d00), MatZero()), MatScaleAdd(Outer(b01, n0), Div(One, d01), MatZero()),
+		MatScaleAdd(Outer(b02, n0), Div(One, d02), MatZero()), MatZero()};
+	FMat8 const dn1[4] = {MatZero(), MatScaleAdd(Outer(b11, n1), Div(One, d11), MatZero()),
+		MatScaleAdd(Outer(b12, n1), Div(One, d12), MatZero()), MatScaleAdd(Outer(b13, n1), Div(One, d13), MatZero())};
+
+	FFloat8 const iE01 = Div(One, Dot(E01, E01));
+	FFloat8 const iE02 = Div(One, Dot(E02, E02));
+	FFloat8 const iE21 = Div(One, Dot(E21, E21));
+	FFloat8 const iE31 = Div(One, Dot(E31, E31));
+	FFloat8 const iE32 = Div(One, Dot(E32, E32));
+	FVec8 const Zero3 = ZeroVec();
+
+	// derivatives of the cosines:
+	FVec8 dc01[4], dc02[4], dc11[4], dc12[4];
+	dc01[0] = Scale(b02, Neg(Mul(Dot(b00, E01), iE01)));
+	dc01[2] = Scale(b00, Neg(Mul(Dot(b02, E21), iE21)));
+	dc01[1] = Neg(Add(dc01[0], dc01[2]));
+	dc01[3] = Zero3;
+
+	dc02[0] = Scale(b01, Neg(Mul(Dot(b00, E02), iE02)));
+	dc02[1] = Scale(b00, Mul(Dot(b01, E21), iE21));
+	dc02[2] = Neg(Add(dc02[0], dc02[1]));
+	dc02[3] = Zero3;
+
+	dc11[0] = Zero3;
+	dc11[2] = Scale(b13, Neg(Mul(Dot(b12, E21), iE21)));
+	dc11[3] = Scale(b12, Neg(Mul(Dot(b13, E31), iE31)));
+	dc11[1] = Neg(Add(dc11[2], dc11[3]));
+
+	dc12[0] = Zero3;
+	dc12[1] = Scale(b13, Mul(Dot(b11, E21), iE21));
+	dc12[3] = Scale(b11, Neg(Mul(Dot(b13, E32), iE32)));
+	dc12[2] = Neg(Add(dc12[1], dc12[3]));
+
+	// derivatives of the height:
+	FVec8 const dd00[4] = {Neg(b00), Scale(b00, Neg(Mul(Dot(E21, E02), iE21))), Scale(b00, Mul(Dot(E21, E01), iE21)), Zero3};
+	FVec8 const dd01[4] = {Scale(b01, Neg(Mul(Dot(E02, E21), iE02))), Neg(b01), Scale(b01, Mul(Dot(E02, E01), iE02)), Zero3};
+	FVec8 const dd02[4] = {Scale(b02, Mul(Dot(E01, E21), iE01)), Scale(b02, Mul(Dot(E01, E02), iE01)), Neg(b02), Zero3};
+	FVec8 const dd11[4] = {Zero3, Neg(b11), Scale(b11, Mul(Dot(E32, E31), iE32)), Scale(b11, Neg(Mul(Dot(E32, E21), iE32)))};
+	FVec8 const dd12[4] = {Zero3, Scale(b12, Mul(Dot(E31, E32), iE31)), Neg(b12), Scale(b12, Mul(Dot(E31, E21), iE31))};
+	FVec8 const dd13[4] = {Zero3, Scale(b13, Neg(Mul(Dot(E21, E32), iE21))), Scale(b13, Mul(Dot(E21, E31), iE21)), Neg(b13)};
+
+	FFloat8 const i_d00 = Div(One, d00), i_d13 = Div(One, d13);
+	FFloat8 const i_d01 = Div(One, d01), i_d11 = Div(One, d11);
+	FFloat8 const i_d02 = Div(One, d02), i_d12 = Div(One, d12);
+	FFloat8 const NegKL = Neg(KL), NegDL = Neg(DL);
+	FFloat8 const NegDL_dTheta_dt = Mul(NegDL, dTheta_dt);
+
+	for (int32 j = 0; j < 4; j ++)
+	{
+		// second derivatives of theta:
+		FMat8 H[4];
+		H[0] = MatScaleAdd(Outer(n0, dd00[j]), Mul(i_d00, i_d00), MatScaleAdd(dn0[j], Neg(i_d00), MatZero()));
+		H[3] = MatScaleAdd(Outer(n1, dd13[j]), Mul(i_d13, i_d13), MatScaleAdd(dn1[j], Neg(i_d13), MatZero()));
+
+		H[1] = MatScaleAdd(dn0[j], Mul(c02, i_d01), MatZero());
+		H[1] = MatScaleAdd(Outer(n0, Sub(Scale(dc02[j], d01), Scale(dd01[j], c02))), Mul(i_d01, i_d01), H[1]);
+		H[1] = MatScaleAdd(dn1[j], Mul(c12, i_d11), H[1]);
+		H[1] = MatScaleAdd(Outer(n1, Sub(Scale(dc12[j], d11), Scale(dd11[j], c12))), Mul(i_d11, i_d11), H[1]);
+
+		H[2] = MatScaleAdd(dn0[j], Mul(c01, i_d02), MatZero());
+		H[2] = MatScaleAdd(Outer(n0, Sub(Scale(dc01[j], d02), Scale(dd02[j], c01))), Mul(i_d02, i_d02), H[2]);
+		H[2] = MatScaleAdd(dn1[j], Mul(c11, i_d12), H[2]);
+		H[2] = MatScaleAdd(Outer(n1, Sub(Scale(dc11[j], d12), Scale(dd12[j], c11))), Mul(i_d12, i_d12), H[2]);
+
+		for (int32 m = 0; m < 4; m ++)
+		{
+			FMat8 const GG = Outer(G[m], G[j]);
+			// dfdx = -K * L * (theta * d2Theta/dXmdXj + dTheta/dXm x dTheta/dXj)
+			StoreMat(Hessian->DFDX[m][j], MatScaleAdd(H[m], Theta, GG), NegKL);
+			if (!bDamping) continue;
+			// dddv = -D * L * dTheta/dXm x dTheta/dXj
+			StoreMat(Hessian->DDDV[m][j], GG, NegDL);
+			// dddx = -D * L * dTheta/dt * d2Theta/dXmdXj
+			StoreMat(Hessian->DDDX[m][j], H[m], NegDL_dTheta_dt);
+		}
+	}
+}
+#endif
+
+void FRTBendKernel::ComputeForces(
+	TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector2D> const& UV,
+	TArray<FVector> &Forces)
+{
+	(this->*ComputePass)(X, V, UV, Forces, nullptr, nullptr, nullptr);
+}
+
+void FRTBendKernel::ComputeForcesAndDerivatives(
+	TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector2D> const& UV,
+	TArray<FVector> &Forces,
+	FRTBBSSMatrix<float> &dfdx,
+	FRTBBSSMatrix<float> &dddx,
+	FRTBBSSMatrix<float> &dddv)
+{
+	(this->*ComputePass)(X, V, UV, Forces, &dfdx, &dddx, &dddv);
+}
+
+template <bool bDamping>
+void FRTBendKernel::Compute(
+	TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector2D> const& UV,
+	TArray<FVector> &Forces,
+	FRTBBSSMatrix<float> *dfdx,
+	FRTBBSSMatrix<float> *dddx,
+	FRTBBSSMatrix<float> *dddv)
+{
+	bool const bWithDerivatives = dfdx != nullptr;
+	// matrices without a locked pattern insert new entries, which must not happen in parallel
+	bool const bSingleThread = bWithDerivatives &&
+		(!dfdx->IsPatternLocked() || !dddx->IsPatternLocked() || !dddv->IsPatternLocked());
+	// private buffers only for forces, Hessian blocks are always assembled by color
+	bool const bPrivateBuffers = !bWithDerivatives && ScatterMode == ERTScatterMode::PrivateBuffers;
+	// the implicit integrator passes the same matrix as dfdx and dddx, add both in one lookup
+	bool const bSameDX = dfdx == dddx;
+#if RTCLOTH_WITH_AVX2
+	if (RTCloth::Simd::HasAVX2())
+	{
+		FHingeArrays const Arr{I0.GetData(), I1.GetData(), I2.GetData(), I3.GetData(), L.GetData(), KScale.GetData(), DScale.GetData()};
+		auto const Body = [&](int32 Begin, int32 End, TArray<FVector> &Out)
+		{
+			FBendForceBatch Batch;
+			// on the stack like the force batch, only filled when derivatives are wanted
+			FBendHessianBatch HessianBatch;
+			FBendHessianBatch *const Hessian = bWithDerivatives ? &HessianBatch : nullptr;
+			for (int32 T = Begin; T < End; T += Width)
+			{
+				BendBatchAVX2<bDamping>(Arr, T, X.GetData(), V.GetData(), K, D, Theta_0, Batch, HingeEnergy.GetData() + T, Hessian);
+				// skip padded lanes
+				int32 const Valid = BatchValid[T / Width];
+				for (int32 l = 0; l < Valid; l ++)
+				{
+					int32 const Idx[4] = {I0[T + l], I1[T + l], I2[T + l], I3[T + l]};
+					for (int32 m = 0; m < 4; m ++)
+					{
+						Out[Idx[m]] += FVector(Batch.F[m][0][l], Batch.F[m][1][l], Batch.F[m][2][l]);
+					}
+					if (!bWithDerivatives) continue;
+					// fill in
+					for (int32 m = 0; m < 4; m ++)
+					{
+						for (int32 n = 0; n < 4; n ++)
+						{
+							for (int32 i = 0; i < 3; i ++)
+							{
+								for (int32 j = 0; j < 3; j ++)
+								{
+									uint32 const Row = 3 * Idx[m] + i, Col = 3 * Idx[n] + j;
+									int32 const E = 3 * i + j;
+									if (!bDamping)
+									{
+										(*dfdx)[Row][Col] += Hessian->DFDX[m][n][E][l];
+									}
+									else if (bSameDX)
+									{
+										(*dfdx)[Row][Col] += Hessian->DFDX[m][n][E][l] + Hessian->DDDX[m][n][E][l];
+										(*dddv)[Row][Col] += Hessian->DDDV[m][n][E][l];
+									}
+									else
+									{
+										(*dfdx)[Row][Col] += Hessian->DFDX[m][n][E][l];
+										(*dddx)[Row][Col] += Hessian->DDDX[m][n][E][l];
+										(*dddv)[Row][Col] += Hessian->DDDV[m][n][E][l];
+									}
+								}
+							}
+						}
+					}
+				}
+			}
+		};
+		if (bPrivateBuffers)
+		{
+			PrivateBuffers.Run(Forces, Body);
+			return;
+		}
+		// hinges of one color share no vertex, chunks of a color scatter without races
+		FRTGraphColoring::ParallelForEachColor(ColorOffsets, ChunkSize, [&](int32, int32 Begin, int32 End)
+		{
+			Body(Begin, End, Forces);
+		}, bSingleThread);
+		return;
+	}
+#endif
+	auto const Body = [&](int32 Begin, int32 End, TArray<FVector> &Out)
+	{
+		for (int32 i = Begin; i < End; i ++)
+		{
+			auto &Con = Conditions[i];
+			Con.UpdateCondition(X, V, UV);
+			float const HingeK = KScale[ConditionHinges[i]] * K, HingeD = DScale[ConditionHinges[i]] * D;
+			Con.ComputeForces(HingeK, HingeD, Out, Out);
+			HingeEnergy[i] = Con.Energy(HingeK);
+			if (bWithDerivatives)
+			{
+				Con.ComputeDerivatives(HingeK, HingeD, *dfdx, *dddx, *dddv);
+			}
+		}
+	};
+	if (bPrivateBuffers)
+	{
+		PrivateBuffers.Run(Forces, Body);
+		return;
+	}
+	FRTGraphColoring::ParallelForEachColor(ConditionOffsets, ChunkSize, [&](int32, int32 Begin, int32 End)
+	{
+		Body(Begin, End, Forces);
+	}, bSingleThread);
+}
+
+float FRTBendKernel::CompareWithConditions(FClothRawMesh *Mesh, float &DerivativeError)
+{
+	// bend the cloth a bit, relative to the mean length of the shared edges
+	float EdgeLength = 0;
+	for (int32 b = 0; b < BatchValid.Num(); b ++)
+	{
+		for (int32 T = b * Width; T < b * Width + BatchValid[b]; T ++)
+		{
+			EdgeLength += (Mesh->Positions[I1[T]] - Mesh->Positions[I2[T]]).Size();
+		}
+	}
+	EdgeLength = NumOfHinges > 0 ? EdgeLength / NumOfHinges : 1.f;
+	TArray<FVector> X = Mesh->Positions, V;
+	V.SetNumZeroed(X.Num());
+	for (int32 i = 0; i < X.Num(); i ++)
+	{
+		X[i] += 0.2f * EdgeLength * FVector(0.3f * FMath::Sin(0.71f * i), 0.3f * FMath::Cos(0.53f * i), FMath::Sin(0.37f * i));
+		V[i] = FVector(FMath::Cos(0.11f * i), FMath::Sin(0.23f * i), 0.5f);
+	}
+
+	// forces of both variants, compared with FRTBendCondition
+	float const SavedK = K, SavedD = D;
+	float MaxForce = 0, MaxDiff = 0, EnergyError = 0;
+	for (float const Damping : {1.f, 0.f})
+	{
+		TArray<FVector> Expected, Actual;
+		Expected.SetNumZeroed(X.Num());
+		Actual.SetNumZeroed(X.Num());
+		double ExpectedEnergy = 0;
+		for (int32 b = 0; b < BatchValid.Num(); b ++)
+		{
+			for (int32 T = b * Width; T < b * Width + BatchValid[b]; T ++)
+			{
+				FRTBendCondition Con(I0[T], I1[T], I2[T], I3[T], Theta_0);
+				Con.UpdateCondition(X, V, Mesh->TexCoords);
+				Con.ComputeForces(KScale[T], DScale[T] * Damping, Expected, Expected);
+				ExpectedEnergy += Con.Energy(KScale[T]);
+			}
+		}
+		SetParams(1, Damping);
+		ComputeForces(X, V, Mesh->TexCoords, Actual);
+		EnergyError = std::max(EnergyError, float(FMath::Abs(LastEnergy() - ExpectedEnergy) / std::max(ExpectedEnergy, 1e-6)));
+
+		for (int32 i = 0; i < X.Num(); i ++)
+		{
+			MaxForce = std::max(MaxForce, Expected[i].GetAbsMax());
+			MaxDiff = std::max(MaxDiff, (Expected[i] - Actual[i]).GetAbsMax());
+		}
+	}
+
+	// dfdx, compared with central differences of the forces along Dir
+	FRTBBSSMatrix<float> dfdx;
+	dfdx.UpdateSize(3 * X.Num());
+	TArray<FVector> Unused;
+	Unused.SetNumZeroed(X.Num());
+	ComputeForcesAndDerivatives(X, V, Mesh->TexCoords, Unused, dfdx, dfdx, dfdx);
+	dfdx.LockPattern();
+
+	TArray<float> Dir, HDir;
+	Dir.SetNumUninitialized(3 * X.Num());
+	HDir.SetNumZeroed(3 * X.Num());
+	for (int32 i = 0; i < Dir.Num(); i ++)
+	{
+		Dir[i] = FMath::Sin(0.17f * i);
+	}
+	dfdx.MulVector(HDir.GetData(), Dir.GetData(), Dir.Num());
+
+	float const h = 1e-2f * EdgeLength;
+	TArray<FVector> XPlus = X, XMinus = X, FPlus, FMinus;
+	FPlus.SetNumZeroed(X.Num());
+	FMinus.SetNumZeroed(X.Num());
+	for (int32 i = 0; i < X.Num(); i ++)
+	{
+		FVector const Step(Dir[3 * i], Dir[3 * i + 1], Dir[3 * i + 2]);
+		XPlus[i] += h * Step;
+		XMinus[i] -= h * Step;
+	}
+	ComputeForces(XPlus, V, Mesh->TexCoords, FPlus);
+	ComputeForces(XMinus, V, Mesh->TexCoords, FMinus);
+	SetParams(SavedK, SavedD);
+
+	float MaxHDir = 0, MaxHDirDiff = 0;
+	for (int32 i = 0; i < X.Num(); i ++)
+	{
+		for (int32 c = 0; c < 3; c ++)
+		{
+			float const Diff = (FPlus[i][c] - FMinus[i][c]) / (2 * h);
+			MaxHDir = std::max(MaxHDir, FMath::Abs(HDir[3 * i + c]));
+			MaxHDirDiff = std::max(MaxHDirDiff, FMath::Abs(Diff - HDir[3 * i + c]));
+		}
+	}
+	DerivativeError = MaxHDir > 0 ? MaxHDirDiff / MaxHDir : MaxHDirDiff;
+	return std::max(MaxForce > 0 ? MaxDiff / MaxForce : MaxDiff, EnergyError);
+}
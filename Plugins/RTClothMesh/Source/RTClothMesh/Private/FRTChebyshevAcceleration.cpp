@@ -0,0 +1,108 @@
+﻿#include "FRTChebyshevAcceleration.h"
+
+#include "Async/ParallelFor.h"
+
+void FRTChebyshevAcceleration::SetParams(float InRho, float InGamma, int32 InDelay, int32 InWarmUpSolves)
+{
+	GivenRho = FMath::Min(InRho, 0.9999f);
+	Gamma = InGamma;
+	Delay = FMath::Max(1, InDelay);
+	WarmUpSolves = FMath::Max(1, InWarmUpSolves);
+	Reset();
+}
+
+void FRTChebyshevAcceleration::Reset()
+{
+	NumOfWarmUps = 0;
+	EstimatedRho = 0;
+	NumOfRefines = 0;
+}
+
+void FRTChebyshevAcceleration::Refine()
+{
+	// an estimate is still being made from plain solves, it goes on with the new system
+	if (IsWarmingUp()) return;
+	NumOfRefines = WarmUpSolves;
+}
+
+void FRTChebyshevAcceleration::BeginSolve(TArray<FVector> const& X)
+{
+	Current = X;
+	Previous = X;
+	Iteration = 0;
+	Omega = 1;
+	Changes.Reset();
+	bLowered = false;
+}
+
+void FRTChebyshevAcceleration::Iterate(TArray<FVector> &X)
+{
+	check(X.Num() == Current.Num());
+	float const Rho = SpectralRadius();
+	bool const bAccelerate = !IsWarmingUp() && Rho > 0 && Iteration >= Delay;
+	if (bAccelerate)
+	{
+		Omega = Iteration == Delay ? 2.f / (2.f - Rho * Rho) : 4.f / (4.f - Rho * Rho * Omega);
+	}
+
+	int32 const NumOfChunks = (X.Num() + ChunkSize - 1) / ChunkSize;
+	TArray<double> ChunkChanges;
+	ChunkChanges.SetNumZeroed(NumOfChunks);
+	ParallelFor(NumOfChunks, [&](int32 Chunk)
+	{
+		int32 const End = FMath::Min(X.Num(), (Chunk + 1) * ChunkSize);
+		double Change = 0;
+		for (int32 i = Chunk * ChunkSize; i < End; i ++)
+		{
+			Change += (X[i] - Current[i]).SizeSquared();
+			if (bAccelerate)
+			{
+				X[i] = Omega * (Gamma * (X[i] - Current[i]) + Current[i] - Previous[i]) + Previous[i];
+			}
+			Previous[i] = Current[i];
+			Current[i] = X[i];
+		}
+		ChunkChanges[Chunk] = Change;
+	});
+	double Change = 0;
+	for (double const C : ChunkChanges)
+	{
+		Change += C;
+	}
+
+	// the recurrence diverges when Rho is too large for this solve, start it again
+	if (bAccelerate && Changes.Num() > 0 && Change > Changes.Last())
+	{
+		Iteration = Delay;
+		Omega = 1;
+		// the estimate of the previous system is too large for the new one, once per solve
+		if (NumOfRefines > 0 && GivenRho <= 0 && !bLowered)
+		{
+			EstimatedRho *= RefineScale;
+			bLowered = true;
+		}
+	}
+	else
+	{
+		Iteration ++;
+	}
+	Changes.Add(Change);
+}
+
+void FRTChebyshevAcceleration::EndSolve()
+{
+	if (NumOfRefines > 0)
+	{
+		NumOfRefines --;
+	}
+	if (!IsWarmingUp()) return;
+	// geometric mean of the decay after the first iteration, which is dominated by the start of the solve
+	int32 const Num = Changes.Num();
+	if (Num < 3 || Changes[1] <= 0 || Changes[Num - 1] <= 0) return;
+	float const Rho = FMath::Sqrt(FMath::Pow(float(Changes[Num - 1] / Changes[1]), 1.f / float(Num - 2)));
+	if (Rho < 1.f)
+	{
+		EstimatedRho = FMath::Max(EstimatedRho, Rho);
+	}
+	NumOfWarmUps ++;
+}
@@ -3,6 +3,8 @@
 #include <unordered_map>
 
 #include <FBVHTree.h>
+#include "Async/ParallelFor.h"
+#include "Math/FRTSimd.h"
 using namespace RTCloth;
 
 DECLARE_STATS_GROUP(TEXT("RTCloth(Collision)"), STATGROUP_RTCloth_Collision, STATCAT_Advanced);
@@ -22,6 +24,18 @@ void FRTClothSystemBase::Init (
 void FRTClothSystemBase::UpdateMaterial(FRTClothPhysicalMaterial<float> const& M)
 {
 	M_Material = M;
+	bWakeUp = true;
+	MaterialUpdated();
+}
+
+float FRTClothSystemBase::KineticEnergy(TArray<FVector> const& Velocities) const
+{
+	float Sum = 0;
+	for (int32 i = 0; i < Masses.Num(); i ++)
+	{
+		Sum += Masses[i] * Velocities[i].SizeSquared();
+	}
+	return 0.5f * Sum;
 }
 
 void FRTClothSystemBase::UpdateMesh(std::shared_ptr<FClothRawMesh> const&AMesh)
@@ -32,6 +46,16 @@ void FRTClothSystemBase::UpdateMesh(std::shared_ptr<FClothRawMesh> const&AMesh)
 
 void FRTClothSystemBase::TickOnce(float Duration)
 {
+    if (bConstraintsChanged)
+    {
+        UpdateConstraintIndex();
+    }
+    if (bMeasureSteps)
+    {
+        StepStartPositions = Mesh->Positions;
+        StepDuration = Duration;
+        StepPenetration = 0;
+    }
     CurrentBox.Max = Mesh->Positions[0];
     CurrentBox.Min = Mesh->Positions[0];
     for (auto &pos: Mesh->Positions)
@@ -45,13 +69,101 @@ void FRTClothSystemBase::TickOnce(float Duration)
 }
 
 
-void FRTClothSystemBase::UpdatePositionDataTo(FRHICommandList &CmdList, FRTDynamicVertexBuffer &DstBuffer)
+#if RTCLOTH_WITH_AVX2
+// returns the first float that is not processed
+RTCLOTH_AVX2_FUNC static int32 BlendAVX2(int32 NumOfFloats, float *Out, float const *P, float const *Q, float WP, float WQ)
+{
+    Simd::FFloat8 const A = Simd::Set1(WP), B = Simd::Set1(WQ);
+    int32 k = 0;
+    for (; k + Simd::Width <= NumOfFloats; k += Simd::Width)
+    {
+        Simd::Store(Out + k, Simd::MulAdd(Simd::Load(Q + k), B, Simd::Mul(Simd::Load(P + k), A)));
+    }
+    return k;
+}
+#endif
+
+// Out = WP * P + WQ * Q over the floats, in parallel chunks
+static void BlendPositions(int32 NumOfFloats, float *Out, float const *P, float const *Q, float WP, float WQ)
+{
+    // floats per task, a multiple of the simd width
+    constexpr int32 ChunkSize = 8192;
+    int32 const NumOfChunks = (NumOfFloats + ChunkSize - 1) / ChunkSize;
+    ParallelFor(NumOfChunks, [&](int32 Chunk)
+    {
+        int32 const Begin = Chunk * ChunkSize;
+        int32 const Num = std::min(ChunkSize, NumOfFloats - Begin);
+        int32 k = 0;
+#if RTCLOTH_WITH_AVX2
+        if (Simd::HasAVX2())
+        {
+            k = BlendAVX2(Num, Out + Begin, P + Begin, Q + Begin, WP, WQ);
+        }
+#endif
+        for (; k < Num; k ++)
+        {
+            Out[Begin + k] = WP * P[Begin + k] + WQ * Q[Begin + k];
+        }
+    }, NumOfChunks == 1);
+}
+
+void FRTClothSystemBase::UpdatePositionDataTo(FRHICommandList &CmdList, FRTDynamicVertexBuffer &DstBuffer, double DisplayTime)
 {
     // default implementation is to copy position into DstBuffer
     check(IsInRenderingThread());
+    if (PositionSnapshots.IsDirty())
+    {
+        // the latest frame becomes the previous one, the arrays of the previous one go back to the simulating thread
+        Swap(PreviousSnapshot, PositionSnapshots.Read());
+        PositionSnapshots.SwapReadBuffers();
+    }
+    FRTPositionSnapshot const& Latest = PositionSnapshots.Read();
+    // nothing to upload before the first frame
+    if (uint32(Latest.Positions.Num() * sizeof(FVector)) < DstBuffer.GetDataSize()) return;
+    int32 const NumOfFloats = DstBuffer.GetDataSize() / sizeof(float);
+
+    // Out = WP * P + WQ * Q
+    float const *P = (float const *)Latest.Positions.GetData();
+    float const *Q = P;
+    float WP = 1, WQ = 0;
+    float const Interval = float(Latest.Time - PreviousSnapshot.Time);
+    bool const bPrevious = PreviousSnapshot.Positions.Num() == Latest.Positions.Num() && Interval > 0;
+    if (RenderSmoothing == ERTRenderSmoothing::Interpolate && bPrevious)
+    {
+        // one frame behind, between the two latest frames
+        float const Alpha = FMath::Clamp(float(DisplayTime - Latest.Time) / Interval, 0.f, 1.f);
+        P = (float const *)PreviousSnapshot.Positions.GetData();
+        Q = (float const *)Latest.Positions.GetData();
+        WP = 1 - Alpha;
+        WQ = Alpha;
+    }
+    else if (RenderSmoothing == ERTRenderSmoothing::Extrapolate)
+    {
+        float const Ahead = FMath::Clamp(float(DisplayTime - Latest.Time), 0.f, MaxExtrapolationTime);
+        if (Latest.Velocities.Num() == Latest.Positions.Num())
+        {
+            Q = (float const *)Latest.Velocities.GetData();
+            WQ = Ahead;
+        }
+        else if (bPrevious)
+        {
+            // velocities from the two latest frames
+            Q = (float const *)PreviousSnapshot.Positions.GetData();
+            WP = 1 + Ahead / Interval;
+            WQ = -Ahead / Interval;
+        }
+    }
+
     // upload to GPU, update position only
     void* VertexBufferData = RHILockVertexBuffer(DstBuffer.VertexBufferRHI, 0, DstBuffer.GetDataSize(), RLM_WriteOnly);
-    FMemory::Memcpy(VertexBufferData, Mesh->Positions.GetData(), DstBuffer.GetDataSize());
+    if (WQ == 0)
+    {
+        FMemory::Memcpy(VertexBufferData, P, DstBuffer.GetDataSize());
+    }
+    else
+    {
+        BlendPositions(NumOfFloats, (float *)VertexBufferData, P, Q, WP, WQ);
+    }
     RHIUnlockVertexBuffer(DstBuffer.VertexBufferRHI);
 }
 
@@ -62,6 +174,17 @@ void FRTClothSystemBase::_UpdateMesh(std::shared_ptr<FClothRawMesh> const&AMesh)
     ExternalForces.SetNumZeroed(Mesh->Positions.Num());
     TriangleBoundingSpheres.SetNumZeroed(Mesh->Indices.Num() / 3);
     MakeDirectedEdgeModel();
+    // each edge once, from the half edge with the lower index
+    EdgeVertices.Reset(other_half_of_edge.Num());
+    for (int32 Edge = 0; Edge < other_half_of_edge.Num(); Edge ++)
+    {
+        if (other_half_of_edge[Edge] == UNKNOWN_HALF_EDGE || other_half_of_edge[Edge] > HalfEdgeRef(Edge))
+        {
+            EdgeVertices.Add(fromVertexIndexOfHalfEdge(Edge));
+            EdgeVertices.Add(toVertexIndexOfHalfEdge(Edge));
+        }
+    }
+    StepStartPositions.Reset();
 
     // update masses
     for (int32 FaceID = 0; FaceID < Mesh->Indices.Num(); FaceID += 3)
@@ -76,6 +199,14 @@ void FRTClothSystemBase::_UpdateMesh(std::shared_ptr<FClothRawMesh> const&AMesh)
         Masses[V1] += Mass / 3;
         Masses[V2] += Mass / 3;
     }
+    InverseMasses.SetNumUninitialized(Masses.Num());
+    for (int32 i = 0; i < Masses.Num(); i ++)
+    {
+        InverseMasses[i] = Masses[i] > 0 ? 1.f / Masses[i] : 0.f;
+    }
+    BuildIslands();
+    bWakeUp = true;
+    UpdateConstraintIndex();
     CurrentBox.Max = Mesh->Positions[0];
     CurrentBox.Min = Mesh->Positions[0];
     for (auto &pos: Mesh->Positions)
@@ -107,6 +238,23 @@ void FRTClothSystemBase::_UpdateMesh(std::shared_ptr<FClothRawMesh> const&AMesh)
     // }
 }
 
+void FRTClothSystemBase::UpdateConstraintIndex()
+{
+    ConstraintIndex.Init(INDEX_NONE, Mesh->Positions.Num());
+    ConstrainedVertices.Reset(Constraints.Num());
+    ConstraintMats.Reset(Constraints.Num());
+    for (auto const& Pair : Constraints)
+    {
+        if (int32(Pair.Key) < ConstraintIndex.Num())
+        {
+            ConstraintIndex[Pair.Key] = ConstrainedVertices.Num();
+            ConstrainedVertices.Add(Pair.Key);
+            ConstraintMats.Add(Pair.Value);
+        }
+    }
+    bConstraintsChanged = false;
+}
+
 // refer to https://github.com/NANAnoo/A1_manifold_test/blob/main/manifold_test/DirectedEdge.cpp
 void FRTClothSystemBase::MakeDirectedEdgeModel()
 {
@@ -171,13 +319,21 @@ void FRTClothSystemBase::UpdateTriangleProperties(TArray<FVector> const&Position
     }
 }
 
-void FRTClothSystemBase::UpdateTransform(FTransform const& ClothToWorld, float Duration)
+void FRTClothSystemBase::UpdateTransform(FTransform const& ClothToWorld, float Duration, float ColliderAlpha)
 {
     FVector const Pre_pos =  Mesh->LocalToWorld.GetLocation();
     FVector newClothAttachedVelocity = (ClothToWorld.GetLocation() - Pre_pos) / Duration;
     for (auto &Pair : Colliders)
     {
-        Pair.Value.ClothToCollider =  ClothToWorld.ToMatrixNoScale() * Pair.Key->GetComponentToWorld().ToInverseMatrixWithScale();
+        FTransform ColliderToWorld = ColliderFrameEnd.FindRef(Pair.Key);
+        FTransform const* Start = ColliderFrameStart.Find(Pair.Key);
+        if (Start && ColliderAlpha < 1.f)
+        {
+            FTransform Blended;
+            Blended.Blend(*Start, ColliderToWorld, ColliderAlpha);
+            ColliderToWorld = Blended;
+        }
+        Pair.Value.ClothToCollider =  ClothToWorld.ToMatrixNoScale() * ColliderToWorld.ToInverseMatrixWithScale();
         Pair.Value.ColliderToCloth =  Pair.Value.ClothToCollider.Inverse();
     }
     Gravity = ClothToWorld.InverseTransformVector(WorldSpaceGravity);
@@ -187,6 +343,224 @@ void FRTClothSystemBase::UpdateTransform(FTransform const& ClothToWorld, float D
     ClothAttachedVelocity = newClothAttachedVelocity;
     Mesh->LocalToWorld = ClothToWorld;
 }
+
+FRTStepMeasures FRTClothSystemBase::MeasureLastStep() const
+{
+    FRTStepMeasures Res;
+    if (!bMeasureSteps || StepStartPositions.Num() != Mesh->Positions.Num() || StepDuration <= 0) return Res;
+    TArray<FVector> const& X = Mesh->Positions;
+    FVector2D const Rest(M_Material.Rest_U, M_Material.Rest_V);
+    float MinRest = BIG_NUMBER;
+    for (int32 e = 0; e + 1 < EdgeVertices.Num(); e += 2)
+    {
+        uint32 const V0 = EdgeVertices[e], V1 = EdgeVertices[e + 1];
+        float const L0 = ((Mesh->TexCoords[V1] - Mesh->TexCoords[V0]) * Rest).Size();
+        if (L0 < SMALL_NUMBER) continue;
+        MinRest = std::min(MinRest, L0);
+        float const Change = FMath::Abs((X[V1] - X[V0]).Size() - (StepStartPositions[V1] - StepStartPositions[V0]).Size());
+        Res.StrainRate = std::max(Res.StrainRate, Change / L0);
+    }
+    if (MinRest == BIG_NUMBER) return Res;
+    float MaxMove = 0;
+    for (int32 i = 0; i < X.Num(); i ++)
+    {
+        MaxMove = std::max(MaxMove, (X[i] - StepStartPositions[i]).SizeSquared());
+    }
+    Res.StrainRate /= StepDuration;
+    Res.MotionRate = FMath::Sqrt(MaxMove) / (MinRest * StepDuration);
+    Res.Penetration = StepPenetration / MinRest;
+    return Res;
+}
+
+void FRTClothSystemBase::UpdateCollider(UPrimitiveComponent *Com, FRTClothCollider const&Collider)
+{
+    Colliders.FindOrAdd(Com) = Collider;
+    ColliderFrameEnd.FindOrAdd(Com) = Com->GetComponentToWorld();
+    bWakeUp = true;
+}
+
+void FRTClothSystemBase::CaptureColliders()
+{
+    ColliderFrameEnd.Reset();
+    for (auto const& Pair : Colliders)
+    {
+        ColliderFrameEnd.Add(Pair.Key, Pair.Key->GetComponentToWorld());
+    }
+}
+
+void FRTClothSystemBase::EndFrame()
+{
+    ColliderFrameStart = ColliderFrameEnd;
+    TArray<FVector> const* Velocities = CurrentVelocities();
+    if (SleepFrames > 0 && Velocities)
+    {
+        UpdateIslandSleep(*Velocities);
+    }
+}
+
+void FRTClothSystemBase::PublishPositions(double Time)
+{
+    // the render thread picks up the latest frame
+    FRTPositionSnapshot &Snapshot = PositionSnapshots.GetWriteBuffer();
+    Snapshot.Positions = Mesh->Positions;
+    TArray<FVector> const* Velocities = CurrentVelocities();
+    if (RenderSmoothing == ERTRenderSmoothing::Extrapolate && Velocities && Velocities->Num() == Mesh->Positions.Num())
+    {
+        Snapshot.Velocities = *Velocities;
+        float const Scale = CurrentVelocityScale();
+        if (Scale != 1.f)
+        {
+            for (FVector &V : Snapshot.Velocities)
+            {
+                V *= Scale;
+            }
+        }
+    }
+    else
+    {
+        Snapshot.Velocities.Reset();
+    }
+    Snapshot.Time = Time;
+    PositionSnapshots.SwapWriteBuffers();
+}
+
+void FRTClothSystemBase::SetSleep(float Speed, int32 Frames)
+{
+    SleepSpeed = Speed;
+    SleepFrames = Frames;
+    WakeIslands();
+}
+
+void FRTClothSystemBase::BuildIslands()
+{
+    // union find over the half edges
+    int32 const NumOfVertices = Mesh->Positions.Num();
+    TArray<int32> Parent;
+    Parent.SetNumUninitialized(NumOfVertices);
+    for (int32 i = 0; i < NumOfVertices; i ++)
+    {
+        Parent[i] = i;
+    }
+    auto Find = [&Parent](int32 V)
+    {
+        while (Parent[V] != V)
+        {
+            Parent[V] = Parent[Parent[V]];
+            V = Parent[V];
+        }
+        return V;
+    };
+    for (int32 Edge = 0; Edge < other_half_of_edge.Num(); Edge ++)
+    {
+        int32 const A = Find(fromVertexIndexOfHalfEdge(Edge));
+        int32 const B = Find(toVertexIndexOfHalfEdge(Edge));
+        if (A != B)
+        {
+            Parent[FMath::Max(A, B)] = FMath::Min(A, B);
+        }
+    }
+    // islands are numbered by their first vertex
+    VertexIslands.SetNumUninitialized(NumOfVertices);
+    IslandOffsets.Reset();
+    IslandOffsets.Add(0);
+    for (int32 i = 0; i < NumOfVertices; i ++)
+    {
+        int32 const Root = Find(i);
+        if (Root == i)
+        {
+            VertexIslands[i] = IslandOffsets.Num() - 1;
+            IslandOffsets.Add(0);
+        }
+        else
+        {
+            VertexIslands[i] = VertexIslands[Root];
+        }
+        IslandOffsets[VertexIslands[i] + 1] ++;
+    }
+    for (int32 Island = 0; Island < NumOfIslands(); Island ++)
+    {
+        IslandOffsets[Island + 1] += IslandOffsets[Island];
+    }
+    TArray<int32> Next(IslandOffsets.GetData(), NumOfIslands());
+    IslandVertices.SetNumUninitialized(NumOfVertices);
+    for (int32 i = 0; i < NumOfVertices; i ++)
+    {
+        IslandVertices[Next[VertexIslands[i]] ++] = i;
+    }
+    WakeIslands();
+}
+
+void FRTClothSystemBase::WakeIslands()
+{
+    IslandAsleep.Init(0, NumOfIslands());
+    IslandQuietFrames.Init(0, NumOfIslands());
+    bAnyIslandAsleep = false;
+    bSleeping = false;
+}
+
+void FRTClothSystemBase::UpdateIslandSleep(TArray<FVector> const& Velocities)
+{
+    TArray<RTCloth::AABB> Bounds;
+    Bounds.SetNumUninitialized(NumOfIslands());
+    for (int32 Island = 0; Island < NumOfIslands(); Island ++)
+    {
+        double Mass = 0, Energy = 0;
+        RTCloth::AABB &Box = Bounds[Island];
+        Box.Max = Box.Min = Mesh->Positions[IslandVertices[IslandOffsets[Island]]];
+        for (int32 k = IslandOffsets[Island]; k < IslandOffsets[Island + 1]; k ++)
+        {
+            int32 const V = IslandVertices[k];
+            Mass += Masses[V];
+            Energy += Masses[V] * Velocities[V].SizeSquared();
+            Box.Max = Box.Max.ComponentMax(Mesh->Positions[V]);
+            Box.Min = Box.Min.ComponentMin(Mesh->Positions[V]);
+        }
+        if (IslandAsleep[Island]) continue;
+        float const Speed = Mass > 0 ? FMath::Sqrt(Energy / Mass) : 0.f;
+        IslandQuietFrames[Island] = Speed < SleepSpeed ? IslandQuietFrames[Island] + 1 : 0;
+        IslandAsleep[Island] = IslandQuietFrames[Island] >= SleepFrames;
+    }
+    // moving islands wake the islands they may collide with
+    for (int32 Awake = 0; Awake < NumOfIslands(); Awake ++)
+    {
+        if (IslandAsleep[Awake]) continue;
+        for (int32 Island = 0; Island < NumOfIslands(); Island ++)
+        {
+            if (IslandAsleep[Island] &&
+                Bounds[Awake].Min.X <= Bounds[Island].Max.X && Bounds[Island].Min.X <= Bounds[Awake].Max.X &&
+                Bounds[Awake].Min.Y <= Bounds[Island].Max.Y && Bounds[Island].Min.Y <= Bounds[Awake].Max.Y &&
+                Bounds[Awake].Min.Z <= Bounds[Island].Max.Z && Bounds[Island].Min.Z <= Bounds[Awake].Max.Z)
+            {
+                IslandAsleep[Island] = 0;
+                IslandQuietFrames[Island] = 0;
+            }
+        }
+    }
+    bAnyIslandAsleep = false;
+    bSleeping = NumOfIslands() > 0;
+    for (auto const Asleep : IslandAsleep)
+    {
+        bAnyIslandAsleep |= Asleep != 0;
+        bSleeping &= Asleep != 0;
+    }
+}
+
+bool FRTClothSystemBase::CheckSleep(bool bTransformChanged)
+{
+    bool bChanged = bWakeUp || bTransformChanged;
+    for (auto const& Pair : Colliders)
+    {
+        if (bChanged) break;
+        FTransform const* Start = ColliderFrameStart.Find(Pair.Key);
+        bChanged = !Start || !Start->Equals(Pair.Key->GetComponentToWorld());
+    }
+    bWakeUp = false;
+    if (bChanged)
+    {
+        WakeIslands();
+    }
+    return bSleeping;
+}
 void FRTClothSystemBase::AddCollisionSpringForces(TArray<FVector> &Forces, TArray<FVector> const&Positions, TArray<FVector> const&Velocities)
 {
     // // build bvh tree
@@ -213,6 +587,7 @@ void FRTClothSystemBase::AddCollisionSpringForces(TArray<FVector> &Forces, TArra
                 float const Dis = C_P.Size();
                 if (Dis < Len)
                 {
+                    StepPenetration = std::max(StepPenetration, Len - Dis);
                     C_P.Normalize();
                     auto const f = Masses[V] * (C_P * (Len - Dis) * M_Material.K_Collision - (Velocities[V] - CenterV) * M_Material.D_Collision) ;
                     Forces[V] += f;
@@ -231,7 +606,7 @@ void FRTClothSystemBase::SolveCollision(TArray<FVector>& Pre_Positions, TArray<F
         FMatrix const& ColliderToCloth = Pair.Value.ColliderToCloth;
         for (int i = 0; i < Positions.Num(); i ++)
         {
-            if (!Constraints.Contains(i))
+            if (ConstraintIndex[i] == INDEX_NONE)
             {
                 // transform cloth positions and velocities to collider space
                 FVector Vel = ClothToCollider.TransformVector(Velocities[i]);
@@ -242,6 +617,7 @@ void FRTClothSystemBase::SolveCollision(TArray<FVector>& Pre_Positions, TArray<F
                     // transform velocity and position back to cloth space
                     Velocities[i] = ColliderToCloth.TransformVector(Vel);
                     Pos_W = ColliderToCloth.TransformPosition(Pos);
+                    StepPenetration = std::max(StepPenetration, (FVector(Pos_W / Pos_W.W) - Positions[i]).Size());
                     Positions[i] = (Pos_W / Pos_W.W);
                     if (Pre_Positions.Num() > 0)
                         // for Integrator that needs previous positions
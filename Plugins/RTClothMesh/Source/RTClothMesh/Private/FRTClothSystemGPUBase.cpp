@@ -79,10 +79,10 @@ void FRTClothSystemGPUBase::PrepareSimulation()
 		{
 			SubForceIndices.Add(id);
 		}
-		if (Constraints.Contains(i))
+		if (FRTMatrix3 const* Constraint = FindConstraint(i))
 		{
 			ConstraintMap.Add(3 * (ConstraintID ++));
-			auto &C = Constraints[i];
+			auto const& C = *Constraint;
 			ConstraintData.Add({C[0][0], C[0][1], C[0][2]});
 			ConstraintData.Add({C[1][0], C[1][1], C[1][2]});
 			ConstraintData.Add({C[2][0], C[2][1], C[2][2]});
@@ -1,11 +1,21 @@
 ﻿#include "FRTClothSystem_ImplicitIntegration_CPU.h"
+#include "FRTGraphPartition.h"
 
 DECLARE_STATS_GROUP(TEXT("RTCloth"), STATGROUP_RTCloth_Implicit, STATCAT_Advanced);
 DECLARE_CYCLE_STAT(TEXT("One Frame Cost"), TIME_COST_Implicit, STATGROUP_RTCloth_Implicit);
-DECLARE_CYCLE_STAT(TEXT("StretchConditions"), StretchConditions_Implicit,STATGROUP_RTCloth_Implicit);
-DECLARE_CYCLE_STAT(TEXT("ShearConditions"), ShearConditions_Implicit,STATGROUP_RTCloth_Implicit);
+DECLARE_CYCLE_STAT(TEXT("StretchShearConditions"), StretchShearConditions_Implicit,STATGROUP_RTCloth_Implicit);
 DECLARE_CYCLE_STAT(TEXT("BendConditions"), BendConditions_Implicit,STATGROUP_RTCloth_Implicit);
 DECLARE_CYCLE_STAT(TEXT("Solve Linear Equation"), SolveLinearEquation_Implicit,STATGROUP_RTCloth_Implicit);
+DECLARE_CYCLE_STAT(TEXT("Reused Derivatives"), ReusedDerivatives_Implicit,STATGROUP_RTCloth_Implicit);
+DECLARE_CYCLE_STAT(TEXT("StrainLimit"), StrainLimit_Implicit,STATGROUP_RTCloth_Implicit);
+DECLARE_CYCLE_STAT(TEXT("Newton Iterations"), NewtonIterations_Implicit,STATGROUP_RTCloth_Implicit);
+// accuracy and cost of reused derivatives against fresh ones
+DECLARE_DWORD_COUNTER_STAT(TEXT("Refreshed Steps"), RefreshedSteps_Implicit, STATGROUP_RTCloth_Implicit);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Reused Steps"), ReusedSteps_Implicit, STATGROUP_RTCloth_Implicit);
+DECLARE_DWORD_COUNTER_STAT(TEXT("CG Iterations (refreshed)"), RefreshedIterations_Implicit, STATGROUP_RTCloth_Implicit);
+DECLARE_DWORD_COUNTER_STAT(TEXT("CG Iterations (reused)"), ReusedIterations_Implicit, STATGROUP_RTCloth_Implicit);
+// |y - Df_Dx * s| / |y| of the last reused step
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Secant Error"), SecantError_Implicit, STATGROUP_RTCloth_Implicit);
 
 // pseudo code
 // void FRTClothSystem_ImplicitIntegration_CPU::TickOnce(float Duration)
@@ -31,26 +41,24 @@ void FRTClothSystem_ImplicitIntegration_CPU::TickOnce(float Duration)
     SCOPE_CYCLE_COUNTER(TIME_COST_Implicit);
     if (!IsFirstFrame)
     {
-        ForcesAndDerivatives();
-    }
-    if (M_Material.EnableInnerCollision)
-    {
-        UpdateTriangleProperties(Mesh->Positions, Velocity);
-        AddCollisionSpringForces(Forces, Mesh->Positions, Velocity);
+        bRefreshedThisStep = ShouldRefreshDerivatives();
+        if (bRefreshedThisStep)
+        {
+            ForcesAndDerivatives();
+        }
+        else
+        {
+            ForcesOnly();
+            UpdateReusedDerivatives();
+        }
+        SaveSecantState();
     }
+    AddInnerCollisionForces();
     IsFirstFrame = false;
     // build up equation for solver, A x = b
     // A = M -dfdx * dt * dt - dfdv * dt;
     // b = f * dt + dfdx * v * dt * dt;
-    Df_Dx.Execute(A, Df_Dv,
-        [this, Duration](int32 Id, float This_Value, float Other_Value)
-        {
-            return this->Masses[Id / 3] - (This_Value * Duration + Other_Value) * Duration;
-        },
-        [Duration](float This_Value, float Other_Value)
-        {
-            return - (This_Value * Duration + Other_Value) * Duration;
-        });
+    AssembleSystemMatrix(Duration);
     
     Df_Dx.MulVector(B.GetData(), (float *)Velocity.GetData(), Velocity.Num() * 3);
     for (int32 i = 0; i < Forces.Num(); i ++)
@@ -60,14 +68,10 @@ void FRTClothSystem_ImplicitIntegration_CPU::TickOnce(float Duration)
         B[3 * i + 2] = (B[3 * i + 2] * Duration + Forces[i][2]) * Duration;
     }
     // load constraints
-    TArray<uint32> ConsIds;
-    Constraints.GetKeys(ConsIds);
-    TArray<FRTMatrix3> ConsMats;
-    ConsMats.Reserve(ConsIds.Num());
-    for (auto const Id : ConsIds)
-        ConsMats.Add(Constraints[Id]);
-    Solver->UpdateConstraints(ConsIds, ConsMats);
+    Solver->UpdateConstraints(ConstrainedVertices, ConstraintMats);
     Solver->UpdateVelocityConstraints(-DeltaClothAttachedVelocity);
+    // asleep islands keep their positions
+    Solver->SetSkippedIslands(bAnyIslandAsleep ? &IslandAsleep : nullptr);
     // solve equation
     TArray<float> dV;
     dV.SetNumZeroed(Velocity.Num() * 3);
@@ -75,82 +79,378 @@ void FRTClothSystem_ImplicitIntegration_CPU::TickOnce(float Duration)
         SCOPE_CYCLE_COUNTER(SolveLinearEquation_Implicit)
         Solver->Solve(A, B, dV);
     }
+    if (HessianReuse.RefreshInterval > 1)
+    {
+        if (bRefreshedThisStep)
+        {
+            INC_DWORD_STAT(RefreshedSteps_Implicit);
+            INC_DWORD_STAT_BY(RefreshedIterations_Implicit, Solver->LastIterations());
+        }
+        else
+        {
+            INC_DWORD_STAT(ReusedSteps_Implicit);
+            INC_DWORD_STAT_BY(ReusedIterations_Implicit, Solver->LastIterations());
+        }
+    }
+    if (Newton.MaxIterations > 1)
+    {
+        StartPositions = Mesh->Positions;
+        StartVelocity = Velocity;
+    }
     // update position
     for (int32 i = 0; i < Velocity.Num(); i ++)
     {
+        if (bAnyIslandAsleep && IslandAsleep[VertexIslands[i]])
+        {
+            Velocity[i] = FVector::ZeroVector;
+            continue;
+        }
         FVector const DV = {dV[3 * i], dV[3 * i + 1], dV[3 * i + 2]};
         Velocity[i] += DV;
         Mesh->Positions[i] += Duration * Velocity[i];
     }
+    if (Newton.MaxIterations > 1)
+    {
+        SCOPE_CYCLE_COUNTER(NewtonIterations_Implicit)
+        NewtonIterations(Duration);
+    }
+    if (StrainLimiter.IsEnabled())
+    {
+        SCOPE_CYCLE_COUNTER(StrainLimit_Implicit)
+        StrainLimiter.Apply(Mesh->Positions, Velocity, 1.f / Duration, InverseMasses, ConstraintIndex);
+    }
     TArray<FVector> Pre_Positions;
     if (M_Material.EnableCollision)
         SolveCollision(Pre_Positions, Mesh->Positions, Velocity, Duration);
         
 }
 
+void FRTClothSystem_ImplicitIntegration_CPU::AssembleSystemMatrix(float Duration)
+{
+    Df_Dx.Execute(A, Df_Dv,
+        [this, Duration](int32 Id, float This_Value, float Other_Value)
+        {
+            return this->Masses[Id / 3] - (This_Value * Duration + Other_Value) * Duration;
+        },
+        [Duration](float This_Value, float Other_Value)
+        {
+            return - (This_Value * Duration + Other_Value) * Duration;
+        });
+}
+
+void FRTClothSystem_ImplicitIntegration_CPU::AddInnerCollisionForces()
+{
+    if (M_Material.EnableInnerCollision)
+    {
+        UpdateTriangleProperties(Mesh->Positions, Velocity);
+        AddCollisionSpringForces(Forces, Mesh->Positions, Velocity);
+    }
+}
+
+float FRTClothSystem_ImplicitIntegration_CPU::NewtonMerit(float Duration) const
+{
+    FRTClothEnergy const E = Energy();
+    double Merit = E.Stretch + E.Shear + E.Bend;
+    for (int32 i = 0; i < Velocity.Num(); i ++)
+    {
+        // inertia, and the work of gravity from X_n
+        Merit += 0.5 * Masses[i] * (Velocity[i] - StartVelocity[i]).SizeSquared();
+        Merit -= Masses[i] * Duration * (Gravity | Velocity[i]);
+    }
+    return Merit;
+}
+
+void FRTClothSystem_ImplicitIntegration_CPU::NewtonIterations(float Duration)
+{
+    int32 const Size = 3 * Forces.Num();
+    NewtonStep.SetNumUninitialized(Size);
+    // forces and potential at the result of the linearized solve
+    ForcesOnly();
+    AddInnerCollisionForces();
+    float Merit = NewtonMerit(Duration);
+    // constrained vertices got their velocity change in the first solve
+    Solver->UpdateVelocityConstraints(FVector::ZeroVector);
+    for (int32 Iter = 1; Iter < Newton.MaxIterations; Iter ++)
+    {
+        // relinearize at the iterate, A dV = h * f - M (V - V_n).
+        // the forces of the accepted line search step are evaluated again with the derivatives
+        ForcesAndDerivatives();
+        AddInnerCollisionForces();
+        AssembleSystemMatrix(Duration);
+        if (HessianReuse.RefreshInterval > 1)
+        {
+            // the derivatives are fresh, reuse starts from here
+            StepsSinceRefresh = 0;
+            RefreshPositions = Mesh->Positions;
+        }
+        for (int32 i = 0; i < Forces.Num(); i ++)
+        {
+            FVector const Residual = Duration * Forces[i] - Masses[i] * (Velocity[i] - StartVelocity[i]);
+            B[3 * i] = Residual[0];
+            B[3 * i + 1] = Residual[1];
+            B[3 * i + 2] = Residual[2];
+            NewtonStep[3 * i] = NewtonStep[3 * i + 1] = NewtonStep[3 * i + 2] = 0;
+        }
+        {
+            SCOPE_CYCLE_COUNTER(SolveLinearEquation_Implicit)
+            Solver->Solve(A, B, NewtonStep);
+        }
+        float MaxChange = 0;
+        for (float const D : NewtonStep)
+        {
+            MaxChange = FMath::Max(MaxChange, FMath::Abs(D));
+        }
+
+        // backtracking line search on the incremental potential
+        SearchVelocity = Velocity;
+        float Alpha = 1;
+        bool bDecreased = false;
+        for (int32 Search = 0; ; Search ++)
+        {
+            for (int32 i = 0; i < Velocity.Num(); i ++)
+            {
+                Velocity[i] = SearchVelocity[i] + Alpha * FVector(NewtonStep[3 * i], NewtonStep[3 * i + 1], NewtonStep[3 * i + 2]);
+                Mesh->Positions[i] = StartPositions[i] + Duration * Velocity[i];
+            }
+            ForcesOnly();
+            AddInnerCollisionForces();
+            float const Trial = NewtonMerit(Duration);
+            bDecreased = Trial <= Merit;
+            if (bDecreased)
+            {
+                Merit = Trial;
+                break;
+            }
+            if (Search >= Newton.MaxLineSearchSteps)
+            {
+                // no step decreased the potential, keep the iterate the search started from,
+                // with its forces and energies
+                for (int32 i = 0; i < Velocity.Num(); i ++)
+                {
+                    Velocity[i] = SearchVelocity[i];
+                    Mesh->Positions[i] = StartPositions[i] + Duration * Velocity[i];
+                }
+                ForcesOnly();
+                AddInnerCollisionForces();
+                break;
+            }
+            Alpha *= 0.5f;
+        }
+        if (!bDecreased || Alpha * MaxChange < Newton.Tolerance)
+        {
+            break;
+        }
+    }
+}
+
 void FRTClothSystem_ImplicitIntegration_CPU::ForcesAndDerivatives()
 {
     for (int32 i = 0; i < Forces.Num(); i ++)
     {
         Forces[i] = Gravity * Masses[i];
     }
-    Df_Dx.SetValues(0.f);
-    Df_Dv.SetValues(0.f);
+    if (bBaked)
+    {
+        Df_Dx.CopyValues(BakedDf_Dx);
+        Df_Dv.CopyValues(BakedDf_Dv);
+    }
+    else
+    {
+        Df_Dx.SetValues(0.f);
+        Df_Dv.SetValues(0.f);
+    }
 
     {
         SCOPE_CYCLE_COUNTER(BendConditions_Implicit);
-        for (auto &Con : BendConditions)
+        if (bQuadraticBend)
+        {
+            // derivatives are baked
+            QuadraticBendKernel.ComputeForces(Mesh->Positions, Velocity, Forces);
+        }
+        else
         {
-            Con.UpdateCondition(Mesh->Positions, Velocity, Mesh->TexCoords);
-            Con.ComputeForces(M_Material.K_Bend, M_Material.D_Bend, Forces, Forces);
-            Con.ComputeDerivatives(M_Material.K_Bend, M_Material.D_Bend, Df_Dx, Df_Dx, Df_Dv);
+            BendKernel.ComputeForcesAndDerivatives(Mesh->Positions, Velocity, Mesh->TexCoords,
+                Forces, Df_Dx, Df_Dx, Df_Dv);
         }
     }
     {
-        SCOPE_CYCLE_COUNTER(ShearConditions_Implicit);
-        for (auto &Con : ShearConditions)
+        SCOPE_CYCLE_COUNTER(StretchShearConditions_Implicit);
+        if (bCorotational)
+        {
+            CorotationalKernel.ComputeForcesAndDerivatives(Mesh->Positions, Velocity, Forces, Df_Dx, Df_Dv);
+        }
+        else
         {
-            Con.UpdateCondition(Mesh->Positions, Velocity, Mesh->TexCoords);
-            Con.ComputeForces(M_Material.K_Shear, M_Material.D_Shear, Forces, Forces);
-            Con.ComputeDerivatives(M_Material.K_Shear, M_Material.D_Shear, Df_Dx, Df_Dx, Df_Dv);
+            StretchShearKernel.ComputeForcesAndDerivatives(Mesh->Positions, Velocity,
+                Forces, Df_Dx, Df_Dx, Df_Dv);
         }
     }
+    
+    for (int i = 0; i < Masses.Num(); i ++)
+    {
+        Forces[i] += - M_Material.AirFriction * (Velocity[i] - WindVelocity) * Masses[i];
+    }
+}
 
+void FRTClothSystem_ImplicitIntegration_CPU::ForcesOnly()
+{
+    for (int32 i = 0; i < Forces.Num(); i ++)
+    {
+        Forces[i] = Gravity * Masses[i];
+    }
     {
-        SCOPE_CYCLE_COUNTER(StretchConditions_Implicit);
-        for (auto &Con : StretchConditions)
+        SCOPE_CYCLE_COUNTER(BendConditions_Implicit);
+        if (bQuadraticBend)
+        {
+            QuadraticBendKernel.ComputeForces(Mesh->Positions, Velocity, Forces);
+        }
+        else
         {
-            Con.UpdateCondition(Mesh->Positions, Velocity, Mesh->TexCoords);
-            Con.ComputeForces(M_Material.K_Stretch, M_Material.D_Stretch, Forces, Forces);
-            Con.ComputeDerivatives(M_Material.K_Stretch, M_Material.D_Stretch, Df_Dx, Df_Dx, Df_Dv);
+            BendKernel.ComputeForces(Mesh->Positions, Velocity, Mesh->TexCoords, Forces);
+        }
+    }
+    {
+        SCOPE_CYCLE_COUNTER(StretchShearConditions_Implicit);
+        if (bCorotational)
+        {
+            CorotationalKernel.ComputeForces(Mesh->Positions, Velocity, Forces);
+        }
+        else
+        {
+            StretchShearKernel.ComputeForces(Mesh->Positions, Velocity, Forces);
         }
     }
-    
     for (int i = 0; i < Masses.Num(); i ++)
     {
         Forces[i] += - M_Material.AirFriction * (Velocity[i] - WindVelocity) * Masses[i];
     }
 }
 
+bool FRTClothSystem_ImplicitIntegration_CPU::ShouldRefreshDerivatives()
+{
+    if (++ StepsSinceRefresh >= HessianReuse.RefreshInterval)
+    {
+        return true;
+    }
+    SCOPE_CYCLE_COUNTER(ReusedDerivatives_Implicit);
+    float const Change = bCorotational
+        ? CorotationalKernel.MaxRotationChange(Mesh->Positions, RefreshPositions)
+        : StretchShearKernel.MaxStrainChange(Mesh->Positions, RefreshPositions);
+    return Change > HessianReuse.StrainThreshold;
+}
+
+void FRTClothSystem_ImplicitIntegration_CPU::UpdateReusedDerivatives()
+{
+    SCOPE_CYCLE_COUNTER(ReusedDerivatives_Implicit);
+    // secant of this step: s = dx, y = df - Df_Dv * dv, the part of df that Df_Dx should predict
+    int32 const Size = 3 * Forces.Num();
+    float const *X = (float const *)Mesh->Positions.GetData(), *PrevX = (float const *)PrevPositions.GetData();
+    float const *V = (float const *)Velocity.GetData(), *PrevV = (float const *)PrevVelocity.GetData();
+    float const *F = (float const *)Forces.GetData(), *PrevF = (float const *)PrevForces.GetData();
+    for (int32 i = 0; i < Size; i ++)
+    {
+        SecantS[i] = V[i] - PrevV[i];
+    }
+    Df_Dv.MulVector(SecantJS.GetData(), SecantS.GetData(), Size);
+    for (int32 i = 0; i < Size; i ++)
+    {
+        SecantY[i] = F[i] - PrevF[i] - SecantJS[i];
+        SecantS[i] = X[i] - PrevX[i];
+    }
+#if STATS
+    // how well the reused Df_Dx predicts the secant, only measured for the stat
+    Df_Dx.MulVector(SecantJS.GetData(), SecantS.GetData(), Size);
+    double Residual = 0, Norm = 0;
+    for (int32 i = 0; i < Size; i ++)
+    {
+        Residual += FMath::Square(SecantY[i] - SecantJS[i]);
+        Norm += FMath::Square(SecantY[i]);
+    }
+    SET_FLOAT_STAT(SecantError_Implicit, Norm > 0 ? FMath::Sqrt(Residual / Norm) : 0.0);
+#endif
+
+    if (HessianReuse.bBroydenUpdate)
+    {
+        Df_Dx.SparseBroydenUpdate(SecantS.GetData(), SecantY.GetData());
+    }
+}
+
+void FRTClothSystem_ImplicitIntegration_CPU::SaveSecantState()
+{
+    if (bRefreshedThisStep)
+    {
+        StepsSinceRefresh = 0;
+        RefreshPositions = Mesh->Positions;
+    }
+    if (HessianReuse.RefreshInterval > 1)
+    {
+        PrevPositions = Mesh->Positions;
+        PrevVelocity = Velocity;
+        PrevForces = Forces;
+    }
+}
+
+FRTClothEnergy FRTClothSystem_ImplicitIntegration_CPU::Energy() const
+{
+    FRTClothEnergy Res;
+    Res.Stretch = bCorotational ? CorotationalKernel.LastStretchEnergy() : StretchShearKernel.LastStretchEnergy();
+    Res.Shear = bCorotational ? CorotationalKernel.LastShearEnergy() : StretchShearKernel.LastShearEnergy();
+    Res.Bend = bQuadraticBend ? QuadraticBendKernel.LastEnergy() : BendKernel.LastEnergy();
+    Res.Kinetic = KineticEnergy(Velocity);
+    return Res;
+}
+
+void FRTClothSystem_ImplicitIntegration_CPU::MaterialUpdated()
+{
+    StretchShearKernel.SetParams(FRTMembraneParams::FromMaterial(M_Material));
+    CorotationalKernel.SetParams(FRTMembraneParams::FromMaterial(M_Material));
+    BendKernel.SetParams(M_Material.K_Bend, M_Material.D_Bend);
+    QuadraticBendKernel.SetParams(M_Material.K_Bend, M_Material.D_Bend);
+    StrainLimiter.SetLimits(M_Material.MinStretch, M_Material.MaxStretch, M_Material.StrainLimitIterations);
+    if (bBaked)
+    {
+        BakeQuadraticBend();
+    }
+}
+
+void FRTClothSystem_ImplicitIntegration_CPU::BakeQuadraticBend()
+{
+    BakedDf_Dx.SetValues(0.f);
+    BakedDf_Dv.SetValues(0.f);
+    QuadraticBendKernel.AddDerivatives(BakedDf_Dx, BakedDf_Dv);
+}
+
 void FRTClothSystem_ImplicitIntegration_CPU::PrepareSimulation()
 {
     IsFirstFrame = true;
+    bBaked = false;
     // setup shear and stretch conditions
-    ShearConditions.Reserve(this->Mesh->Indices.Num() / 3);
-    StretchConditions.Reserve(this->Mesh->Indices.Num() / 3);
-    for (int32 i = 0; i < this->Mesh->Indices.Num() / 3; i ++)
+    if (bCorotational)
     {
-        auto &F = getFaceAt(i);
-        ShearConditions.Add({Mesh.get(), F.vertex_index[0], F.vertex_index[1], F.vertex_index[2]});
-        StretchConditions.Add({Mesh.get(), F.vertex_index[0], F.vertex_index[1], F.vertex_index[2], M_Material.Rest_U, M_Material.Rest_V});
+        CorotationalKernel.Init(*Mesh, M_Material.Rest_U, M_Material.Rest_V);
+        CorotationalKernel.SetScaleMaps(Mesh->StiffnessScale, Mesh->DampingScale);
     }
+    else
+    {
+        StretchShearKernel.Init(*Mesh, M_Material.Rest_U, M_Material.Rest_V);
+        StretchShearKernel.SetScaleMaps(Mesh->StiffnessScale, Mesh->DampingScale);
+    }
+    StrainLimiter.Init(*Mesh, M_Material.Rest_U, M_Material.Rest_V);
     // set up bend conditions
     uint32 PairNum = 0;
     for (auto const E : other_half_of_edge)
     {
         PairNum += (E != UNKNOWN_HALF_EDGE);
     }
-    BendConditions.Reserve(PairNum / 2);
+    if (bQuadraticBend)
+    {
+        // the rest shape is the mesh at setup
+        QuadraticBendKernel.Reset(Mesh->Positions.Num());
+    }
+    else
+    {
+        BendKernel.Reset(PairNum / 2, M_Material.InitTheta);
+    }
 
     TSet<uint32> VisitedEdges;
     VisitedEdges.Reserve(other_half_of_edge.Num());
@@ -166,26 +466,67 @@ void FRTClothSystem_ImplicitIntegration_CPU::PrepareSimulation()
                 uint32 const V1 = fromVertexIndexOfHalfEdge(Edge);
                 uint32 const V2 = toVertexIndexOfHalfEdge(Edge);
                 uint32 const V3 = toVertexIndexOfHalfEdge(nextHalfEdge(OtherE));
-                BendConditions.Add({V0, V1, V2, V3, M_Material.InitTheta});
+                if (bQuadraticBend)
+                {
+                    QuadraticBendKernel.Add(V0, V1, V2, V3, Mesh->Positions, Mesh->TexCoords);
+                }
+                else
+                {
+                    BendKernel.Add(V0, V1, V2, V3, Mesh->TexCoords);
+                }
                 VisitedEdges.Add(Edge);
                 VisitedEdges.Add(OtherE);
             }
         }
     }
+    if (bQuadraticBend)
+    {
+        QuadraticBendKernel.Finalize();
+        QuadraticBendKernel.SetScaleMaps(Mesh->StiffnessScale, Mesh->DampingScale);
+    }
+    else
+    {
+        BendKernel.Finalize(Mesh->Positions.Num());
+        BendKernel.SetScaleMaps(Mesh->StiffnessScale, Mesh->DampingScale);
+    }
 
     // set up runtime simulation variables
     Velocity.SetNumZeroed(Mesh->Positions.Num());
     Forces.SetNumZeroed(Mesh->Positions.Num());
+    SecantS.SetNumZeroed(Mesh->Positions.Num() * 3);
+    SecantY.SetNumZeroed(Mesh->Positions.Num() * 3);
+    SecantJS.SetNumZeroed(Mesh->Positions.Num() * 3);
 
     // set up sparse matrix
     Df_Dx.UpdateSize(Mesh->Positions.Num() * 3);
     Df_Dv.UpdateSize(Mesh->Positions.Num() * 3);
+    if (bQuadraticBend)
+    {
+        // reserve the entries of the quadratic bend
+        QuadraticBendKernel.AddDerivatives(Df_Dx, Df_Dv);
+    }
     ForcesAndDerivatives();
     Df_Dx.LockPattern();
     Df_Dv.LockPattern();
+    // without damping the kernels skip every block of Df_Dv, give it the pattern of Df_Dx and fill it again
+    if (!Df_Dx.HasSamePattern(Df_Dv))
+    {
+        Df_Dv = FRTBBSSMatrix<float>::MatrixFromOtherPattern(Df_Dx);
+        ForcesAndDerivatives();
+    }
 
     // should have same pattern
     check(Df_Dx.HasSamePattern(Df_Dv));
+    if (bQuadraticBend)
+    {
+        BakedDf_Dx = FRTBBSSMatrix<float>::MatrixFromOtherPattern(Df_Dx);
+        BakedDf_Dv = FRTBBSSMatrix<float>::MatrixFromOtherPattern(Df_Dx);
+        BakeQuadraticBend();
+        bBaked = true;
+        ForcesAndDerivatives();
+    }
+    bRefreshedThisStep = true;
+    SaveSecantState();
 
     // set up layout of A
     A = FRTBBSSMatrix<float>::MatrixFromOtherPattern(Df_Dx);
@@ -193,6 +534,24 @@ void FRTClothSystem_ImplicitIntegration_CPU::PrepareSimulation()
     // alloc memory for B
     B.SetNumUninitialized(Mesh->Positions.Num() * 3);
 
-    // prepare solver
+    // prepare solver, the islands of the mesh are independent blocks of A
+    Solver->SetIslands(IslandOffsets, IslandVertices);
+    if (DomainDecomposition.NumOfSubdomains > 1)
+    {
+        TArray<uint32> Edges;
+        Edges.Reserve(other_half_of_edge.Num() * 2);
+        for (int32 Edge = 0; Edge < other_half_of_edge.Num(); Edge ++)
+        {
+            Edges.Add(fromVertexIndexOfHalfEdge(Edge));
+            Edges.Add(toVertexIndexOfHalfEdge(Edge));
+        }
+        FRTGraphPartition Partition;
+        Partition.Build(Edges, 2, Mesh->Positions.Num(), DomainDecomposition.NumOfSubdomains);
+        Solver->SetSubdomains(Partition.VertexParts, DomainDecomposition.LocalSweeps);
+    }
+    else
+    {
+        Solver->SetSubdomains({}, 0);
+    }
     Solver->Init(A);
 }
\ No newline at end of file
@@ -2,69 +2,58 @@
 
 DECLARE_STATS_GROUP(TEXT("RTCloth(leapfrog)"), STATGROUP_RTCloth_LeapFrog, STATCAT_Advanced);
 DECLARE_CYCLE_STAT(TEXT("One Frame Cost"), TIME_COST_Leapfrog, STATGROUP_RTCloth_LeapFrog);
-DECLARE_CYCLE_STAT(TEXT("StretchConditions"), StretchConditions_Leapfrog,STATGROUP_RTCloth_LeapFrog);
-DECLARE_CYCLE_STAT(TEXT("ShearConditions"), ShearConditions_Leapfrog,STATGROUP_RTCloth_LeapFrog);
+DECLARE_CYCLE_STAT(TEXT("StretchShearConditions"), StretchShearConditions_Leapfrog,STATGROUP_RTCloth_LeapFrog);
 DECLARE_CYCLE_STAT(TEXT("BendConditions"), BendConditions_Leapfrog,STATGROUP_RTCloth_LeapFrog);
 DECLARE_CYCLE_STAT(TEXT("Integration"), Integration_Leapfrog,STATGROUP_RTCloth_LeapFrog);
+DECLARE_CYCLE_STAT(TEXT("StrainLimit"), StrainLimit_Leapfrog,STATGROUP_RTCloth_LeapFrog);
 
 void FRTClothSystem_Leapfrog_CPU::Acceleration()
 {
-	// set up gravity
-	for (int32 i = 0; i < Masses.Num(); i ++)
-	{
-		Forces[i] = Masses[i] * Gravity;
-	}
+	// gravity and air friction are added by the integrator
+	FMemory::Memzero(Forces.GetData(), Forces.Num() * sizeof(FVector));
 
 	// calculate forces
 	{
-		SCOPE_CYCLE_COUNTER(StretchConditions_Leapfrog)
-		for (auto &Con : StretchConditions)
-		{
-			Con.UpdateCondition(Mesh->Positions, Velocities, Mesh->TexCoords);
-			Con.ComputeForces(M_Material.K_Stretch, M_Material.D_Stretch, Forces, Forces);
-		}
-	}
-	{
-		SCOPE_CYCLE_COUNTER(ShearConditions_Leapfrog)
-		for (auto &Con : ShearConditions)
-		{
-			Con.UpdateCondition(Mesh->Positions, Velocities, Mesh->TexCoords);
-			// Serious numerical un-stability meet while using original Shader Damping
-			Con.ComputeForces(M_Material.K_Shear, M_Material.D_Shear, Forces, Forces);
-		}
+		SCOPE_CYCLE_COUNTER(StretchShearConditions_Leapfrog)
+		// Serious numerical un-stability meet while using original Shader Damping
+		StretchShearKernel.ComputeForces(Mesh->Positions, Velocities, Forces);
 	}
 	{
 		SCOPE_CYCLE_COUNTER(BendConditions_Leapfrog)
-		for (auto &Con : BendConditions)
-		{
-			Con.UpdateCondition(Mesh->Positions, Velocities, Mesh->TexCoords);
-			Con.ComputeForces(M_Material.K_Bend, M_Material.D_Bend, Forces, Forces);
-		}
-	}
-	for (int i = 0; i < Masses.Num(); i ++)
-	{
-		Forces[i] += - M_Material.AirFriction * (Velocities[i] - WindVelocity) * Masses[i];
+		BendKernel.ComputeForces(Mesh->Positions, Velocities, Mesh->TexCoords, Forces);
 	}
 }
 
+FRTClothEnergy FRTClothSystem_Leapfrog_CPU::Energy() const
+{
+	FRTClothEnergy Res;
+	Res.Stretch = StretchShearKernel.LastStretchEnergy();
+	Res.Shear = StretchShearKernel.LastShearEnergy();
+	Res.Bend = BendKernel.LastEnergy();
+	Res.Kinetic = KineticEnergy(Velocities);
+	return Res;
+}
+
+void FRTClothSystem_Leapfrog_CPU::MaterialUpdated()
+{
+	StretchShearKernel.SetParams(FRTMembraneParams::FromMaterial(M_Material));
+	BendKernel.SetParams(M_Material.K_Bend, M_Material.D_Bend);
+	StrainLimiter.SetLimits(M_Material.MinStretch, M_Material.MaxStretch, M_Material.StrainLimitIterations);
+}
+
 void FRTClothSystem_Leapfrog_CPU::PrepareSimulation()
 {
 	// setup shear and stretch conditions
-	ShearConditions.Reserve(this->Mesh->Indices.Num() / 3);
-	StretchConditions.Reserve(this->Mesh->Indices.Num() / 3);
-	for (int32 i = 0; i < this->Mesh->Indices.Num() / 3; i ++)
-	{
-		auto &F = getFaceAt(i);
-		ShearConditions.Add({Mesh.get(), F.vertex_index[0], F.vertex_index[1], F.vertex_index[2]});
-		StretchConditions.Add({Mesh.get(), F.vertex_index[0], F.vertex_index[1], F.vertex_index[2], M_Material.Rest_U, M_Material.Rest_V});
-	}
+	StretchShearKernel.Init(*Mesh, M_Material.Rest_U, M_Material.Rest_V);
+	StretchShearKernel.SetScaleMaps(Mesh->StiffnessScale, Mesh->DampingScale);
+	StrainLimiter.Init(*Mesh, M_Material.Rest_U, M_Material.Rest_V);
 	// set up bend conditions
 	uint32 PairNum = 0;
 	for (auto const E : other_half_of_edge)
 	{
 		PairNum += (E != UNKNOWN_HALF_EDGE);
 	}
-	BendConditions.Reserve(PairNum / 2);
+	BendKernel.Reset(PairNum / 2, M_Material.InitTheta);
 
 	TSet<uint32> VisitedEdges;
 	VisitedEdges.Reserve(other_half_of_edge.Num());
@@ -80,14 +69,21 @@ void FRTClothSystem_Leapfrog_CPU::PrepareSimulation()
 				uint32 const V1 = fromVertexIndexOfHalfEdge(Edge);
 				uint32 const V2 = toVertexIndexOfHalfEdge(Edge);
 				uint32 const V3 = toVertexIndexOfHalfEdge(nextHalfEdge(OtherE));
-				BendConditions.Add({V0, V1, V2, V3, M_Material.InitTheta});
+				BendKernel.Add(V0, V1, V2, V3, Mesh->TexCoords);
 				VisitedEdges.Add(Edge);
 				VisitedEdges.Add(OtherE);
 			}
 		}
 	}
+	BendKernel.Finalize(Mesh->Positions.Num());
+	BendKernel.SetScaleMaps(Mesh->StiffnessScale, Mesh->DampingScale);
+
+	// pick coloring or private force buffers, the pinned mode or whichever is faster on this mesh
+	StretchShearKernel.SelectScatterMode(Mesh->Positions, PinnedScatterMode);
+	BendKernel.SelectScatterMode(Mesh->Positions, Mesh->TexCoords, PinnedScatterMode);
 
 	// set up runtime simulation variables
+	Integrator.Init(InverseMasses);
 	Forces.SetNumZeroed(Mesh->Positions.Num());
 	Pre_As.SetNumZeroed(Mesh->Positions.Num());
 	Velocities.SetNumZeroed(Mesh->Positions.Num());
@@ -101,17 +97,15 @@ void FRTClothSystem_Leapfrog_CPU::TickOnce(float Duration)
 {
 	SCOPE_CYCLE_COUNTER(TIME_COST_Leapfrog)
 	FRTClothSystemBase::TickOnce(Duration);
-	// Update Velocity_Half
-	for (int32 i = 0; i < Masses.Num(); i ++)
+	// Update Velocity_Half and Positions
 	{
-		Velocities_Half[i] = Velocities[i] + (Duration / 2) * Pre_As[i];
+		SCOPE_CYCLE_COUNTER(Integration_Leapfrog)
+		FRTExplicitIntegrator::LeapfrogDrift(Mesh->Positions, Velocities, Velocities_Half, Pre_As, Duration);
 	}
-	
-	// Update Positions
-	for (int32 i = 0; i < Masses.Num(); i ++)
+	if (StrainLimiter.IsEnabled())
 	{
-		Mesh->Positions[i] += Velocities_Half[i] * Duration;
-		Velocities[i] += Duration * Pre_As[i];
+		SCOPE_CYCLE_COUNTER(StrainLimit_Leapfrog)
+		StrainLimiter.Apply(Mesh->Positions, Velocities_Half, 1.f / Duration, InverseMasses, ConstraintIndex);
 	}
 	TArray<FVector> Pre_Positions;
 
@@ -127,16 +121,10 @@ void FRTClothSystem_Leapfrog_CPU::TickOnce(float Duration)
 	}
 	{
 		SCOPE_CYCLE_COUNTER(Integration_Leapfrog)
-		for (int32 i = 0; i < Masses.Num(); i ++)
-		{
-			auto const Acc = Forces[i] / Masses[i] + DeltaClothAttachedVelocity / Duration;
-			Pre_As[i] = Acc;
-			if (Constraints.Contains(i))
-			{
-				Pre_As[i] = Constraints[i] * Pre_As[i];
-			}
-			Velocities[i] = Velocities_Half[i] + (Duration / 2) * Pre_As[i];
-		}
+		// Acc = F / m + g - AirFriction * (V - Wind) + dV / h
+		Integrator.SetAcceleration(
+			Gravity + M_Material.AirFriction * WindVelocity + DeltaClothAttachedVelocity / Duration, M_Material.AirFriction);
+		Integrator.LeapfrogKick(Pre_As, Velocities, Velocities_Half, Forces, Duration, ConstrainedVertices, ConstraintMats);
 	}
 	if (M_Material.EnableCollision)
 		SolveCollision(Pre_Positions, Mesh->Positions, Velocities, Duration);
@@ -0,0 +1,415 @@
+﻿#include "FRTClothSystem_ProjectiveDynamics_CPU.h"
+
+#include "FRTGraphColoring.h"
+#include "FRTQuadraticBendKernel.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_STATS_GROUP(TEXT("RTCloth(projective)"), STATGROUP_RTCloth_Projective, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("One Frame Cost"), TIME_COST_Projective, STATGROUP_RTCloth_Projective);
+DECLARE_CYCLE_STAT(TEXT("Assemble"), Assemble_Projective, STATGROUP_RTCloth_Projective);
+DECLARE_CYCLE_STAT(TEXT("Factorize"), Factorize_Projective, STATGROUP_RTCloth_Projective);
+DECLARE_CYCLE_STAT(TEXT("LocalStep"), LocalStep_Projective, STATGROUP_RTCloth_Projective);
+DECLARE_CYCLE_STAT(TEXT("GlobalStep"), GlobalStep_Projective, STATGROUP_RTCloth_Projective);
+
+void FRTClothSystem_ProjectiveDynamics_CPU::PrepareSimulation()
+{
+	int32 const NumOfVertices = Mesh->Positions.Num();
+	int32 const NumOfTriangles = Mesh->Indices.Num() / 3;
+	float const RestU = M_Material.Rest_U;
+	float const RestV = M_Material.Rest_V;
+
+	// triangles in color order, each color is a contiguous range
+	for (auto *Arr : {&I0, &I1, &I2})
+	{
+		Arr->Reset(NumOfTriangles);
+	}
+	for (auto *Arr : {&Gu1, &Gu2, &Gv1, &Gv2, &WU, &WV, &TriangleKScale})
+	{
+		Arr->Reset(NumOfTriangles);
+	}
+	FRTGraphColoring TriangleColoring;
+	TriangleColoring.Build(Mesh->Indices, 3, NumOfVertices);
+	TriangleOffsets = TriangleColoring.Offsets;
+	for (int32 const i : TriangleColoring.Order)
+	{
+		int32 const P0 = Mesh->Indices[3 * i];
+		int32 const P1 = Mesh->Indices[3 * i + 1];
+		int32 const P2 = Mesh->Indices[3 * i + 2];
+		FClothTriangleStaticProperties const Tri(P0, P1, P2, Mesh->TexCoords[P0], Mesh->TexCoords[P1], Mesh->TexCoords[P2]);
+		I0.Add(P0);
+		I1.Add(P1);
+		I2.Add(P2);
+		Gu1.Add(Tri.dwudXScalar[1] / RestU);
+		Gu2.Add(Tri.dwudXScalar[2] / RestU);
+		Gv1.Add(Tri.dwvdXScalar[1] / RestV);
+		Gv2.Add(Tri.dwvdXScalar[2] / RestV);
+		float const A2 = Tri.a * Tri.a;
+		WU.Add(A2 * RestU * RestU);
+		WV.Add(A2 * RestV * RestV);
+		TriangleKScale.Add(Mesh->StiffnessScale.Num() > 0
+			? (Mesh->StiffnessScale[P0] + Mesh->StiffnessScale[P1] + Mesh->StiffnessScale[P2]) / 3.f : 1.f);
+	}
+	StretchEnergy.SetNumZeroed(NumOfTriangles);
+
+	// hinges, the rest shape is the mesh at setup
+	TArray<FHinge> Unordered;
+	TArray<uint32> HingeVertices;
+	TSet<uint32> VisitedEdges;
+	VisitedEdges.Reserve(other_half_of_edge.Num());
+	for (auto const Edge : other_half_of_edge)
+	{
+		if (Edge != UNKNOWN_HALF_EDGE && !VisitedEdges.Contains(Edge))
+		{
+			HalfEdgeRef const OtherE = otherHalfEdge(Edge);
+			if (!VisitedEdges.Contains(OtherE))
+			{
+				uint32 const V0 = toVertexIndexOfHalfEdge(nextHalfEdge(Edge));
+				uint32 const V1 = fromVertexIndexOfHalfEdge(Edge);
+				uint32 const V2 = toVertexIndexOfHalfEdge(Edge);
+				uint32 const V3 = toVertexIndexOfHalfEdge(nextHalfEdge(OtherE));
+				FHinge Hinge = {{int32(V1), int32(V2), int32(V0), int32(V3)}, {0, 0, 0, 0}, 0, 0};
+				if (FRTQuadraticBendKernel::HingeWeights(V0, V1, V2, V3, Mesh->Positions, Mesh->TexCoords, Hinge.W, Hinge.S))
+				{
+					FVector Rest(0, 0, 0);
+					for (int32 k = 0; k < 4; k ++)
+					{
+						Rest += Hinge.W[k] * Mesh->Positions[Hinge.Idx[k]];
+						HingeVertices.Add(Hinge.Idx[k]);
+					}
+					Hinge.RestNorm = Rest.Size();
+					Unordered.Add(Hinge);
+				}
+				VisitedEdges.Add(Edge);
+				VisitedEdges.Add(OtherE);
+			}
+		}
+	}
+	FRTGraphColoring HingeColoring;
+	HingeColoring.Build(HingeVertices, 4, NumOfVertices);
+	HingeOffsets = HingeColoring.Offsets;
+	Hinges.Reset(Unordered.Num());
+	HingeKScale.Reset(Unordered.Num());
+	for (int32 const i : HingeColoring.Order)
+	{
+		FHinge const& Hinge = Unordered[i];
+		Hinges.Add(Hinge);
+		// mean of the shared edge, as FRTBendKernel
+		HingeKScale.Add(Mesh->StiffnessScale.Num() > 0
+			? 0.5f * (Mesh->StiffnessScale[Hinge.Idx[0]] + Mesh->StiffnessScale[Hinge.Idx[1]]) : 1.f);
+	}
+	BendEnergy.SetNumZeroed(Hinges.Num());
+
+	// set up runtime simulation variables
+	Velocities.SetNumZeroed(NumOfVertices);
+	Pre_Positions.SetNumZeroed(NumOfVertices);
+	Inertial.SetNumZeroed(NumOfVertices);
+	Rhs.SetNumZeroed(NumOfVertices);
+	bAssembled = false;
+	bFactorized = false;
+	bFactorizationFailed = false;
+}
+
+bool FRTClothSystem_ProjectiveDynamics_CPU::PinsChanged() const
+{
+	if (PinnedVertices.Num() != ConstrainedVertices.Num()) return true;
+	for (int32 const i : ConstrainedVertices)
+	{
+		if (Rows[i] != INDEX_NONE) return true;
+	}
+	return false;
+}
+
+void FRTClothSystem_ProjectiveDynamics_CPU::Assemble()
+{
+	SCOPE_CYCLE_COUNTER(Assemble_Projective)
+	int32 const NumOfVertices = Mesh->Positions.Num();
+	PinnedVertices.Reset(ConstrainedVertices.Num());
+	for (int32 const i : ConstrainedVertices)
+	{
+		PinnedVertices.Add(i);
+	}
+	PinnedVertices.Sort();
+
+	Rows.SetNumUninitialized(NumOfVertices);
+	RowVertices.Reset(NumOfVertices);
+	for (int32 i = 0; i < NumOfVertices; i ++)
+	{
+		Rows[i] = ConstraintIndex[i] != INDEX_NONE ? INDEX_NONE : RowVertices.Num();
+		if (Rows[i] != INDEX_NONE)
+		{
+			RowVertices.Add(i);
+		}
+	}
+
+	// call Body(Vertices, Num, Weights(a, b)) for each element matrix w A^T A
+	float const K_Stretch = M_Material.K_Stretch;
+	float const K_Bend = M_Material.K_Bend;
+	auto ForEachElement = [&](auto const& Body)
+	{
+		for (int32 T = 0; T < I0.Num(); T ++)
+		{
+			float const Ku = K_Stretch * TriangleKScale[T] * WU[T];
+			float const Kv = K_Stretch * TriangleKScale[T] * WV[T];
+			int32 const Idx[3] = {I0[T], I1[T], I2[T]};
+			float const Gu[3] = {-Gu1[T] - Gu2[T], Gu1[T], Gu2[T]};
+			float const Gv[3] = {-Gv1[T] - Gv2[T], Gv1[T], Gv2[T]};
+			Body(Idx, 3, [&](int32 a, int32 b) {return Ku * Gu[a] * Gu[b] + Kv * Gv[a] * Gv[b];});
+		}
+		for (int32 H = 0; H < Hinges.Num(); H ++)
+		{
+			FHinge const& Hinge = Hinges[H];
+			float const K = K_Bend * HingeKScale[H] * Hinge.S;
+			Body(Hinge.Idx, 4, [&](int32 a, int32 b) {return K * Hinge.W[a] * Hinge.W[b];});
+		}
+	};
+
+	// pattern of the free rows
+	TArray<TArray<int32>> Adjacency;
+	Adjacency.SetNum(RowVertices.Num());
+	ForEachElement([&](int32 const* Idx, int32 Num, auto const&)
+	{
+		for (int32 a = 0; a < Num; a ++)
+		{
+			for (int32 b = 0; b < Num; b ++)
+			{
+				if (a != b && Rows[Idx[a]] != INDEX_NONE && Rows[Idx[b]] != INDEX_NONE)
+				{
+					Adjacency[Rows[Idx[a]]].AddUnique(Rows[Idx[b]]);
+				}
+			}
+		}
+	});
+	Cholesky.Analyze(Adjacency);
+
+	// values, entries of pinned vertices go to the right hand side
+	TMap<uint64, float> Couplings;
+	ForEachElement([&](int32 const* Idx, int32 Num, auto const& Weights)
+	{
+		for (int32 a = 0; a < Num; a ++)
+		{
+			int32 const RowA = Rows[Idx[a]];
+			if (RowA == INDEX_NONE) continue;
+			for (int32 b = 0; b < Num; b ++)
+			{
+				int32 const RowB = Rows[Idx[b]];
+				if (RowB == INDEX_NONE)
+				{
+					Couplings.FindOrAdd((uint64(RowA) << 32) | uint32(Idx[b])) += Weights(a, b);
+				}
+				else if (RowB <= RowA)
+				{
+					Cholesky.Add(RowA, RowB, Weights(a, b));
+				}
+			}
+		}
+	});
+	CouplingRows.Reset(Couplings.Num());
+	CouplingVertices.Reset(Couplings.Num());
+	CouplingValues.Reset(Couplings.Num());
+	for (auto const& Pair : Couplings)
+	{
+		CouplingRows.Add(int32(Pair.Key >> 32));
+		CouplingVertices.Add(int32(Pair.Key & 0xffffffff));
+		CouplingValues.Add(Pair.Value);
+	}
+	Cholesky.StoreValues();
+	bAssembled = true;
+	bFactorized = false;
+	bFactorizationFailed = false;
+	// new mesh, pins or material, the iteration matrix is another one
+	Chebyshev.Reset();
+}
+
+void FRTClothSystem_ProjectiveDynamics_CPU::Factorize(float Duration)
+{
+	SCOPE_CYCLE_COUNTER(Factorize_Projective)
+	Cholesky.RestoreValues();
+	float const InvH2 = 1.f / (Duration * Duration);
+	for (int32 r = 0; r < RowVertices.Num(); r ++)
+	{
+		Cholesky.Add(r, r, Masses[RowVertices[r]] * InvH2);
+	}
+	bFactorized = Cholesky.Factorize();
+	if (!bFactorized && !bFactorizationFailed)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Projective dynamics: system matrix is not positive definite, check density and stiffness"));
+	}
+	bFactorizationFailed = !bFactorized;
+	FactorizedDuration = Duration;
+	Solution.SetNumUninitialized(RowVertices.Num());
+	// only the inertia changed, the spectral radius moves with the step but stays close
+	Chebyshev.Refine();
+}
+
+void FRTClothSystem_ProjectiveDynamics_CPU::LocalStep(TArray<FVector> const& X)
+{
+	SCOPE_CYCLE_COUNTER(LocalStep_Projective)
+	FVector const* XData = X.GetData();
+	FVector *RhsData = Rhs.GetData();
+	float const K_Stretch = M_Material.K_Stretch;
+	float const K_Bend = M_Material.K_Bend;
+
+	// membrane: closest rotation of F
+	FRTGraphColoring::ParallelForEachColor(TriangleOffsets, ChunkSize, [&](int32, int32 Begin, int32 End)
+	{
+		for (int32 T = Begin; T < End; T ++)
+		{
+			FVector const X0 = XData[I0[T]];
+			FVector const E1 = XData[I1[T]] - X0;
+			FVector const E2 = XData[I2[T]] - X0;
+			FVector const Fu = E1 * Gu1[T] + E2 * Gu2[T];
+			FVector const Fv = E1 * Gv1[T] + E2 * Gv2[T];
+			FVector Ru = Fu, Rv = Fv;
+			// orthonormal frame of the triangle plane, F = B * [F00 F01; 0 F11], same as FRTCorotationalKernel
+			float const FuNorm = Fu.Size();
+			FVector const N = Fu ^ Fv;
+			float const NNorm = N.Size();
+			if (FuNorm > SMALL_NUMBER && NNorm > SMALL_NUMBER)
+			{
+				FVector const B1 = Fu / FuNorm;
+				FVector const B2 = (N ^ B1) / NNorm;
+				float const c = FuNorm + (Fv | B2);
+				float const s = -(Fv | B1);
+				float const InvH = FMath::InvSqrt(c * c + s * s);
+				Ru = (c * B1 + s * B2) * InvH;
+				Rv = (c * B2 - s * B1) * InvH;
+			}
+			float const Ku = K_Stretch * TriangleKScale[T] * WU[T];
+			float const Kv = K_Stretch * TriangleKScale[T] * WV[T];
+			StretchEnergy[T] = 0.5f * (Ku * (Fu - Ru).SizeSquared() + Kv * (Fv - Rv).SizeSquared());
+			FVector const Pu = Ku * Ru, Pv = Kv * Rv;
+			RhsData[I0[T]] -= (Gu1[T] + Gu2[T]) * Pu + (Gv1[T] + Gv2[T]) * Pv;
+			RhsData[I1[T]] += Gu1[T] * Pu + Gv1[T] * Pv;
+			RhsData[I2[T]] += Gu2[T] * Pu + Gv2[T] * Pv;
+		}
+	});
+
+	// bend: W^T X scaled to its rest length
+	FRTGraphColoring::ParallelForEachColor(HingeOffsets, ChunkSize, [&](int32, int32 Begin, int32 End)
+	{
+		for (int32 H = Begin; H < End; H ++)
+		{
+			FHinge const& Hinge = Hinges[H];
+			FVector Q(0, 0, 0);
+			for (int32 k = 0; k < 4; k ++)
+			{
+				Q += Hinge.W[k] * XData[Hinge.Idx[k]];
+			}
+			float const QNorm = Q.Size();
+			FVector const P = QNorm > SMALL_NUMBER ? Q * (Hinge.RestNorm / QNorm) : FVector(0, 0, 0);
+			float const K = K_Bend * HingeKScale[H] * Hinge.S;
+			BendEnergy[H] = 0.5f * K * (Q - P).SizeSquared();
+			for (int32 k = 0; k < 4; k ++)
+			{
+				RhsData[Hinge.Idx[k]] += (K * Hinge.W[k]) * P;
+			}
+		}
+	});
+}
+
+FRTClothEnergy FRTClothSystem_ProjectiveDynamics_CPU::Energy() const
+{
+	FRTClothEnergy Res;
+	for (float const E : StretchEnergy)
+	{
+		Res.Stretch += E;
+	}
+	for (float const E : BendEnergy)
+	{
+		Res.Bend += E;
+	}
+	Res.Kinetic = KineticEnergy(Velocities);
+	return Res;
+}
+
+void FRTClothSystem_ProjectiveDynamics_CPU::TickOnce(float Duration)
+{
+	SCOPE_CYCLE_COUNTER(TIME_COST_Projective)
+	FRTClothSystemBase::TickOnce(Duration);
+	TArray<FVector> &X = Mesh->Positions;
+	int32 const NumOfVertices = X.Num();
+
+	if (!bAssembled || PinsChanged())
+	{
+		Assemble();
+	}
+	if ((!bFactorized && !bFactorizationFailed) || Duration != FactorizedDuration)
+	{
+		Factorize(Duration);
+	}
+	if (!bFactorized) return;
+
+	// external forces, Inertial holds them until the target is computed
+	TArray<FVector> &Forces = Inertial;
+	for (int32 i = 0; i < NumOfVertices; i ++)
+	{
+		Forces[i] = Masses[i] * Gravity - M_Material.AirFriction * (Velocities[i] - WindVelocity) * Masses[i];
+	}
+	if (M_Material.EnableInnerCollision)
+	{
+		UpdateTriangleProperties(X, Velocities);
+		AddCollisionSpringForces(Forces, X, Velocities);
+	}
+
+	// inertial target, constrained vertices take an explicit step and stay there
+	for (int32 i = 0; i < NumOfVertices; i ++)
+	{
+		FVector Acc = Forces[i] / Masses[i] + DeltaClothAttachedVelocity / Duration;
+		if (FRTMatrix3 const* Constraint = FindConstraint(i))
+		{
+			Acc = *Constraint * Acc;
+		}
+		Pre_Positions[i] = X[i];
+		Inertial[i] = X[i] + Duration * (Velocities[i] + Duration * Acc);
+		X[i] = Inertial[i];
+	}
+
+	float const InvH2 = 1.f / (Duration * Duration);
+	if (bChebyshev)
+	{
+		Chebyshev.BeginSolve(X);
+	}
+	for (int32 Iter = 0; Iter < Iterations; Iter ++)
+	{
+		ParallelFor((NumOfVertices + ChunkSize - 1) / ChunkSize, [&](int32 Chunk)
+		{
+			int32 const End = std::min(NumOfVertices, (Chunk + 1) * ChunkSize);
+			for (int32 i = Chunk * ChunkSize; i < End; i ++)
+			{
+				Rhs[i] = (Masses[i] * InvH2) * Inertial[i];
+			}
+		});
+		LocalStep(X);
+		{
+			SCOPE_CYCLE_COUNTER(GlobalStep_Projective)
+			for (int32 r = 0; r < RowVertices.Num(); r ++)
+			{
+				Solution[r] = Rhs[RowVertices[r]];
+			}
+			for (int32 c = 0; c < CouplingRows.Num(); c ++)
+			{
+				Solution[CouplingRows[c]] -= CouplingValues[c] * X[CouplingVertices[c]];
+			}
+			Cholesky.Solve(Solution);
+			for (int32 r = 0; r < RowVertices.Num(); r ++)
+			{
+				X[RowVertices[r]] = Solution[r];
+			}
+		}
+		if (bChebyshev)
+		{
+			Chebyshev.Iterate(X);
+		}
+	}
+	if (bChebyshev)
+	{
+		Chebyshev.EndSolve();
+	}
+
+	for (int32 i = 0; i < NumOfVertices; i ++)
+	{
+		Velocities[i] = (X[i] - Pre_Positions[i]) / Duration;
+	}
+	if (M_Material.EnableCollision)
+		SolveCollision(Pre_Positions, X, Velocities, Duration);
+}
@@ -2,63 +2,55 @@
 
 DECLARE_STATS_GROUP(TEXT("RTCloth(Verlet)"), STATGROUP_RTCloth_Verlet, STATCAT_Advanced);
 DECLARE_CYCLE_STAT(TEXT("One Frame Cost"), TIME_COST_Verlet, STATGROUP_RTCloth_Verlet);
-DECLARE_CYCLE_STAT(TEXT("StretchConditions"), StretchConditions_Verlet,STATGROUP_RTCloth_Verlet);
-DECLARE_CYCLE_STAT(TEXT("ShearConditions"), ShearConditions_Verlet,STATGROUP_RTCloth_Verlet);
+DECLARE_CYCLE_STAT(TEXT("StretchShearConditions"), StretchShearConditions_Verlet,STATGROUP_RTCloth_Verlet);
 DECLARE_CYCLE_STAT(TEXT("BendConditions"), BendConditions_Verlet,STATGROUP_RTCloth_Verlet);
 DECLARE_CYCLE_STAT(TEXT("Integration"), Integration_Verlet,STATGROUP_RTCloth_Verlet);
+DECLARE_CYCLE_STAT(TEXT("StrainLimit"), StrainLimit_Verlet,STATGROUP_RTCloth_Verlet);
 
 void FRTClothSystem_Verlet_CPU::Acceleration()
 {
 	// calculate forces
 	{
-		SCOPE_CYCLE_COUNTER(StretchConditions_Verlet)
-		for (auto &Con : StretchConditions)
-		{
-			Con.UpdateCondition(Mesh->Positions, Velocities, Mesh->TexCoords);
-			Con.ComputeForces(M_Material.K_Stretch, M_Material.D_Stretch, Forces, Forces);
-		}
-	}
-	{
-		SCOPE_CYCLE_COUNTER(ShearConditions_Verlet)
-		for (auto &Con : ShearConditions)
-		{
-			Con.UpdateCondition(Mesh->Positions, Velocities, Mesh->TexCoords);
-			// Serious numerical un-stability meet while using original Shader Damping
-			Con.ComputeForces(M_Material.K_Shear, M_Material.D_Shear, Forces, Forces);
-		}
+		SCOPE_CYCLE_COUNTER(StretchShearConditions_Verlet)
+		// Serious numerical un-stability meet while using original Shader Damping
+		StretchShearKernel.ComputeForces(Mesh->Positions, Velocities, Forces);
 	}
 	{
 		SCOPE_CYCLE_COUNTER(BendConditions_Verlet)
-		for (auto &Con : BendConditions)
-		{
-			Con.UpdateCondition(Mesh->Positions, Velocities, Mesh->TexCoords);
-			Con.ComputeForces(M_Material.K_Bend, M_Material.D_Bend, Forces, Forces);
-		}
-	}
-	for (int i = 0; i < Masses.Num(); i ++)
-	{
-		Forces[i] += - M_Material.AirFriction * (Velocities[i] - WindVelocity) * Masses[i];
+		BendKernel.ComputeForces(Mesh->Positions, Velocities, Mesh->TexCoords, Forces);
 	}
 }
 
+FRTClothEnergy FRTClothSystem_Verlet_CPU::Energy() const
+{
+	FRTClothEnergy Res;
+	Res.Stretch = StretchShearKernel.LastStretchEnergy();
+	Res.Shear = StretchShearKernel.LastShearEnergy();
+	Res.Bend = BendKernel.LastEnergy();
+	Res.Kinetic = KineticEnergy(Velocities);
+	return Res;
+}
+
+void FRTClothSystem_Verlet_CPU::MaterialUpdated()
+{
+	StretchShearKernel.SetParams(FRTMembraneParams::FromMaterial(M_Material));
+	BendKernel.SetParams(M_Material.K_Bend, M_Material.D_Bend);
+	StrainLimiter.SetLimits(M_Material.MinStretch, M_Material.MaxStretch, M_Material.StrainLimitIterations);
+}
+
 void FRTClothSystem_Verlet_CPU::PrepareSimulation()
 {
 	// setup shear and stretch conditions
-	ShearConditions.Reserve(this->Mesh->Indices.Num() / 3);
-	StretchConditions.Reserve(this->Mesh->Indices.Num() / 3);
-	for (int32 i = 0; i < this->Mesh->Indices.Num() / 3; i ++)
-	{
-		auto &F = getFaceAt(i);
-		ShearConditions.Add({Mesh.get(), F.vertex_index[0], F.vertex_index[1], F.vertex_index[2]});
-		StretchConditions.Add({Mesh.get(), F.vertex_index[0], F.vertex_index[1], F.vertex_index[2], M_Material.Rest_U, M_Material.Rest_V});
-	}
+	StretchShearKernel.Init(*Mesh, M_Material.Rest_U, M_Material.Rest_V);
+	StretchShearKernel.SetScaleMaps(Mesh->StiffnessScale, Mesh->DampingScale);
+	StrainLimiter.Init(*Mesh, M_Material.Rest_U, M_Material.Rest_V);
 	// set up bend conditions
 	uint32 PairNum = 0;
 	for (auto const E : other_half_of_edge)
 	{
 		PairNum += (E != UNKNOWN_HALF_EDGE);
 	}
-	BendConditions.Reserve(PairNum / 2);
+	BendKernel.Reset(PairNum / 2, M_Material.InitTheta);
 
 	TSet<uint32> VisitedEdges;
 	VisitedEdges.Reserve(other_half_of_edge.Num());
@@ -74,49 +66,58 @@ void FRTClothSystem_Verlet_CPU::PrepareSimulation()
 				uint32 const V1 = fromVertexIndexOfHalfEdge(Edge);
 				uint32 const V2 = toVertexIndexOfHalfEdge(Edge);
 				uint32 const V3 = toVertexIndexOfHalfEdge(nextHalfEdge(OtherE));
-				BendConditions.Add({V0, V1, V2, V3, M_Material.InitTheta});
+				BendKernel.Add(V0, V1, V2, V3, Mesh->TexCoords);
 				VisitedEdges.Add(Edge);
 				VisitedEdges.Add(OtherE);
 			}
 		}
 	}
+	BendKernel.Finalize(Mesh->Positions.Num());
+	BendKernel.SetScaleMaps(Mesh->StiffnessScale, Mesh->DampingScale);
+
+	// pick coloring or private force buffers, the pinned mode or whichever is faster on this mesh
+	StretchShearKernel.SelectScatterMode(Mesh->Positions, PinnedScatterMode);
+	BendKernel.SelectScatterMode(Mesh->Positions, Mesh->TexCoords, PinnedScatterMode);
 
 	// set up runtime simulation variables
+	Integrator.Init(InverseMasses);
 	Pre_Positions = Mesh->Positions;
 	Forces.SetNumZeroed(Mesh->Positions.Num());
 	Velocities.SetNumZeroed(Mesh->Positions.Num());
+	PreDuration = 0;
+	VelocityScale = 1;
 }
 
 void FRTClothSystem_Verlet_CPU::TickOnce(float Duration)
 {
 	SCOPE_CYCLE_COUNTER(TIME_COST_Verlet);
 	FRTClothSystemBase::TickOnce(Duration);
-	// set up gravity
-	for (int32 i = 0; i < Masses.Num(); i ++)
-	{
-		Forces[i] = Masses[i] * Gravity;
-	}
+	// gravity and air friction are added by the integrator
+	FMemory::Memzero(Forces.GetData(), Forces.Num() * sizeof(FVector));
 	if (M_Material.EnableInnerCollision)
 	{
 		UpdateTriangleProperties(Mesh->Positions, Velocities);
 		AddCollisionSpringForces(Forces, Mesh->Positions, Velocities);
 	}
 	Acceleration();
+	// the previous step, the first one starts with a constant step
+	float const PrevH = PreDuration > 0 ? PreDuration : Duration;
+	PreDuration = Duration;
+	VelocityScale = (Duration + PrevH) / Duration;
 	// integration
 	{
 		SCOPE_CYCLE_COUNTER(Integration_Verlet)
-		for (int32 i = 0; i < Masses.Num(); i ++)
-		{
-			auto Acc =  Forces[i] / Masses[i] + DeltaClothAttachedVelocity / Duration;
-			if (Constraints.Contains(i))
-			{
-				Acc = Constraints[i] * Acc;
-			}
-			auto const Pos_Old = Mesh->Positions[i];
-			Mesh->Positions[i] = 2 * Mesh->Positions[i] - Pre_Positions[i] + Acc * (Duration * Duration);
-			Velocities[i] = (Mesh->Positions[i] - Pos_Old) / (2 * Duration);
-			Pre_Positions[i] = Pos_Old;
-		}
+		// Acc = F / m + g - AirFriction * (V - Wind) + dV / ((h + PrevH) / 2), the step changes the velocity by (h + PrevH) / 2 * Acc
+		Integrator.SetAcceleration(
+			Gravity + M_Material.AirFriction * WindVelocity + DeltaClothAttachedVelocity * (2.f / (Duration + PrevH)), M_Material.AirFriction);
+		Integrator.Verlet(Mesh->Positions, Pre_Positions, Velocities, Forces, Duration, PrevH, ConstrainedVertices, ConstraintMats);
+		// Pre_Positions holds the new positions, the current ones become X_{i-1}
+		Swap(Mesh->Positions, Pre_Positions);
+	}
+	if (StrainLimiter.IsEnabled())
+	{
+		SCOPE_CYCLE_COUNTER(StrainLimit_Verlet)
+		StrainLimiter.Apply(Mesh->Positions, Velocities, 1.f / (Duration + PrevH), InverseMasses, ConstraintIndex);
 	}
 	if (M_Material.EnableCollision)
 		SolveCollision(Pre_Positions, Mesh->Positions, Velocities, Duration);
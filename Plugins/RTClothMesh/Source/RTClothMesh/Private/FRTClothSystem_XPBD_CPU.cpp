@@ -0,0 +1,279 @@
+﻿#include "FRTClothSystem_XPBD_CPU.h"
+
+#include "FRTGraphColoring.h"
+#include "FRTQuadraticBendKernel.h"
+
+DECLARE_STATS_GROUP(TEXT("RTCloth(xpbd)"), STATGROUP_RTCloth_XPBD, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("One Frame Cost"), TIME_COST_XPBD, STATGROUP_RTCloth_XPBD);
+DECLARE_CYCLE_STAT(TEXT("DistanceConstraints"), DistanceConstraints_XPBD, STATGROUP_RTCloth_XPBD);
+DECLARE_CYCLE_STAT(TEXT("BendConstraints"), BendConstraints_XPBD, STATGROUP_RTCloth_XPBD);
+
+void FRTClothSystem_XPBD_CPU::PrepareSimulation()
+{
+	int32 const NumOfVertices = Mesh->Positions.Num();
+	float const RestU = M_Material.Rest_U;
+	float const RestV = M_Material.Rest_V;
+	TArray<float> const& KScale = Mesh->StiffnessScale;
+	TArray<float> const& DScale = Mesh->DampingScale;
+
+	// uv area of each triangle
+	TArray<float> Areas;
+	Areas.SetNumUninitialized(Mesh->Indices.Num() / 3);
+	for (int32 i = 0; i < Areas.Num(); i ++)
+	{
+		int32 const P0 = Mesh->Indices[3 * i];
+		int32 const P1 = Mesh->Indices[3 * i + 1];
+		int32 const P2 = Mesh->Indices[3 * i + 2];
+		Areas[i] = FClothTriangleStaticProperties(P0, P1, P2, Mesh->TexCoords[P0], Mesh->TexCoords[P1], Mesh->TexCoords[P2]).a;
+	}
+
+	// one distance constraint per edge, from the half edge with the lower index
+	TArray<uint32> EdgeVertices;
+	TArray<float> UnorderedRest, UnorderedStiffness, UnorderedDamping;
+	for (int32 Edge = 0; Edge < other_half_of_edge.Num(); Edge ++)
+	{
+		HalfEdgeRef const OtherE = other_half_of_edge[Edge];
+		if (OtherE != UNKNOWN_HALF_EDGE && OtherE < HalfEdgeRef(Edge)) continue;
+		uint32 const V0 = fromVertexIndexOfHalfEdge(Edge);
+		uint32 const V1 = toVertexIndexOfHalfEdge(Edge);
+		float const L = ((Mesh->TexCoords[V1] - Mesh->TexCoords[V0]) * FVector2D(RestU, RestV)).Size();
+		if (L < SMALL_NUMBER) continue;
+		float Weight = FMath::Square(Areas[faceIndexOfHalfEdge(Edge)]);
+		if (OtherE != UNKNOWN_HALF_EDGE)
+		{
+			Weight += FMath::Square(Areas[faceIndexOfHalfEdge(OtherE)]);
+		}
+		float const Scale = KScale.Num() > 0 ? 0.5f * (KScale[V0] + KScale[V1]) : 1.f;
+		float const Damping = DScale.Num() > 0 ? 0.5f * (DScale[V0] + DScale[V1]) : 1.f;
+		EdgeVertices.Add(V0);
+		EdgeVertices.Add(V1);
+		UnorderedRest.Add(L);
+		UnorderedStiffness.Add(Scale * Weight * RestU * RestV / (L * L));
+		UnorderedDamping.Add(Damping * Weight * RestU * RestV / (L * L));
+	}
+	FRTGraphColoring EdgeColoring;
+	EdgeColoring.Build(EdgeVertices, 2, NumOfVertices);
+	EdgeOffsets = EdgeColoring.Offsets;
+	for (auto *Arr : {&E0, &E1})
+	{
+		Arr->Reset(UnorderedRest.Num());
+	}
+	RestLength.Reset(UnorderedRest.Num());
+	EdgeStiffness.Reset(UnorderedRest.Num());
+	EdgeDamping.Reset(UnorderedRest.Num());
+	for (int32 const i : EdgeColoring.Order)
+	{
+		E0.Add(EdgeVertices[2 * i]);
+		E1.Add(EdgeVertices[2 * i + 1]);
+		RestLength.Add(UnorderedRest[i]);
+		EdgeStiffness.Add(UnorderedStiffness[i]);
+		EdgeDamping.Add(UnorderedDamping[i]);
+	}
+
+	// bend constraints, the rest shape is the mesh at setup
+	TArray<FHinge> Unordered;
+	TArray<uint32> HingeVertices;
+	TSet<uint32> VisitedEdges;
+	VisitedEdges.Reserve(other_half_of_edge.Num());
+	for (auto const Edge : other_half_of_edge)
+	{
+		if (Edge != UNKNOWN_HALF_EDGE && !VisitedEdges.Contains(Edge))
+		{
+			HalfEdgeRef const OtherE = otherHalfEdge(Edge);
+			if (!VisitedEdges.Contains(OtherE))
+			{
+				uint32 const V0 = toVertexIndexOfHalfEdge(nextHalfEdge(Edge));
+				uint32 const V1 = fromVertexIndexOfHalfEdge(Edge);
+				uint32 const V2 = toVertexIndexOfHalfEdge(Edge);
+				uint32 const V3 = toVertexIndexOfHalfEdge(nextHalfEdge(OtherE));
+				FHinge Hinge = {{int32(V1), int32(V2), int32(V0), int32(V3)}, {0, 0, 0, 0}, 0, 0, 0};
+				if (FRTQuadraticBendKernel::HingeWeights(V0, V1, V2, V3, Mesh->Positions, Mesh->TexCoords, Hinge.W, Hinge.S))
+				{
+					FVector Rest(0, 0, 0);
+					for (int32 k = 0; k < 4; k ++)
+					{
+						Rest += Hinge.W[k] * Mesh->Positions[Hinge.Idx[k]];
+						HingeVertices.Add(Hinge.Idx[k]);
+					}
+					Hinge.RestNorm = Rest.Size();
+					// mean of the shared edge, as FRTBendKernel
+					Hinge.SD = Hinge.S * (DScale.Num() > 0 ? 0.5f * (DScale[V1] + DScale[V2]) : 1.f);
+					Hinge.S *= KScale.Num() > 0 ? 0.5f * (KScale[V1] + KScale[V2]) : 1.f;
+					Unordered.Add(Hinge);
+				}
+				VisitedEdges.Add(Edge);
+				VisitedEdges.Add(OtherE);
+			}
+		}
+	}
+	FRTGraphColoring HingeColoring;
+	HingeColoring.Build(HingeVertices, 4, NumOfVertices);
+	HingeOffsets = HingeColoring.Offsets;
+	Hinges.Reset(Unordered.Num());
+	for (int32 const i : HingeColoring.Order)
+	{
+		Hinges.Add(Unordered[i]);
+	}
+
+	EdgeLambda.SetNumZeroed(E0.Num());
+	HingeLambda.SetNumZeroed(Hinges.Num());
+	StretchEnergy.SetNumZeroed(E0.Num());
+	BendEnergy.SetNumZeroed(Hinges.Num());
+
+	// set up runtime simulation variables
+	InvMasses.SetNumZeroed(NumOfVertices);
+	Velocities.SetNumZeroed(NumOfVertices);
+	Pre_Positions.SetNumZeroed(NumOfVertices);
+	Forces.SetNumZeroed(NumOfVertices);
+}
+
+void FRTClothSystem_XPBD_CPU::SolveConstraints(float Duration)
+{
+	FVector *X = Mesh->Positions.GetData();
+	FVector const *Pre = Pre_Positions.GetData();
+	float const InvH2 = 1.f / (Duration * Duration);
+	float const K_Stretch = M_Material.K_Stretch;
+	float const K_Bend = M_Material.K_Bend;
+	float const D_Stretch = M_Material.D_Stretch;
+	float const D_Bend = M_Material.D_Bend;
+
+	if (K_Stretch > 0)
+	{
+		SCOPE_CYCLE_COUNTER(DistanceConstraints_XPBD)
+		FRTGraphColoring::ParallelForEachColor(EdgeOffsets, ChunkSize, [&](int32, int32 Begin, int32 End)
+		{
+			for (int32 e = Begin; e < End; e ++)
+			{
+				float const W0 = InvMasses[E0[e]], W1 = InvMasses[E1[e]];
+				float const K = K_Stretch * EdgeStiffness[e];
+				FVector const D = X[E0[e]] - X[E1[e]];
+				float const Len = D.Size();
+				if (W0 + W1 == 0 || K <= 0 || Len < SMALL_NUMBER)
+				{
+					StretchEnergy[e] = 0;
+					continue;
+				}
+				float const C = Len - RestLength[e];
+				StretchEnergy[e] = 0.5f * K * C * C;
+				float const Alpha = InvH2 / K;
+				FVector const Grad = D / Len;
+				// grad C (X - X_n) is the constraint rate times h
+				float const Gamma = Alpha * D_Stretch * EdgeDamping[e] * Duration;
+				float const Rate = FVector::DotProduct(Grad, (X[E0[e]] - Pre[E0[e]]) - (X[E1[e]] - Pre[E1[e]]));
+				float const DLambda = (-C - Alpha * EdgeLambda[e] - Gamma * Rate) / ((1 + Gamma) * (W0 + W1) + Alpha);
+				EdgeLambda[e] += DLambda;
+				X[E0[e]] += (W0 * DLambda) * Grad;
+				X[E1[e]] -= (W1 * DLambda) * Grad;
+			}
+		});
+	}
+
+	if (K_Bend > 0)
+	{
+		SCOPE_CYCLE_COUNTER(BendConstraints_XPBD)
+		FRTGraphColoring::ParallelForEachColor(HingeOffsets, ChunkSize, [&](int32, int32 Begin, int32 End)
+		{
+			for (int32 H = Begin; H < End; H ++)
+			{
+				FHinge const& Hinge = Hinges[H];
+				FVector Q(0, 0, 0);
+				float Denominator = 0;
+				for (int32 k = 0; k < 4; k ++)
+				{
+					Q += Hinge.W[k] * X[Hinge.Idx[k]];
+					Denominator += InvMasses[Hinge.Idx[k]] * Hinge.W[k] * Hinge.W[k];
+				}
+				float const QNorm = Q.Size();
+				float const K = K_Bend * Hinge.S;
+				if (Denominator == 0 || K <= 0 || QNorm < SMALL_NUMBER)
+				{
+					BendEnergy[H] = 0;
+					continue;
+				}
+				// grad C of vertex k is W[k] * Q / |Q|
+				float const C = QNorm - Hinge.RestNorm;
+				BendEnergy[H] = 0.5f * K * C * C;
+				float const Alpha = InvH2 / K;
+				FVector const N = Q / QNorm;
+				float const Gamma = Alpha * D_Bend * Hinge.SD * Duration;
+				float Rate = 0;
+				if (Gamma > 0)
+				{
+					for (int32 k = 0; k < 4; k ++)
+					{
+						Rate += Hinge.W[k] * FVector::DotProduct(N, X[Hinge.Idx[k]] - Pre[Hinge.Idx[k]]);
+					}
+				}
+				float const DLambda = (-C - Alpha * HingeLambda[H] - Gamma * Rate) / ((1 + Gamma) * Denominator + Alpha);
+				HingeLambda[H] += DLambda;
+				for (int32 k = 0; k < 4; k ++)
+				{
+					X[Hinge.Idx[k]] += (InvMasses[Hinge.Idx[k]] * Hinge.W[k] * DLambda) * N;
+				}
+			}
+		});
+	}
+}
+
+FRTClothEnergy FRTClothSystem_XPBD_CPU::Energy() const
+{
+	FRTClothEnergy Res;
+	for (float const E : StretchEnergy)
+	{
+		Res.Stretch += E;
+	}
+	for (float const E : BendEnergy)
+	{
+		Res.Bend += E;
+	}
+	Res.Kinetic = KineticEnergy(Velocities);
+	return Res;
+}
+
+void FRTClothSystem_XPBD_CPU::TickOnce(float Duration)
+{
+	SCOPE_CYCLE_COUNTER(TIME_COST_XPBD)
+	FRTClothSystemBase::TickOnce(Duration);
+	TArray<FVector> &X = Mesh->Positions;
+	int32 const NumOfVertices = X.Num();
+
+	// external forces
+	for (int32 i = 0; i < NumOfVertices; i ++)
+	{
+		Forces[i] = Masses[i] * Gravity - M_Material.AirFriction * (Velocities[i] - WindVelocity) * Masses[i];
+	}
+	if (M_Material.EnableInnerCollision)
+	{
+		UpdateTriangleProperties(X, Velocities);
+		AddCollisionSpringForces(Forces, X, Velocities);
+	}
+
+	// predict, constrained vertices take their constrained step and are attached there
+	for (int32 i = 0; i < NumOfVertices; i ++)
+	{
+		FVector Acc = Forces[i] / Masses[i] + DeltaClothAttachedVelocity / Duration;
+		InvMasses[i] = 1.f / Masses[i];
+		if (FRTMatrix3 const* Constraint = FindConstraint(i))
+		{
+			Acc = *Constraint * Acc;
+			InvMasses[i] = 0;
+		}
+		Velocities[i] += Duration * Acc;
+		Pre_Positions[i] = X[i];
+		X[i] += Duration * Velocities[i];
+	}
+
+	for (auto &Lambda : EdgeLambda) Lambda = 0;
+	for (auto &Lambda : HingeLambda) Lambda = 0;
+	for (int32 Iter = 0; Iter < Iterations; Iter ++)
+	{
+		SolveConstraints(Duration);
+	}
+
+	for (int32 i = 0; i < NumOfVertices; i ++)
+	{
+		Velocities[i] = (X[i] - Pre_Positions[i]) / Duration;
+	}
+	if (M_Material.EnableCollision)
+		SolveCollision(Pre_Positions, X, Velocities, Duration);
+}
@@ -0,0 +1,335 @@
+﻿#include "FRTCorotationalKernel.h"
+
+#include "FRTStretchCondition.h"
+#include "FRTShearCondition.h"
+#include "FRTGraphColoring.h"
+
+void FRTCorotationalKernel::Init(FClothRawMesh const& Mesh, float Rest_U, float Rest_V)
+{
+	RestU = Rest_U;
+	RestV = Rest_V;
+	int32 const NumOfTriangles = Mesh.Indices.Num() / 3;
+	for (auto *Arr : {&I0, &I1, &I2})
+	{
+		Arr->Reset(NumOfTriangles);
+	}
+	for (auto *Arr : {&Gu1, &Gu2, &Gv1, &Gv2, &WU, &WV, &WS, &KScale, &DScale})
+	{
+		Arr->Reset(NumOfTriangles);
+	}
+
+	// store triangles in color order, each color is a contiguous range
+	FRTGraphColoring Coloring;
+	Coloring.Build(Mesh.Indices, 3, Mesh.Positions.Num());
+	ColorOffsets = Coloring.Offsets;
+	for (int32 const i : Coloring.Order)
+	{
+		int32 const P0 = Mesh.Indices[3 * i];
+		int32 const P1 = Mesh.Indices[3 * i + 1];
+		int32 const P2 = Mesh.Indices[3 * i + 2];
+		FClothTriangleStaticProperties const Tri(P0, P1, P2, Mesh.TexCoords[P0], Mesh.TexCoords[P1], Mesh.TexCoords[P2]);
+		I0.Add(P0);
+		I1.Add(P1);
+		I2.Add(P2);
+		Gu1.Add(Tri.dwudXScalar[1] / RestU);
+		Gu2.Add(Tri.dwudXScalar[2] / RestU);
+		Gv1.Add(Tri.dwvdXScalar[1] / RestV);
+		Gv2.Add(Tri.dwvdXScalar[2] / RestV);
+		float const A2 = Tri.a * Tri.a;
+		WU.Add(A2 * RestU * RestU);
+		WV.Add(A2 * RestV * RestV);
+		WS.Add(A2 * RestU * RestU * RestV * RestV);
+		KScale.Add(1.f);
+		DScale.Add(1.f);
+	}
+	StretchEnergy.SetNumZeroed(NumOfTriangles);
+	ShearEnergy.SetNumZeroed(NumOfTriangles);
+}
+
+void FRTCorotationalKernel::SetScaleMaps(TArray<float> const& VertexK, TArray<float> const& VertexD)
+{
+	for (int32 T = 0; T < Num(); T ++)
+	{
+		KScale[T] = VertexK.Num() > 0 ? (VertexK[I0[T]] + VertexK[I1[T]] + VertexK[I2[T]]) / 3.f : 1.f;
+		DScale[T] = VertexD.Num() > 0 ? (VertexD[I0[T]] + VertexD[I1[T]] + VertexD[I2[T]]) / 3.f : 1.f;
+	}
+}
+
+bool FRTCorotationalKernel::Rotation(int32 T, FVector const* X, FVector &Ru, FVector &Rv) const
+{
+	FVector const E1 = X[I1[T]] - X[I0[T]];
+	FVector const E2 = X[I2[T]] - X[I0[T]];
+	FVector const Fu = E1 * Gu1[T] + E2 * Gu2[T];
+	FVector const Fv = E1 * Gv1[T] + E2 * Gv2[T];
+	// orthonormal frame of the triangle plane, F = B * [F00 F01; 0 F11]
+	float const FuNorm = Fu.Size();
+	FVector const N = Fu ^ Fv;
+	float const NNorm = N.Size();
+	if (FuNorm < SMALL_NUMBER || NNorm < SMALL_NUMBER) return false;
+	FVector const B1 = Fu / FuNorm;
+	FVector const B2 = (N ^ B1) / NNorm;
+	// polar decomposition of the 2x2 matrix: the rotation [c -s; s c] maximizing trace(R^T F)
+	float const c = FuNorm + (Fv | B2);
+	float const s = -(Fv | B1);
+	float const InvH = FMath::InvSqrt(c * c + s * s);
+	Ru = (c * B1 + s * B2) * InvH;
+	Rv = (c * B2 - s * B1) * InvH;
+	return true;
+}
+
+template <bool bDerivatives>
+void FRTCorotationalKernel::Pass(int32 Begin, int32 End, FVector const* X, FVector const* V, FVector *Forces,
+	FRTBBSSMatrix<float> *dfdx, FRTBBSSMatrix<float> *dddv) const
+{
+	bool const bDamping = Params.D_Stretch != 0 || Params.D_Shear != 0;
+	for (int32 T = Begin; T < End; T ++)
+	{
+		FVector Ru, Rv;
+		if (!Rotation(T, X, Ru, Rv))
+		{
+			StretchEnergy[T] = 0;
+			ShearEnergy[T] = 0;
+			continue;
+		}
+		int32 const Idx[3] = {I0[T], I1[T], I2[T]};
+		float const Gu[3] = {-Gu1[T] - Gu2[T], Gu1[T], Gu2[T]};
+		float const Gv[3] = {-Gv1[T] - Gv2[T], Gv1[T], Gv2[T]};
+		FVector const E1 = X[Idx[1]] - X[Idx[0]];
+		FVector const E2 = X[Idx[2]] - X[Idx[0]];
+		FVector const Fu = E1 * Gu[1] + E2 * Gu[2];
+		FVector const Fv = E1 * Gv[1] + E2 * Gv[2];
+		// material of this triangle
+		float const Ku = KScale[T] * Params.K_Stretch * WU[T], Kv = KScale[T] * Params.K_Stretch * WV[T];
+		float const Ks = KScale[T] * Params.K_Shear * WS[T];
+		float const Du = DScale[T] * Params.D_Stretch * WU[T], Dv = DScale[T] * Params.D_Stretch * WV[T];
+		float const Ds = DScale[T] * Params.D_Shear * WS[T];
+
+		// strain e = R^T F - I, and 2 e_uv
+		float const Euu = (Ru | Fu) - 1.f;
+		float const Evv = (Rv | Fv) - 1.f;
+		float const Guv = (Ru | Fv) + (Rv | Fu);
+		StretchEnergy[T] = 0.5f * (Ku * Euu * Euu + Kv * Evv * Evv);
+		ShearEnergy[T] = 0.5f * Ks * Guv * Guv;
+
+		// stress
+		float Suu = Ku * Euu, Svv = Kv * Evv, Suv = Ks * Guv;
+		if (bDamping)
+		{
+			FVector const V1 = V[Idx[1]] - V[Idx[0]];
+			FVector const V2 = V[Idx[2]] - V[Idx[0]];
+			FVector const dFu = V1 * Gu[1] + V2 * Gu[2];
+			FVector const dFv = V1 * Gv[1] + V2 * Gv[2];
+			Suu += Du * (Ru | dFu);
+			Svv += Dv * (Rv | dFv);
+			Suv += Ds * ((Ru | dFv) + (Rv | dFu));
+		}
+		// f_i = -R * S * g_i
+		FVector const Pu = Ru * Suu + Rv * Suv;
+		FVector const Pv = Ru * Suv + Rv * Svv;
+		for (int32 i = 0; i < 3; i ++)
+		{
+			Forces[Idx[i]] -= Pu * Gu[i] + Pv * Gv[i];
+		}
+
+		if (!bDerivatives) continue;
+		// d2E/dXmdXn = Huu Ru Ru^T + Hvv Rv Rv^T + Huv Ru Rv^T + Hvu Rv Ru^T
+		for (int32 m = 0; m < 3; m ++)
+		{
+			for (int32 n = 0; n < 3; n ++)
+			{
+				float const UU = Gu[m] * Gu[n], VV = Gv[m] * Gv[n], VU = Gv[m] * Gu[n], UV = Gu[m] * Gv[n];
+				float const KHuu = Ku * UU + Ks * VV, KHvv = Kv * VV + Ks * UU;
+				float const DHuu = Du * UU + Ds * VV, DHvv = Dv * VV + Ds * UU;
+				for (int32 i = 0; i < 3; i ++)
+				{
+					for (int32 j = 0; j < 3; j ++)
+					{
+						float const RuRu = Ru[i] * Ru[j], RvRv = Rv[i] * Rv[j];
+						float const Cross = VU * Ru[i] * Rv[j] + UV * Rv[i] * Ru[j];
+						uint32 const Row = 3 * Idx[m] + i, Col = 3 * Idx[n] + j;
+						(*dfdx)[Row][Col] -= KHuu * RuRu + KHvv * RvRv + Ks * Cross;
+						if (bDamping)
+						{
+							(*dddv)[Row][Col] -= DHuu * RuRu + DHvv * RvRv + Ds * Cross;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void FRTCorotationalKernel::ComputeForces(TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector> &Forces) const
+{
+	// triangles of one color share no vertex, chunks of a color scatter without races
+	FRTGraphColoring::ParallelForEachColor(ColorOffsets, ChunkSize, [&](int32, int32 Begin, int32 End)
+	{
+		Pass<false>(Begin, End, X.GetData(), V.GetData(), Forces.GetData(), nullptr, nullptr);
+	});
+}
+
+void FRTCorotationalKernel::ComputeForcesAndDerivatives(
+	TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector> &Forces,
+	FRTBBSSMatrix<float> &dfdx,
+	FRTBBSSMatrix<float> &dddv) const
+{
+	// matrices without a locked pattern insert new entries, which must not happen in parallel
+	bool const bSingleThread = !dfdx.IsPatternLocked() || !dddv.IsPatternLocked();
+	FRTGraphColoring::ParallelForEachColor(ColorOffsets, ChunkSize, [&](int32, int32 Begin, int32 End)
+	{
+		Pass<true>(Begin, End, X.GetData(), V.GetData(), Forces.GetData(), &dfdx, &dddv);
+	}, bSingleThread);
+}
+
+static float SumEnergy(TArray<float> const& Energy)
+{
+	double Sum = 0;
+	for (float const E : Energy)
+	{
+		Sum += E;
+	}
+	return float(Sum);
+}
+
+float FRTCorotationalKernel::LastStretchEnergy() const
+{
+	return SumEnergy(StretchEnergy);
+}
+
+float FRTCorotationalKernel::LastShearEnergy() const
+{
+	return SumEnergy(ShearEnergy);
+}
+
+float FRTCorotationalKernel::MaxRotationChange(TArray<FVector> const& X, TArray<FVector> const& Reference) const
+{
+	int32 const NumOfChunks = (Num() + ChunkSize - 1) / ChunkSize;
+	TArray<float> ChunkMax;
+	ChunkMax.SetNumZeroed(NumOfChunks);
+	ParallelFor(NumOfChunks, [&](int32 Chunk)
+	{
+		float Max = 0;
+		for (int32 T = Chunk * ChunkSize; T < std::min(Num(), (Chunk + 1) * ChunkSize); T ++)
+		{
+			FVector Ru, Rv, RefRu, RefRv;
+			if (Rotation(T, X.GetData(), Ru, Rv) && Rotation(T, Reference.GetData(), RefRu, RefRv))
+			{
+				Max = std::max(Max, std::max((Ru - RefRu).Size(), (Rv - RefRv).Size()));
+			}
+		}
+		ChunkMax[Chunk] = Max;
+	});
+	float Max = 0;
+	for (float const M : ChunkMax)
+	{
+		Max = std::max(Max, M);
+	}
+	return Max;
+}
+
+float FRTCorotationalKernel::CompareWithConditions(FClothRawMesh *Mesh, float &DerivativeError)
+{
+	// rest shape from the uv, rotated, moved and strained by 0.03% of the mean edge length.
+	// the conditions agree only to first order, their difference grows linearly with the strain
+	TArray<FVector> X, V;
+	X.SetNumUninitialized(Mesh->Positions.Num());
+	V.SetNumZeroed(X.Num());
+	FVector const Axis0 = FVector(0.6f, 0.f, 0.8f), Axis1 = FVector(0.f, 1.f, 0.f);
+	for (int32 i = 0; i < X.Num(); i ++)
+	{
+		FVector2D const UV = Mesh->TexCoords[i];
+		X[i] = Axis0 * (UV.X * RestU) + Axis1 * (UV.Y * RestV) + FVector(3.f, -2.f, 1.f);
+	}
+	float EdgeLength = 0;
+	for (int32 T = 0; T < Num(); T ++)
+	{
+		EdgeLength += (X[I1[T]] - X[I0[T]]).Size();
+	}
+	EdgeLength = Num() > 0 ? EdgeLength / Num() : 1.f;
+	for (int32 i = 0; i < X.Num(); i ++)
+	{
+		X[i] += 3e-4f * EdgeLength * FVector(FMath::Sin(0.37f * i), FMath::Cos(0.53f * i), FMath::Sin(0.71f * i));
+		V[i] = FVector(FMath::Cos(0.11f * i), FMath::Sin(0.23f * i), 0.5f);
+	}
+	TArray<float> Dir;
+	Dir.SetNumUninitialized(3 * X.Num());
+	for (int32 i = 0; i < Dir.Num(); i ++)
+	{
+		Dir[i] = FMath::Sin(0.17f * i);
+	}
+	float const h = 1e-4f * EdgeLength;
+
+	FRTMembraneParams const Saved = Params;
+	FRTMembraneParams const Material = {100, 6, 1, 1};
+	float Error = 0;
+	DerivativeError = 0;
+	{
+		// elastic forces, compared with the conditions
+		SetParams({Material.K_Stretch, 0, Material.K_Shear, 0});
+		TArray<FVector> Expected, Actual;
+		Expected.SetNumZeroed(X.Num());
+		Actual.SetNumZeroed(X.Num());
+		for (int32 T = 0; T < Num(); T ++)
+		{
+			FRTStretchCondition Stretch(Mesh, I0[T], I1[T], I2[T], RestU, RestV);
+			Stretch.UpdateCondition(X, V, Mesh->TexCoords);
+			Stretch.ComputeForces(KScale[T] * Material.K_Stretch, 0, Expected, Expected);
+			FRTShearCondition Shear(Mesh, I0[T], I1[T], I2[T]);
+			Shear.UpdateCondition(X, V, Mesh->TexCoords);
+			Shear.ComputeForces(KScale[T] * Material.K_Shear, 0, Expected, Expected);
+		}
+		ComputeForces(X, V, Actual);
+		float MaxForce = 0, MaxDiff = 0;
+		for (int32 i = 0; i < X.Num(); i ++)
+		{
+			MaxForce = std::max(MaxForce, Expected[i].GetAbsMax());
+			MaxDiff = std::max(MaxDiff, (Expected[i] - Actual[i]).GetAbsMax());
+		}
+		Error = std::max(Error, MaxForce > 0 ? MaxDiff / MaxForce : MaxDiff);
+	}
+
+	// dfdx with damping off and dddv with stiffness off, compared with central differences along Dir
+	for (int32 Pass = 0; Pass < 2; Pass ++)
+	{
+		bool const bVelocity = Pass == 1;
+		SetParams(bVelocity ? FRTMembraneParams{0, Material.D_Stretch, 0, Material.D_Shear}
+			: FRTMembraneParams{Material.K_Stretch, 0, Material.K_Shear, 0});
+		FRTBBSSMatrix<float> dfdx, dddv;
+		dfdx.UpdateSize(3 * X.Num());
+		dddv.UpdateSize(3 * X.Num());
+		TArray<FVector> Unused;
+		Unused.SetNumZeroed(X.Num());
+		ComputeForcesAndDerivatives(X, V, Unused, dfdx, dddv);
+		FRTBBSSMatrix<float> &Mat = bVelocity ? dddv : dfdx;
+		Mat.LockPattern();
+		TArray<float> HDir;
+		HDir.SetNumZeroed(Dir.Num());
+		Mat.MulVector(HDir.GetData(), Dir.GetData(), Dir.Num());
+
+		TArray<FVector> Plus = bVelocity ? V : X, Minus = Plus, FPlus, FMinus;
+		FPlus.SetNumZeroed(X.Num());
+		FMinus.SetNumZeroed(X.Num());
+		for (int32 i = 0; i < X.Num(); i ++)
+		{
+			FVector const D(Dir[3 * i], Dir[3 * i + 1], Dir[3 * i + 2]);
+			Plus[i] += h * D;
+			Minus[i] -= h * D;
+		}
+		ComputeForces(bVelocity ? X : Plus, bVelocity ? Plus : V, FPlus);
+		ComputeForces(bVelocity ? X : Minus, bVelocity ? Minus : V, FMinus);
+
+		float MaxHDir = 0, MaxHDirDiff = 0;
+		for (int32 i = 0; i < X.Num(); i ++)
+		{
+			for (int32 c = 0; c < 3; c ++)
+			{
+				float const Diff = (FPlus[i][c] - FMinus[i][c]) / (2 * h);
+				MaxHDir = std::max(MaxHDir, FMath::Abs(HDir[3 * i + c]));
+				MaxHDirDiff = std::max(MaxHDirDiff, FMath::Abs(Diff - HDir[3 * i + c]));
+			}
+		}
+		DerivativeError = std::max(DerivativeError, MaxHDir > 0 ? MaxHDirDiff / MaxHDir : MaxHDirDiff);
+	}
+	SetParams(Saved);
+	return Error;
+}
@@ -0,0 +1,180 @@
+﻿#include "FRTEnvelopeCholesky.h"
+
+#include <algorithm>
+
+// breadth first levels from Start, returns the last vertex reached and fills Level
+static int32 BreadthFirst(TArray<TArray<int32>> const& Adjacency, int32 Start, TArray<int32> &Level, TArray<int32> &Queue)
+{
+	for (int32 const i : Queue)
+	{
+		Level[i] = -1;
+	}
+	Queue.Reset();
+	Queue.Add(Start);
+	Level[Start] = 0;
+	for (int32 Head = 0; Head < Queue.Num(); Head ++)
+	{
+		int32 const i = Queue[Head];
+		for (int32 const j : Adjacency[i])
+		{
+			if (Level[j] < 0)
+			{
+				Level[j] = Level[i] + 1;
+				Queue.Add(j);
+			}
+		}
+	}
+	return Queue.Last();
+}
+
+void FRTEnvelopeCholesky::Analyze(TArray<TArray<int32>> const& Adjacency)
+{
+	int32 const N = Adjacency.Num();
+	// reverse Cuthill-McKee, each connected part starts from a pseudo peripheral vertex
+	TArray<int32> Order, Level, Queue;
+	Order.Reserve(N);
+	Level.Init(-1, N);
+	TArray<uint8> Visited;
+	Visited.Init(0, N);
+	for (int32 Seed = 0; Seed < N; Seed ++)
+	{
+		if (Visited[Seed]) continue;
+		int32 Start = BreadthFirst(Adjacency, Seed, Level, Queue);
+		Start = BreadthFirst(Adjacency, Start, Level, Queue);
+		int32 const Begin = Order.Num();
+		Order.Add(Start);
+		Visited[Start] = 1;
+		TArray<int32> Next;
+		for (int32 Head = Begin; Head < Order.Num(); Head ++)
+		{
+			Next.Reset();
+			for (int32 const j : Adjacency[Order[Head]])
+			{
+				if (!Visited[j])
+				{
+					Visited[j] = 1;
+					Next.Add(j);
+				}
+			}
+			std::sort(Next.GetData(), Next.GetData() + Next.Num(), [&](int32 A, int32 B)
+			{
+				return Adjacency[A].Num() < Adjacency[B].Num();
+			});
+			Order.Append(Next);
+		}
+	}
+	Permutation.SetNumUninitialized(N);
+	Inverse.SetNumUninitialized(N);
+	for (int32 Row = 0; Row < N; Row ++)
+	{
+		Inverse[Row] = Order[N - 1 - Row];
+		Permutation[Inverse[Row]] = Row;
+	}
+
+	// envelope: first column of each row
+	First.SetNumUninitialized(N);
+	RowOffsets.SetNumUninitialized(N + 1);
+	RowOffsets[0] = 0;
+	for (int32 Row = 0; Row < N; Row ++)
+	{
+		First[Row] = Row;
+		for (int32 const j : Adjacency[Inverse[Row]])
+		{
+			First[Row] = std::min(First[Row], Permutation[j]);
+		}
+		RowOffsets[Row + 1] = RowOffsets[Row] + Row - First[Row] + 1;
+	}
+	Values.Reset();
+	Values.SetNumZeroed(RowOffsets[N]);
+	Stored.Reset();
+	Work.SetNumUninitialized(3 * N);
+}
+
+void FRTEnvelopeCholesky::Add(int32 I, int32 J, double Value)
+{
+	int32 const Row = std::max(Permutation[I], Permutation[J]);
+	int32 const Col = std::min(Permutation[I], Permutation[J]);
+	check(Col >= First[Row]);
+	At(Row, Col) += Value;
+}
+
+bool FRTEnvelopeCholesky::Factorize()
+{
+	int32 const N = Size();
+	for (int32 Row = 0; Row < N; Row ++)
+	{
+		for (int32 Col = First[Row]; Col <= Row; Col ++)
+		{
+			double Sum = At(Row, Col);
+			// entries of both rows left of Col
+			double const *L_Row = Values.GetData() + RowOffsets[Row];
+			double const *L_Col = Values.GetData() + RowOffsets[Col];
+			for (int32 k = std::max(First[Row], First[Col]); k < Col; k ++)
+			{
+				Sum -= L_Row[k - First[Row]] * L_Col[k - First[Col]];
+			}
+			if (Col < Row)
+			{
+				At(Row, Col) = Sum / At(Col, Col);
+			}
+			else
+			{
+				if (!(Sum > 0)) return false;
+				At(Row, Row) = std::sqrt(Sum);
+			}
+		}
+	}
+	return true;
+}
+
+void FRTEnvelopeCholesky::Solve(TArray<FVector> &B) const
+{
+	int32 const N = Size();
+	check(B.Num() == N);
+	for (int32 Row = 0; Row < N; Row ++)
+	{
+		FVector const& b = B[Inverse[Row]];
+		Work[3 * Row] = b.X;
+		Work[3 * Row + 1] = b.Y;
+		Work[3 * Row + 2] = b.Z;
+	}
+	// L y = b
+	for (int32 Row = 0; Row < N; Row ++)
+	{
+		double y[3] = {Work[3 * Row], Work[3 * Row + 1], Work[3 * Row + 2]};
+		for (int32 k = First[Row]; k < Row; k ++)
+		{
+			double const L = At(Row, k);
+			y[0] -= L * Work[3 * k];
+			y[1] -= L * Work[3 * k + 1];
+			y[2] -= L * Work[3 * k + 2];
+		}
+		double const InvDiag = 1.0 / At(Row, Row);
+		for (int32 c = 0; c < 3; c ++)
+		{
+			Work[3 * Row + c] = y[c] * InvDiag;
+		}
+	}
+	// L^T x = y, by columns of L^T (rows of L)
+	for (int32 Row = N - 1; Row >= 0; Row --)
+	{
+		double const InvDiag = 1.0 / At(Row, Row);
+		double x[3];
+		for (int32 c = 0; c < 3; c ++)
+		{
+			x[c] = Work[3 * Row + c] * InvDiag;
+			Work[3 * Row + c] = x[c];
+		}
+		for (int32 k = First[Row]; k < Row; k ++)
+		{
+			double const L = At(Row, k);
+			Work[3 * k] -= L * x[0];
+			Work[3 * k + 1] -= L * x[1];
+			Work[3 * k + 2] -= L * x[2];
+		}
+	}
+	for (int32 Row = 0; Row < N; Row ++)
+	{
+		B[Inverse[Row]] = FVector(Work[3 * Row], Work[3 * Row + 1], Work[3 * Row + 2]);
+	}
+}
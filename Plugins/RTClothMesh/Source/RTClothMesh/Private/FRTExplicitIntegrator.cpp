@@ -0,0 +1,185 @@
+﻿#include "FRTExplicitIntegrator.h"
+
+#include "Math/FRTSimd.h"
+
+using namespace RTCloth::Simd;
+
+void FRTExplicitIntegrator::Init(TArray<float> const& InverseMasses)
+{
+	InvMass3.SetNumUninitialized(3 * InverseMasses.Num());
+	for (int32 i = 0; i < InverseMasses.Num(); i ++)
+	{
+		InvMass3[3 * i] = InvMass3[3 * i + 1] = InvMass3[3 * i + 2] = InverseMasses[i];
+	}
+}
+
+#if RTCLOTH_WITH_AVX2
+// Bias of 24 floats, 8 xyz triples spread over 3 registers
+struct FBias24
+{
+	FFloat8 B[3];
+};
+
+RTCLOTH_AVX2_FUNC static FORCEINLINE FBias24 LoadBias(FVector const& Bias)
+{
+	alignas(32) float Pattern[24];
+	for (int32 i = 0; i < 24; i ++)
+	{
+		Pattern[i] = Bias[i % 3];
+	}
+	return {{Load(Pattern), Load(Pattern + 8), Load(Pattern + 16)}};
+}
+
+// returns the first vertex that is not processed
+RTCLOTH_AVX2_FUNC static int32 VerletAVX2(
+	int32 NumOfVertices, float const *X, float *Pre, float *V, float const *F, float const *InvMass,
+	FVector const& Bias, float Drag, float h, float PrevH)
+{
+	FBias24 const B = LoadBias(Bias);
+	FFloat8 const D = Set1(Drag), H2 = Set1(0.5f * h * (h + PrevH)), Ratio = Set1(h / PrevH), InvSumH = Set1(1.f / (h + PrevH));
+	int32 i = 0;
+	for (; i + Width <= NumOfVertices; i += Width)
+	{
+		for (int32 r = 0; r < 3; r ++)
+		{
+			int32 const o = 3 * i + Width * r;
+			FFloat8 const x = Load(X + o);
+			FFloat8 const Acc = MulAdd(Load(F + o), Load(InvMass + o), Sub(B.B[r], Mul(D, Load(V + o))));
+			FFloat8 const New = MulAdd(Acc, H2, MulAdd(Sub(x, Load(Pre + o)), Ratio, x));
+			Store(V + o, Mul(Sub(New, x), InvSumH));
+			Store(Pre + o, New);
+		}
+	}
+	return i;
+}
+
+// returns the first float that is not processed
+RTCLOTH_AVX2_FUNC static int32 DriftAVX2(int32 NumOfFloats, float *X, float *V, float *VHalf, float const *A, float h)
+{
+	FFloat8 const H = Set1(h), HalfH = Set1(0.5f * h);
+	int32 k = 0;
+	for (; k + Width <= NumOfFloats; k += Width)
+	{
+		FFloat8 const a = Load(A + k), v = Load(V + k);
+		FFloat8 const vh = MulAdd(a, HalfH, v);
+		Store(VHalf + k, vh);
+		Store(X + k, MulAdd(vh, H, Load(X + k)));
+		Store(V + k, MulAdd(a, H, v));
+	}
+	return k;
+}
+
+// returns the first vertex that is not processed
+RTCLOTH_AVX2_FUNC static int32 KickAVX2(
+	int32 NumOfVertices, float *A, float *V, float const *VHalf, float const *F, float const *InvMass,
+	FVector const& Bias, float Drag, float h)
+{
+	FBias24 const B = LoadBias(Bias);
+	FFloat8 const D = Set1(Drag), HalfH = Set1(0.5f * h);
+	int32 i = 0;
+	for (; i + Width <= NumOfVertices; i += Width)
+	{
+		for (int32 r = 0; r < 3; r ++)
+		{
+			int32 const o = 3 * i + Width * r;
+			FFloat8 const Acc = MulAdd(Load(F + o), Load(InvMass + o), Sub(B.B[r], Mul(D, Load(V + o))));
+			Store(A + o, Acc);
+			Store(V + o, MulAdd(Acc, HalfH, Load(VHalf + o)));
+		}
+	}
+	return i;
+}
+#endif
+
+void FRTExplicitIntegrator::Verlet(
+	TArray<FVector> const& X, TArray<FVector> &Pre, TArray<FVector> &V, TArray<FVector> const& F, float h, float PrevH,
+	TArray<int32> const& ConstrainedVertices, TArray<FRTMatrix3> const& ConstraintMats)
+{
+	int32 const NumOfVertices = X.Num();
+	check(InvMass3.Num() == 3 * NumOfVertices);
+	float const H2 = 0.5f * h * (h + PrevH);
+	float const Ratio = h / PrevH;
+	float const InvSumH = 1.f / (h + PrevH);
+	// constrained vertices are stepped first and written over the results of the pass
+	ConstrainedPositions.SetNumUninitialized(ConstrainedVertices.Num());
+	ConstrainedVelocities.SetNumUninitialized(ConstrainedVertices.Num());
+	for (int32 c = 0; c < ConstrainedVertices.Num(); c ++)
+	{
+		int32 const Id = ConstrainedVertices[c];
+		FVector const Acc = ConstraintMats[c] * Acceleration(Id, F[Id], V[Id]);
+		ConstrainedPositions[c] = X[Id] + Ratio * (X[Id] - Pre[Id]) + Acc * H2;
+		ConstrainedVelocities[c] = (ConstrainedPositions[c] - X[Id]) * InvSumH;
+	}
+
+	int32 i = 0;
+#if RTCLOTH_WITH_AVX2
+	if (HasAVX2())
+	{
+		i = VerletAVX2(NumOfVertices, (float const *)X.GetData(), (float *)Pre.GetData(), (float *)V.GetData(),
+			(float const *)F.GetData(), InvMass3.GetData(), Bias, Drag, h, PrevH);
+	}
+#endif
+	for (; i < NumOfVertices; i ++)
+	{
+		FVector const Acc = Acceleration(i, F[i], V[i]);
+		FVector const New = X[i] + Ratio * (X[i] - Pre[i]) + Acc * H2;
+		V[i] = (New - X[i]) * InvSumH;
+		Pre[i] = New;
+	}
+
+	for (int32 c = 0; c < ConstrainedVertices.Num(); c ++)
+	{
+		int32 const Id = ConstrainedVertices[c];
+		Pre[Id] = ConstrainedPositions[c];
+		V[Id] = ConstrainedVelocities[c];
+	}
+}
+
+void FRTExplicitIntegrator::LeapfrogDrift(TArray<FVector> &X, TArray<FVector> &V, TArray<FVector> &VHalf, TArray<FVector> const& A, float h)
+{
+	int32 const NumOfFloats = 3 * X.Num();
+	float *PX = (float *)X.GetData(), *PV = (float *)V.GetData(), *PVHalf = (float *)VHalf.GetData();
+	float const *PA = (float const *)A.GetData();
+	int32 k = 0;
+#if RTCLOTH_WITH_AVX2
+	if (HasAVX2())
+	{
+		k = DriftAVX2(NumOfFloats, PX, PV, PVHalf, PA, h);
+	}
+#endif
+	for (; k < NumOfFloats; k ++)
+	{
+		PVHalf[k] = PV[k] + 0.5f * h * PA[k];
+		PX[k] += h * PVHalf[k];
+		PV[k] += h * PA[k];
+	}
+}
+
+void FRTExplicitIntegrator::LeapfrogKick(
+	TArray<FVector> &A, TArray<FVector> &V, TArray<FVector> const& VHalf, TArray<FVector> const& F, float h,
+	TArray<int32> const& ConstrainedVertices, TArray<FRTMatrix3> const& ConstraintMats)
+{
+	int32 const NumOfVertices = V.Num();
+	check(InvMass3.Num() == 3 * NumOfVertices);
+	int32 i = 0;
+#if RTCLOTH_WITH_AVX2
+	if (HasAVX2())
+	{
+		i = KickAVX2(NumOfVertices, (float *)A.GetData(), (float *)V.GetData(), (float const *)VHalf.GetData(),
+			(float const *)F.GetData(), InvMass3.GetData(), Bias, Drag, h);
+	}
+#endif
+	for (; i < NumOfVertices; i ++)
+	{
+		A[i] = Acceleration(i, F[i], V[i]);
+		V[i] = VHalf[i] + (0.5f * h) * A[i];
+	}
+
+	// A is stored unconstrained, project it and redo the velocity
+	for (int32 c = 0; c < ConstrainedVertices.Num(); c ++)
+	{
+		int32 const Id = ConstrainedVertices[c];
+		A[Id] = ConstraintMats[c] * A[Id];
+		V[Id] = VHalf[Id] + (0.5f * h) * A[Id];
+	}
+}
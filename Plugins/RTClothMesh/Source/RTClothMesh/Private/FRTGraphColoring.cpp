@@ -0,0 +1,48 @@
+﻿#include "FRTGraphColoring.h"
+
+void FRTGraphColoring::Build(TArray<uint32> const& ElementVertices, int32 VerticesPerElement, int32 NumOfVertices)
+{
+	int32 const NumOfElements = ElementVertices.Num() / VerticesPerElement;
+	Order.Reset(NumOfElements);
+	Offsets.Reset();
+	Offsets.Add(0);
+
+	TArray<int32> Remaining, Next;
+	Remaining.Reserve(NumOfElements);
+	for (int32 i = 0; i < NumOfElements; i ++)
+	{
+		Remaining.Add(i);
+	}
+	// last color that touched each vertex
+	TArray<int32> VertexColor;
+	VertexColor.Init(-1, NumOfVertices);
+
+	// fill one color per pass, elements that touch a vertex of this color wait for the next pass
+	for (int32 Color = 0; Remaining.Num() > 0; Color ++)
+	{
+		Next.Reset();
+		for (int32 const E : Remaining)
+		{
+			uint32 const *V = &ElementVertices[E * VerticesPerElement];
+			bool bFree = true;
+			for (int32 k = 0; k < VerticesPerElement && bFree; k ++)
+			{
+				bFree = VertexColor[V[k]] != Color;
+			}
+			if (bFree)
+			{
+				for (int32 k = 0; k < VerticesPerElement; k ++)
+				{
+					VertexColor[V[k]] = Color;
+				}
+				Order.Add(E);
+			}
+			else
+			{
+				Next.Add(E);
+			}
+		}
+		Offsets.Add(Order.Num());
+		Swap(Remaining, Next);
+	}
+}
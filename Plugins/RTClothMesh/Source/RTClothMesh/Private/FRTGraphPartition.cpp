@@ -0,0 +1,105 @@
+﻿#include "FRTGraphPartition.h"
+
+void FRTGraphPartition::Build(TArray<uint32> const& ElementVertices, int32 VerticesPerElement, int32 NumOfVertices, int32 NumOfParts)
+{
+	int32 const NumOfElements = ElementVertices.Num() / VerticesPerElement;
+	AdjacencyOffsets.Init(0, NumOfVertices + 1);
+	for (int32 E = 0; E < NumOfElements; E ++)
+	{
+		for (int32 k = 0; k < VerticesPerElement; k ++)
+		{
+			AdjacencyOffsets[ElementVertices[E * VerticesPerElement + k] + 1] += VerticesPerElement - 1;
+		}
+	}
+	for (int32 i = 0; i < NumOfVertices; i ++)
+	{
+		AdjacencyOffsets[i + 1] += AdjacencyOffsets[i];
+	}
+	Adjacency.SetNumUninitialized(AdjacencyOffsets[NumOfVertices]);
+	TArray<int32> Next(AdjacencyOffsets.GetData(), NumOfVertices);
+	for (int32 E = 0; E < NumOfElements; E ++)
+	{
+		uint32 const *V = &ElementVertices[E * VerticesPerElement];
+		for (int32 k = 0; k < VerticesPerElement; k ++)
+		{
+			for (int32 l = 0; l < VerticesPerElement; l ++)
+			{
+				if (k != l) Adjacency[Next[V[k]] ++] = V[l];
+			}
+		}
+	}
+
+	Order.SetNumUninitialized(NumOfVertices);
+	for (int32 i = 0; i < NumOfVertices; i ++)
+	{
+		Order[i] = i;
+	}
+	VertexParts.SetNumUninitialized(NumOfVertices);
+	InRange.Init(-1, NumOfVertices);
+	Visited.Init(-1, NumOfVertices);
+	Tag = 0;
+	Split(0, NumOfVertices, 0, FMath::Max(NumOfParts, 1));
+}
+
+void FRTGraphPartition::Split(int32 Begin, int32 End, int32 FirstPart, int32 NumOfParts)
+{
+	if (NumOfParts == 1 || End - Begin <= 1)
+	{
+		for (int32 k = Begin; k < End; k ++)
+		{
+			VertexParts[Order[k]] = FirstPart;
+		}
+		return;
+	}
+	Tag ++;
+	for (int32 k = Begin; k < End; k ++)
+	{
+		InRange[Order[k]] = Tag;
+	}
+	// the far end of a search is close to the periphery, searching again from it gives level sets across the part
+	int32 const Far = Search(Begin, End, Order[Begin]);
+	Search(Begin, End, Far);
+	for (int32 k = Begin; k < End; k ++)
+	{
+		Order[k] = Queue[k - Begin];
+	}
+	int32 const Left = NumOfParts / 2;
+	int32 const Mid = Begin + int32(int64(End - Begin) * Left / NumOfParts);
+	Split(Begin, Mid, FirstPart, Left);
+	Split(Mid, End, FirstPart + Left, NumOfParts - Left);
+}
+
+int32 FRTGraphPartition::Search(int32 Begin, int32 End, int32 Start)
+{
+	int32 const VisitTag = Tag ++;
+	Queue.Reset(End - Begin);
+	Queue.Add(Start);
+	Visited[Start] = VisitTag;
+	int32 Last = Start;
+	int32 Head = 0;
+	int32 Restart = Begin;
+	bool bFirstComponent = true;
+	while (Queue.Num() < End - Begin)
+	{
+		if (Head == Queue.Num())
+		{
+			// next component
+			bFirstComponent = false;
+			while (Visited[Order[Restart]] == VisitTag) Restart ++;
+			Queue.Add(Order[Restart]);
+			Visited[Order[Restart]] = VisitTag;
+		}
+		int32 const V = Queue[Head ++];
+		for (int32 k = AdjacencyOffsets[V]; k < AdjacencyOffsets[V + 1]; k ++)
+		{
+			int32 const U = Adjacency[k];
+			if (InRange[U] == InRange[V] && Visited[U] != VisitTag)
+			{
+				Visited[U] = VisitTag;
+				Queue.Add(U);
+				if (bFirstComponent) Last = U;
+			}
+		}
+	}
+	return Last;
+}
@@ -0,0 +1,46 @@
+﻿#include "FRTPrivateForceBuffers.h"
+
+#include "Async/TaskGraphInterfaces.h"
+
+void FRTPrivateForceBuffers::Init(int32 NumOfElements, int32 NumOfVertices, int32 Alignment)
+{
+	int32 const NumOfWorkers = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	int32 const NumOfBlocks = (NumOfElements + Alignment - 1) / Alignment;
+	int32 const NumOfRanges = FMath::Clamp(NumOfWorkers, 1, FMath::Max(NumOfBlocks, 1));
+
+	RangeOffsets.Reset(NumOfRanges + 1);
+	for (int32 r = 0; r <= NumOfRanges; r ++)
+	{
+		RangeOffsets.Add(FMath::Min(NumOfBlocks * r / NumOfRanges * Alignment, NumOfElements));
+	}
+	Buffers.SetNum(NumOfRanges);
+	for (auto &Buffer : Buffers)
+	{
+		Buffer.SetNumZeroed(NumOfVertices);
+	}
+}
+
+void FRTPrivateForceBuffers::Reset()
+{
+	RangeOffsets.Empty();
+	Buffers.Empty();
+}
+
+void FRTPrivateForceBuffers::Reduce(TArray<FVector> &Forces) const
+{
+	int32 constexpr ChunkSize = 1024;
+	ParallelFor((Forces.Num() + ChunkSize - 1) / ChunkSize, [&](int32 Chunk)
+	{
+		int32 const End = FMath::Min(Forces.Num(), (Chunk + 1) * ChunkSize);
+		for (int32 i = Chunk * ChunkSize; i < End; i ++)
+		{
+			// fixed order
+			FVector Sum = Forces[i];
+			for (auto const &Buffer : Buffers)
+			{
+				Sum += Buffer[i];
+			}
+			Forces[i] = Sum;
+		}
+	});
+}
@@ -0,0 +1,207 @@
+﻿#include "FRTQuadraticBendKernel.h"
+
+#include "Async/ParallelFor.h"
+
+#include <algorithm>
+
+FRTQuadraticBendKernel::FRTQuadraticBendKernel()
+{
+	SetParams(0, 0);
+}
+
+void FRTQuadraticBendKernel::Reset(int32 NumOfVertices)
+{
+	Hinges.Reset();
+	NumOfRows = NumOfVertices;
+	RowOffsets.Reset();
+	Cols.Reset();
+	ValuesK.Reset();
+	ValuesD.Reset();
+	RowEnergy.Reset();
+}
+
+// cot of the angle between A and B
+static float Cot(FVector const& A, FVector const& B)
+{
+	return (A | B) / (A ^ B).Size();
+}
+
+bool FRTQuadraticBendKernel::HingeWeights(uint32 V0, uint32 V1, uint32 V2, uint32 V3,
+	TArray<FVector> const& RestX, TArray<FVector2D> const& UV, float W[4], float &S)
+{
+	// edges from the ends of the hinge edge X1 - X2
+	FVector const E0 = RestX[V2] - RestX[V1];
+	FVector const E1 = RestX[V0] - RestX[V1], E2 = RestX[V3] - RestX[V1];
+	FVector const E3 = RestX[V0] - RestX[V2], E4 = RestX[V3] - RestX[V2];
+	float const A0 = 0.5f * (E0 ^ E1).Size(), A1 = 0.5f * (E0 ^ E2).Size();
+	if (A0 < SMALL_NUMBER || A1 < SMALL_NUMBER) return false;
+	float const C01 = Cot(E0, E1), C02 = Cot(E0, E2);
+	float const C03 = Cot(-E0, E3), C04 = Cot(-E0, E4);
+	W[0] = C03 + C04;
+	W[1] = C01 + C02;
+	W[2] = -C01 - C03;
+	W[3] = -C02 - C04;
+	// Bergou's Q += 3 / (A0 + A1) * W W^T has the energy 3 |E0|^2 / (A0 + A1) * theta^2 / 2 for small theta,
+	// scale it to L / 2 * theta^2 of the dihedral bend so that K_Bend means the same in both models
+	S = (UV[V1] - UV[V2]).Size() / E0.SizeSquared();
+	return true;
+}
+
+void FRTQuadraticBendKernel::Add(uint32 V0, uint32 V1, uint32 V2, uint32 V3, TArray<FVector> const& RestX, TArray<FVector2D> const& UV)
+{
+	FHinge Hinge = {{int32(V1), int32(V2), int32(V0), int32(V3)}, {0, 0, 0, 0}, 0};
+	if (HingeWeights(V0, V1, V2, V3, RestX, UV, Hinge.W, Hinge.S))
+	{
+		Hinges.Add(Hinge);
+	}
+}
+
+void FRTQuadraticBendKernel::Finalize()
+{
+	// pattern: every pair of vertices of a hinge
+	TArray<TSet<int32>> Rows;
+	Rows.SetNum(NumOfRows);
+	for (auto const& Hinge : Hinges)
+	{
+		for (int32 const m : Hinge.Idx)
+		{
+			for (int32 const n : Hinge.Idx)
+			{
+				Rows[m].Add(n);
+			}
+		}
+	}
+	RowOffsets.Reset(NumOfRows + 1);
+	RowOffsets.Add(0);
+	for (auto &Row : Rows)
+	{
+		Row.Sort(TLess<int32>());
+		for (int32 const Col : Row)
+		{
+			Cols.Add(Col);
+		}
+		RowOffsets.Add(Cols.Num());
+	}
+	RowEnergy.SetNumZeroed(NumOfRows);
+	SetScaleMaps({}, {});
+}
+
+void FRTQuadraticBendKernel::SetScaleMaps(TArray<float> const& VertexK, TArray<float> const& VertexD)
+{
+	ValuesK.Init(0.f, Cols.Num());
+	ValuesD.Init(0.f, Cols.Num());
+	for (auto const& Hinge : Hinges)
+	{
+		// the shared edge is Idx[0] - Idx[1]
+		float const SK = Hinge.S * (VertexK.Num() > 0 ? 0.5f * (VertexK[Hinge.Idx[0]] + VertexK[Hinge.Idx[1]]) : 1.f);
+		float const SD = Hinge.S * (VertexD.Num() > 0 ? 0.5f * (VertexD[Hinge.Idx[0]] + VertexD[Hinge.Idx[1]]) : 1.f);
+		for (int32 m = 0; m < 4; m ++)
+		{
+			int32 const Row = Hinge.Idx[m];
+			for (int32 n = 0; n < 4; n ++)
+			{
+				int32 const E = std::lower_bound(Cols.GetData() + RowOffsets[Row], Cols.GetData() + RowOffsets[Row + 1], Hinge.Idx[n]) - Cols.GetData();
+				ValuesK[E] += SK * Hinge.W[m] * Hinge.W[n];
+				ValuesD[E] += SD * Hinge.W[m] * Hinge.W[n];
+			}
+		}
+	}
+	// rows of Q sum to zero, set the diagonal from the others so that translations are exactly free
+	for (int32 i = 0; i < NumOfRows; i ++)
+	{
+		for (auto *Values : {&ValuesK, &ValuesD})
+		{
+			float Sum = 0;
+			int32 Diag = INDEX_NONE;
+			for (int32 e = RowOffsets[i]; e < RowOffsets[i + 1]; e ++)
+			{
+				if (Cols[e] == i)
+				{
+					Diag = e;
+				}
+				else
+				{
+					Sum += (*Values)[e];
+				}
+			}
+			if (Diag != INDEX_NONE)
+			{
+				(*Values)[Diag] = -Sum;
+			}
+		}
+	}
+}
+
+void FRTQuadraticBendKernel::SetParams(float InK, float InD)
+{
+	K = InK;
+	D = InD;
+	ForcePass = D != 0 ? &FRTQuadraticBendKernel::Pass<true> : &FRTQuadraticBendKernel::Pass<false>;
+}
+
+template <bool bDamping>
+void FRTQuadraticBendKernel::Pass(int32 Begin, int32 End, FVector const* X, FVector const* V, FVector *Forces) const
+{
+	// with zero row sums, (Q x)_i = sum_j Q_ij (x_j - x_i) and x^T Q x = -1 / 2 * sum_ij Q_ij |x_j - x_i|^2,
+	// differences keep the precision when the cloth is far from the origin
+	for (int32 i = Begin; i < End; i ++)
+	{
+		FVector QX = FVector::ZeroVector, QV = FVector::ZeroVector;
+		float QXX = 0;
+		for (int32 e = RowOffsets[i]; e < RowOffsets[i + 1]; e ++)
+		{
+			FVector const DX = X[Cols[e]] - X[i];
+			QX += ValuesK[e] * DX;
+			QXX += ValuesK[e] * DX.SizeSquared();
+			if (bDamping)
+			{
+				QV += ValuesD[e] * (V[Cols[e]] - V[i]);
+			}
+		}
+		Forces[i] -= K * QX;
+		if (bDamping)
+		{
+			Forces[i] -= D * QV;
+		}
+		RowEnergy[i] = -0.25f * K * QXX;
+	}
+}
+
+void FRTQuadraticBendKernel::ComputeForces(TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector> &Forces) const
+{
+	int32 const NumOfRows = RowOffsets.Num() - 1;
+	int32 const NumOfChunks = (NumOfRows + ChunkSize - 1) / ChunkSize;
+	ParallelFor(NumOfChunks, [&](int32 Chunk)
+	{
+		(this->*ForcePass)(Chunk * ChunkSize, std::min(NumOfRows, (Chunk + 1) * ChunkSize),
+			X.GetData(), V.GetData(), Forces.GetData());
+	});
+}
+
+void FRTQuadraticBendKernel::AddDerivatives(FRTBBSSMatrix<float> &dfdx, FRTBBSSMatrix<float> &dddv) const
+{
+	for (int32 i = 0; i < RowOffsets.Num() - 1; i ++)
+	{
+		for (int32 e = RowOffsets[i]; e < RowOffsets[i + 1]; e ++)
+		{
+			for (int32 c = 0; c < 3; c ++)
+			{
+				dfdx[3 * i + c][3 * Cols[e] + c] += -K * ValuesK[e];
+				if (D != 0)
+				{
+					dddv[3 * i + c][3 * Cols[e] + c] += -D * ValuesD[e];
+				}
+			}
+		}
+	}
+}
+
+float FRTQuadraticBendKernel::LastEnergy() const
+{
+	double Sum = 0;
+	for (float const E : RowEnergy)
+	{
+		Sum += E;
+	}
+	return float(Sum);
+}
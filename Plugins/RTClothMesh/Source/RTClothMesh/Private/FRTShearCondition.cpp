@@ -8,15 +8,12 @@ void FRTShearCondition::ComputeForces(
 	// Calculate Forces
 	// E = 0.5 * C * C
 	// f = -dE/dx = - C dC/dx
-	for (uint32 i = 0; i < 3; i ++)
-	{
-		Forces[V_Inx[i]] -= (K * C) * dCdX[i];
-	}
-
 	// fd = -d * dC/dt * dC/dx:
 	for (uint32 i = 0; i < 3; i ++)
 	{
-		DampingF[V_Inx[i]] -= (D * dCdt) * dCdX[i];
+		FVector const dCdXi = dCdX(i);
+		Forces[V_Inx[i]] -= (K * C) * dCdXi;
+		DampingF[V_Inx[i]] -= (D * dCdt) * dCdXi;
 	}
 }
 
@@ -27,68 +24,21 @@ void FRTShearCondition::ComputeDerivatives(
 		FRTBBSSMatrix<float> &dddv
 	)
 {
-	// d2CdX
-	FRTMatrix3 d2CdXX[3][3];
-	for (uint32 i = 0; i < 3; i ++)
-	{
-		for (uint32 j = 0; j < 3; j ++)
-		{
-			d2CdXX[i][j] = FRTMatrix3::Diag(a * (dwudXScalar[i] * dwvdXScalar[j] + dwvdXScalar[i] * dwudXScalar[j]));
-		}
-	}
-	// compute dfdx
-	FRTMatrix3 dC2dX[3][3], dFdX[3][3];
-	for (uint32 i = 0; i < 3; i ++)
-	{
-		for (uint32 j = 0; j < 3; j ++)
-		{
-			dC2dX[i][j] = FRTMatrix3::CrossVec(dCdX[i], dCdX[j]);
-			dFdX[i][j] = - K *(dC2dX[i][j] + C * d2CdXX[i][j]);
-		}
-	}
-	
-	// fill in dfdx
-	for (uint32 i = 0; i < 3; ++i)
+	FVector const Grad[3] = {dCdX(0), dCdX(1), dCdX(2)};
+	for (uint32 m = 0; m < 3; m ++)
 	{
-		for (uint32 j = 0; j < 3; ++j)
+		for (uint32 n = 0; n < 3; n ++)
 		{
-			for (uint32 m = 0; m < 3; m ++)
-			{
-				for (uint32 n = 0; n < 3; n ++)
-				{
-					dfdx[3 * V_Inx[m] + i][3 * V_Inx[n] + j] += dFdX[m][n][i][j];
-				}
-			}
-		}
-	}
-
-	// dddv_ij = - d * dCdx_i * dCdx_j
-	for (uint32 i = 0; i < 3; ++i)
-	{
-		for (uint32 j = 0; j < 3; ++j)
-		{
-			for (uint32 m = 0; m < 3; m ++)
-			{
-				for (uint32 n = 0; n < 3; n ++)
-				{
-					dddv[3 * V_Inx[m] + i][3 * V_Inx[n] + j] -= D * dC2dX[m][n][i][j];
-				}
-			}
-		}
-	}
-
-	// dddx = kd * d2c/dXi_dXj * dc/dt:
-	for (uint32 i = 0; i < 3; ++i)
-	{
-		for (uint32 j = 0; j < 3; ++j)
-		{
-			for (uint32 m = 0; m < 3; m ++)
-			{
-				for (uint32 n = 0; n < 3; n ++)
-				{
-					dddx[3 * V_Inx[m] + i][3 * V_Inx[n] + j] += - D * dCdt * d2CdXX[m][n][i][j];
-				}
-			}
+			// d2C/dXm dXn is a * (Cu_m Cv_n + Cv_m Cu_n) * I
+			float const d2CdXX = a * (dwudXScalar[m] * dwvdXScalar[n] + dwvdXScalar[m] * dwudXScalar[n]);
+			FRTMatrix3 const dC2dX = FRTMatrix3::CrossVec(Grad[m], Grad[n]);
+			// dfdx = -K * (dC/dX dC/dX^T + C * d2C/dXX)
+			AddBlock(dfdx, V_Inx[m], V_Inx[n], dC2dX * -K);
+			AddDiag(dfdx, V_Inx[m], V_Inx[n], -K * C * d2CdXX);
+			// dddv_ij = - d * dCdx_i * dCdx_j
+			AddBlock(dddv, V_Inx[m], V_Inx[n], dC2dX * -D);
+			// dddx = kd * d2c/dXi_dXj * dc/dt:
+			AddDiag(dddx, V_Inx[m], V_Inx[n], -D * dCdt * d2CdXX);
 		}
 	}
 }
@@ -105,13 +55,8 @@ void FRTShearCondition::Update(
 	const FVector &P0, const FVector &P1, const FVector &P2,
 	const FVector &V0, const FVector& V1, const FVector& V2)
 {
-	FClothTriangleProperties::Update(P0, P1, P2, V0, V1, V2);
+	UpdateTangents(P0, P1, P2);
 	C = a * (wu | wv);
 
-	for (uint32 i = 0; i < 3; i ++)
-	{
-		dCdX[i] = a * (dwudXScalar[i] * wv + dwvdXScalar[i] * wu);
-	}
-
-	dCdt = (dCdX[0]|V0) + (dCdX[1]|V1) + (dCdX[2]|V2);
+	dCdt = (dCdX(0)|V0) + (dCdX(1)|V1) + (dCdX(2)|V2);
 }
@@ -0,0 +1,31 @@
+﻿#include "FRTStepController.h"
+
+float FRTStepController::NextStep(FRTStepMeasures const& Measures, float Duration) const
+{
+	// largest step the measures allow
+	float Limit = Params.MaxStep;
+	if (Measures.StrainRate > 0)
+	{
+		Limit = FMath::Min(Limit, Params.MaxStrainChange / Measures.StrainRate);
+	}
+	if (Measures.MotionRate > 0)
+	{
+		Limit = FMath::Min(Limit, Params.MaxMotion / Measures.MotionRate);
+	}
+	if (Measures.Penetration > Params.MaxPenetration)
+	{
+		Limit = FMath::Min(Limit, 0.5f * Duration);
+	}
+	if (Params.bPowerOfTwo)
+	{
+		// doubling MinStep is exact, a step of this controller compares equal to the same power
+		float const Bound = FMath::Min(Limit, 2 * Duration);
+		float Step = Params.MinStep;
+		while (2 * Step <= Bound)
+		{
+			Step *= 2;
+		}
+		return Step;
+	}
+	return FMath::Clamp(FMath::Min(Duration * Params.Growth, Limit), Params.MinStep, Params.MaxStep);
+}
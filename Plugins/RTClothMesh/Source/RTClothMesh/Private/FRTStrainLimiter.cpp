@@ -0,0 +1,146 @@
+﻿#include "FRTStrainLimiter.h"
+
+#include "FRTGraphColoring.h"
+
+#include <atomic>
+
+void FRTStrainLimiter::Init(FClothRawMesh const& Mesh, float Rest_U, float Rest_V)
+{
+	int32 const NumOfTriangles = Mesh.Indices.Num() / 3;
+	for (auto *Arr : {&I0, &I1, &I2})
+	{
+		Arr->Reset(NumOfTriangles);
+	}
+	for (auto *Arr : {&R1U, &R1V, &R2U, &R2V, &InvA, &InvB, &InvC, &InvD})
+	{
+		Arr->Reset(NumOfTriangles);
+	}
+
+	// store triangles in color order, each color is a contiguous range
+	FRTGraphColoring Coloring;
+	Coloring.Build(Mesh.Indices, 3, Mesh.Positions.Num());
+	ColorOffsets = Coloring.Offsets;
+	for (int32 const i : Coloring.Order)
+	{
+		int32 const P0 = Mesh.Indices[3 * i];
+		int32 const P1 = Mesh.Indices[3 * i + 1];
+		int32 const P2 = Mesh.Indices[3 * i + 2];
+		FVector2D const UV0 = Mesh.TexCoords[P0];
+		FVector2D const R1 = (Mesh.TexCoords[P1] - UV0) * FVector2D(Rest_U, Rest_V);
+		FVector2D const R2 = (Mesh.TexCoords[P2] - UV0) * FVector2D(Rest_U, Rest_V);
+		float const Det = R1.X * R2.Y - R2.X * R1.Y;
+		float const InvDet = Det != 0 ? 1.f / Det : 0.f;
+		I0.Add(P0);
+		I1.Add(P1);
+		I2.Add(P2);
+		R1U.Add(R1.X);
+		R1V.Add(R1.Y);
+		R2U.Add(R2.X);
+		R2V.Add(R2.Y);
+		InvA.Add(R2.Y * InvDet);
+		InvB.Add(-R2.X * InvDet);
+		InvC.Add(-R1.Y * InvDet);
+		InvD.Add(R1.X * InvDet);
+	}
+}
+
+void FRTStrainLimiter::SetLimits(float InMinStretch, float InMaxStretch, int32 InIterations)
+{
+	MinStretch = InMinStretch;
+	MaxStretch = InMaxStretch;
+	Iterations = InIterations;
+}
+
+int32 FRTStrainLimiter::Apply(
+	TArray<FVector> &X, TArray<FVector> &V, float DeltaToVelocity,
+	TArray<float> const& InverseMasses, TArray<int32> const& ConstraintIndex) const
+{
+	if (!IsEnabled() || Num() == 0) return 0;
+	check(InverseMasses.Num() == X.Num() && ConstraintIndex.Num() == X.Num());
+
+	std::atomic<int32> NumOfClamped(0);
+	for (int32 Iter = 0; Iter < Iterations; Iter ++)
+	{
+		FRTGraphColoring::ParallelForEachColor(ColorOffsets, ChunkSize, [&](int32, int32 Begin, int32 End)
+		{
+			int32 Clamped = 0;
+			for (int32 T = Begin; T < End; T ++)
+			{
+				Clamped += Project(T, X.GetData(), V.GetData(), DeltaToVelocity, InverseMasses.GetData(), ConstraintIndex.GetData());
+			}
+			if (Iter == 0)
+			{
+				NumOfClamped += Clamped;
+			}
+		});
+	}
+	return NumOfClamped;
+}
+
+bool FRTStrainLimiter::Project(int32 T, FVector *X, FVector *V, float DeltaToVelocity, float const* InverseMasses, int32 const* ConstraintIndex) const
+{
+	int32 const Idx[3] = {I0[T], I1[T], I2[T]};
+	float W[3];
+	for (int32 i = 0; i < 3; i ++)
+	{
+		W[i] = ConstraintIndex[Idx[i]] == INDEX_NONE ? InverseMasses[Idx[i]] : 0.f;
+	}
+	if (W[0] + W[1] + W[2] == 0) return false;
+
+	// F = [E1 E2] * inverse of [R1 R2]
+	FVector const E1 = X[Idx[1]] - X[Idx[0]];
+	FVector const E2 = X[Idx[2]] - X[Idx[0]];
+	FVector Fu = E1 * InvA[T] + E2 * InvC[T];
+	FVector Fv = E1 * InvB[T] + E2 * InvD[T];
+
+	// principal stretches from the eigenvalues of F^T F = [a b; b c]
+	float const a = Fu | Fu;
+	float const b = Fu | Fv;
+	float const c = Fv | Fv;
+	float const Mean = 0.5f * (a + c);
+	float const Diff = FMath::Sqrt(0.25f * (a - c) * (a - c) + b * b);
+	float const S[2] = {FMath::Sqrt(Mean + Diff), FMath::Sqrt(FMath::Max(Mean - Diff, 0.f))};
+	if ((MaxStretch <= 0 || S[0] <= MaxStretch) && (MinStretch <= 0 || S[1] >= MinStretch)) return false;
+
+	// eigenvector of the larger eigenvalue, the other one is perpendicular
+	FVector2D Dir = a >= c ? FVector2D(Mean + Diff - c, b) : FVector2D(b, Mean + Diff - a);
+	float const DirSize = Dir.Size();
+	Dir = DirSize > SMALL_NUMBER ? Dir / DirSize : FVector2D(1, 0);
+	FVector2D const Dirs[2] = {Dir, FVector2D(-Dir.Y, Dir.X)};
+
+	// F += (clamped / S - 1) * (F * dir) * dir^T on both principal directions
+	FVector const FuOld = Fu, FvOld = Fv;
+	for (int32 k = 0; k < 2; k ++)
+	{
+		if (S[k] < SMALL_NUMBER) continue;
+		float Clamped = S[k];
+		if (MaxStretch > 0) Clamped = FMath::Min(Clamped, MaxStretch);
+		if (MinStretch > 0) Clamped = FMath::Max(Clamped, MinStretch);
+		if (Clamped == S[k]) continue;
+		FVector const FDir = (FuOld * Dirs[k].X + FvOld * Dirs[k].Y) * (Clamped / S[k] - 1.f);
+		Fu += FDir * Dirs[k].X;
+		Fv += FDir * Dirs[k].Y;
+	}
+
+	// center of the triangle by mass, pinned vertices hold the center when there are any
+	bool const bPinned = W[0] == 0 || W[1] == 0 || W[2] == 0;
+	float Q[3];
+	for (int32 i = 0; i < 3; i ++)
+	{
+		Q[i] = bPinned ? (W[i] == 0) : 1.f / W[i];
+	}
+	float const InvQ = 1.f / (Q[0] + Q[1] + Q[2]);
+	FVector const CenterX = (X[Idx[0]] * Q[0] + X[Idx[1]] * Q[1] + X[Idx[2]] * Q[2]) * InvQ;
+	FVector2D const R[3] = {FVector2D(0, 0), FVector2D(R1U[T], R1V[T]), FVector2D(R2U[T], R2V[T])};
+	FVector2D const CenterR = (R[1] * Q[1] + R[2] * Q[2]) * InvQ;
+
+	for (int32 i = 0; i < 3; i ++)
+	{
+		if (W[i] == 0) continue;
+		FVector2D const RelR = R[i] - CenterR;
+		FVector const Delta = CenterX + Fu * RelR.X + Fv * RelR.Y - X[Idx[i]];
+		X[Idx[i]] += Delta;
+		V[Idx[i]] += Delta * DeltaToVelocity;
+	}
+	return true;
+}
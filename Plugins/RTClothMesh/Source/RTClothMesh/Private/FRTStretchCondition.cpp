@@ -17,16 +17,18 @@ void FRTStretchCondition::ComputeForces(
 	// update Forces
 	// E = 0.5 * ( C0*C0 + C1*C1 )
 	// f = -dE/dx = - (C0 dC0/dx + C1 dC1/dx)
+	FVector const Fu = K * C0 * dC0dwu, Fv = K * C1 * dC1dwv;
 	for (uint32 i = 0; i < 3; i ++)
 	{
-		Forces[V_Inx[i]] -= K * (C0 * dC0dX[i] + C1 * dC1dX[i]);
+		Forces[V_Inx[i]] -= dwudXScalar[i] * Fu + dwvdXScalar[i] * Fv;
 	}
 
 	// Compute Damping Forces
 	// fd = -d * ( dC0/dt * dC0/dx + dC1/dt * dC1/dx ):
+	FVector const Du = D * dC0dt * dC0dwu, Dv = D * dC1dt * dC1dwv;
 	for (uint32 i = 0; i < 3; i ++)
 	{
-		DampingF[V_Inx[i]] -= D * (dC0dt * dC0dX[i] + dC1dt * dC1dX[i]);
+		DampingF[V_Inx[i]] -= dwudXScalar[i] * Du + dwvdXScalar[i] * Dv;
 	}
 }
 void FRTStretchCondition::ComputeDerivatives(
@@ -36,109 +38,59 @@ void FRTStretchCondition::ComputeDerivatives(
 	FRTBBSSMatrix<float> &dddv
 )
 {
-	const float a_wuNorm = a / wuNorm;
-	const float a_wvNorm = a / wvNorm;
-
-	// second derivatives of the energy conditions:
-	FRTMatrix3 d2C0dXX[3][3];
-	FRTMatrix3 d2C1dXX[3][3];
-	
-	// second derivatives of C:
-	const FRTMatrix3 wuMatrix = (a_wuNorm / (wuNorm * wuNorm)) * (FRTMatrix3::Identity() - FRTMatrix3::CrossVec(wu, wu) );
-	const FRTMatrix3 wvMatrix = (a_wvNorm / (wvNorm * wvNorm)) * (FRTMatrix3::Identity() - FRTMatrix3::CrossVec(wv, wv));
+	// every block (m, n) is a combination of the same matrices on wu and wv:
+	// d2C0/dXm dXn = Cu_m * Cu_n * d2C0/dwu2, dC0/dXm dC0/dXn^T = Cu_m * Cu_n * dC0/dwu dC0/dwu^T, same for C1 with Cv
+	// d2C0/dwu2 = a / |wu| * (I - wu wu^T / |wu|^2)
+	FRTMatrix3 Hu = FRTMatrix3::CrossVec(wu, wu) * (-a / (wuNorm * wuNorm * wuNorm));
+	FRTMatrix3 Hv = FRTMatrix3::CrossVec(wv, wv) * (-a / (wvNorm * wvNorm * wvNorm));
 	for (uint32 i = 0; i < 3; i ++)
 	{
-		for (uint32 j = 0; j < 3; j ++)
-		{
-			d2C0dXX[i][j] = dwudX[i] * dwudX[j] * wuMatrix;
-			d2C1dXX[i][j] = dwvdX[i] * dwvdX[j] * wvMatrix;
-		}
-	}
-	// First Derivative of Force, dfdx
-	FRTMatrix3 CPMat[3][3], dfdX[3][3];
-	for (uint32 i = 0; i < 3; i ++)
-	{
-		for (uint32 j = 0; j < 3; j ++)
-		{
-			CPMat[i][j] = FRTMatrix3::CrossVec(dC0dX[i], dC0dX[j]) + FRTMatrix3::CrossVec(dC1dX[i], dC1dX[j]);
-			dfdX[i][j] = -K * (C0 * d2C0dXX[i][j] + C1 * d2C1dXX[i][j] + CPMat[i][j]);
-		}
-	}
-
-	// fill in dfdx
-	for (uint32 i = 0; i < 3; ++i)
-	{
-		for (uint32 j = 0; j < 3; ++j)
-		{
-			for (uint32 m = 0; m < 3; m ++)
-			{
-				for (uint32 n = 0; n < 3; n ++)
-				{
-					dfdx[3 * V_Inx[m] + i][3 * V_Inx[n] + j] += dfdX[m][n][i][j];
-				}
-			}
-		}
+		Hu[i][i] += a / wuNorm;
+		Hv[i][i] += a / wvNorm;
 	}
+	FRTMatrix3 const Gu = FRTMatrix3::CrossVec(dC0dwu, dC0dwu);
+	FRTMatrix3 const Gv = FRTMatrix3::CrossVec(dC1dwv, dC1dwv);
 
-	// Compute And Setup dddv
-	for (int i = 0; i < 3; ++i)
+	// dfdx = -K * (C d2C/dXX + dC/dX dC/dX^T)
+	FRTMatrix3 Ku = Hu * (-K * C0), Kv = Hv * (-K * C1);
+	Ku -= Gu * K;
+	Kv -= Gv * K;
+	// dddv = -D * dC/dX dC/dX^T
+	FRTMatrix3 const Vu = Gu * -D, Vv = Gv * -D;
+	// dddx = -D * dC/dt * d2C/dXX
+	FRTMatrix3 const Xu = Hu * (-D * dC0dt), Xv = Hv * (-D * dC1dt);
+	for (uint32 m = 0; m < 3; m ++)
 	{
-		for (int j = 0; j < 3; ++j)
+		for (uint32 n = 0; n < 3; n ++)
 		{
-			for (uint32 m = 0; m < 3; m ++)
-			{
-				for (uint32 n = 0; n < 3; n ++)
-				{
-					dddv[3 * V_Inx[m] + i][3 * V_Inx[n] + j] += -D * CPMat[m][n][i][j];
-				}
-			}
-		}
-	}
-
-	// Compute And Setup dddx
-	FRTMatrix3 dDdX[3][3];
-	for (int i = 0; i < 3; ++i)
-	{
-		for (int j = 0; j < 3; ++j)
-		{
-			dDdX[i][j] = -D * (d2C0dXX[i][j] * dC0dt + d2C1dXX[i][j] * dC1dt);
-		}
-	}
-	
-	for (int i = 0; i < 3; ++i)
-	{
-		for (int j = 0; j < 3; ++j)
-		{
-			for (uint32 m = 0; m < 3; m ++)
-			{
-				for (uint32 n = 0; n < 3; n ++)
-				{
-					dddx[3 * V_Inx[m] + i][3 * V_Inx[n] + j] += dDdX[n][m][i][j];
-				}
-			}
+			float const Su = dwudXScalar[m] * dwudXScalar[n], Sv = dwvdXScalar[m] * dwvdXScalar[n];
+			FRTMatrix3 Block = Ku * Su;
+			Block += Kv * Sv;
+			AddBlock(dfdx, V_Inx[m], V_Inx[n], Block);
+			Block = Vu * Su;
+			Block += Vv * Sv;
+			AddBlock(dddv, V_Inx[m], V_Inx[n], Block);
+			Block = Xu * Su;
+			Block += Xv * Sv;
+			AddBlock(dddx, V_Inx[m], V_Inx[n], Block);
 		}
 	}
 }
 
 void FRTStretchCondition::Update(const FVector& P0, const FVector& P1, const FVector& P2, const FVector& V0, const FVector& V1, const FVector& V2)
 {
-	FClothTriangleProperties::Update(P0, P1, P2, V0, V1, V2);
-	// first derivatives of C:
-	const float a_wuNorm = a / wuNorm;
-	const float a_wvNorm = a / wvNorm;
-	const FVector wu_a_wuNorm = wu * a_wuNorm;
-	const FVector wv_a_wvNorm = wv * a_wvNorm;
-	for (uint32 i = 0; i < 3; i ++)
-	{
-		dC0dX[i] = dwudXScalar[i] * wu_a_wuNorm;
-		dC1dX[i] = dwvdXScalar[i] * wv_a_wvNorm;
-	}
+	UpdateTangents(P0, P1, P2);
+	// first derivatives of C on wu, wv:
+	dC0dwu = wu * (a / wuNorm);
+	dC1dwv = wv * (a / wvNorm);
 
 	// condition value:
 	C0 = a * (wuNorm - RestU);
 	C1 = a * (wvNorm - RestV);
 
 	// time derivative of C:
-	dC0dt = (dC0dX[0]|V0) + (dC0dX[1]|V1) + (dC0dX[2]|V2);
-	dC1dt = (dC1dX[0]|V0) + (dC1dX[1]|V1) + (dC1dX[2]|V2);
+	FVector const dwudt = dwudXScalar[0] * V0 + dwudXScalar[1] * V1 + dwudXScalar[2] * V2;
+	FVector const dwvdt = dwvdXScalar[0] * V0 + dwvdXScalar[1] * V1 + dwvdXScalar[2] * V2;
+	dC0dt = dC0dwu | dwudt;
+	dC1dt = dC1dwv | dwvdt;
 }
\ No newline at end of file
@@ -0,0 +1,613 @@
+﻿#include "FRTStretchShearKernel.h"
+
+#include "FRTStretchCondition.h"
+#include "FRTShearCondition.h"
+#include "Math/FRTSimd.h"
+#include "FRTGraphColoring.h"
+#include "RTClothMesh.h"
+
+FRTStretchShearKernel::FRTStretchShearKernel()
+{
+	SetParams({0, 0, 0, 0});
+}
+
+void FRTStretchShearKernel::Init(FClothRawMesh const& Mesh, float Rest_U, float Rest_V)
+{
+	RestU = Rest_U;
+	RestV = Rest_V;
+	int32 const NumOfTriangles = Mesh.Indices.Num() / 3;
+	for (auto *Arr : {&I0, &I1, &I2})
+	{
+		Arr->Reset(NumOfTriangles);
+	}
+	for (auto *Arr : {&Area, &Cu1, &Cu2, &Cv1, &Cv2, &KScale, &DScale})
+	{
+		Arr->Reset(NumOfTriangles);
+	}
+
+	// store triangles in color order, each color is a contiguous range
+	FRTGraphColoring Coloring;
+	Coloring.Build(Mesh.Indices, 3, Mesh.Positions.Num());
+	ColorOffsets = Coloring.Offsets;
+	for (int32 const i : Coloring.Order)
+	{
+		int32 const P0 = Mesh.Indices[3 * i];
+		int32 const P1 = Mesh.Indices[3 * i + 1];
+		int32 const P2 = Mesh.Indices[3 * i + 2];
+		FClothTriangleStaticProperties const Tri(P0, P1, P2, Mesh.TexCoords[P0], Mesh.TexCoords[P1], Mesh.TexCoords[P2]);
+		I0.Add(P0);
+		I1.Add(P1);
+		I2.Add(P2);
+		Area.Add(Tri.a);
+		Cu1.Add(Tri.dwudXScalar[1]);
+		Cu2.Add(Tri.dwudXScalar[2]);
+		Cv1.Add(Tri.dwvdXScalar[1]);
+		Cv2.Add(Tri.dwvdXScalar[2]);
+		KScale.Add(1.f);
+		DScale.Add(1.f);
+	}
+	StretchEnergy.SetNumZeroed(NumOfTriangles);
+	ShearEnergy.SetNumZeroed(NumOfTriangles);
+	ScatterMode = ERTScatterMode::Coloring;
+	PrivateBuffers.Init(NumOfTriangles, Mesh.Positions.Num(), RTCloth::Simd::Width);
+}
+
+void FRTStretchShearKernel::SetScaleMaps(TArray<float> const& VertexK, TArray<float> const& VertexD)
+{
+	for (int32 T = 0; T < Num(); T ++)
+	{
+		KScale[T] = VertexK.Num() > 0 ? (VertexK[I0[T]] + VertexK[I1[T]] + VertexK[I2[T]]) / 3.f : 1.f;
+		DScale[T] = VertexD.Num() > 0 ? (VertexD[I0[T]] + VertexD[I1[T]] + VertexD[I2[T]]) / 3.f : 1.f;
+	}
+}
+
+template <bool bDamping, bool bShear>
+void FRTStretchShearKernel::SelectVariant()
+{
+	ForcePass = &FRTStretchShearKernel::MembranePass<bDamping, bShear>;
+	DerivativePass = &FRTStretchShearKernel::MembraneDerivativesScalar<bDamping, bShear>;
+}
+
+void FRTStretchShearKernel::SetParams(FRTMembraneParams const& InParams)
+{
+	Params = InParams;
+	bool const bShear = Params.K_Shear != 0 || Params.D_Shear != 0;
+	bool const bDamping = Params.D_Stretch != 0 || (bShear && Params.D_Shear != 0);
+	if (bDamping)
+	{
+		bShear ? SelectVariant<true, true>() : SelectVariant<true, false>();
+	}
+	else
+	{
+		bShear ? SelectVariant<false, true>() : SelectVariant<false, false>();
+	}
+}
+
+void FRTStretchShearKernel::SelectScatterMode(TArray<FVector> const& X, TOptional<ERTScatterMode> const& Pinned)
+{
+	if (Pinned.IsSet())
+	{
+		ScatterMode = Pinned.GetValue();
+	}
+	else
+	{
+		TArray<FVector> V, F;
+		V.SetNumZeroed(X.Num());
+		F.SetNumZeroed(X.Num());
+		ScatterMode = PickFasterScatterMode([&](ERTScatterMode Mode)
+		{
+			ScatterMode = Mode;
+			ComputeForces(X, V, F);
+		});
+	}
+	if (ScatterMode == ERTScatterMode::Coloring)
+	{
+		PrivateBuffers.Reset();
+	}
+	UE_LOG(LogRTCloth, Log, TEXT("Stretch/Shear kernel: %d triangles, %d colors, scatter by %s (%s)"), Num(), ColorOffsets.Num() - 1,
+		ScatterMode == ERTScatterMode::Coloring ? TEXT("coloring") : TEXT("private buffers"), Pinned.IsSet() ? TEXT("pinned") : TEXT("timed"));
+}
+
+void FRTStretchShearKernel::ComputeForces(TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector> &Forces) const
+{
+	auto const Body = [&](int32 Begin, int32 End, TArray<FVector> &Out)
+	{
+		(this->*ForcePass)(Begin, End, X.GetData(), V.GetData(), Out.GetData());
+	};
+	if (ScatterMode == ERTScatterMode::PrivateBuffers)
+	{
+		PrivateBuffers.Run(Forces, Body);
+		return;
+	}
+	// triangles of one color share no vertex, chunks of a color scatter without races
+	FRTGraphColoring::ParallelForEachColor(ColorOffsets, ChunkSize, [&](int32, int32 Begin, int32 End)
+	{
+		Body(Begin, End, Forces);
+	});
+}
+
+void FRTStretchShearKernel::ComputeForcesAndDerivatives(
+	TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector> &Forces,
+	FRTBBSSMatrix<float> &dfdx,
+	FRTBBSSMatrix<float> &dddx,
+	FRTBBSSMatrix<float> &dddv) const
+{
+	// matrices without a locked pattern insert new entries, which must not happen in parallel
+	bool const bSingleThread = !dfdx.IsPatternLocked() || !dddx.IsPatternLocked() || !dddv.IsPatternLocked();
+	FRTGraphColoring::ParallelForEachColor(ColorOffsets, ChunkSize, [&](int32, int32 Begin, int32 End)
+	{
+		(this->*DerivativePass)(Begin, End, X.GetData(), V.GetData(), Forces.GetData(), dfdx, dddx, dddv);
+	}, bSingleThread);
+}
+
+float FRTStretchShearKernel::SumEnergy(TArray<float> const& Energy)
+{
+	double Sum = 0;
+	for (float const E : Energy)
+	{
+		Sum += E;
+	}
+	return float(Sum);
+}
+
+float FRTStretchShearKernel::MaxStrainChange(TArray<FVector> const& X, TArray<FVector> const& Reference) const
+{
+	int32 const NumOfChunks = (Num() + ChunkSize - 1) / ChunkSize;
+	TArray<float> ChunkMax;
+	ChunkMax.SetNumZeroed(NumOfChunks);
+	ParallelFor(NumOfChunks, [&](int32 Chunk)
+	{
+		float Max = 0;
+		for (int32 T = Chunk * ChunkSize; T < std::min(Num(), (Chunk + 1) * ChunkSize); T ++)
+		{
+			FVector const E1 = X[I1[T]] - X[I0[T]], E2 = X[I2[T]] - X[I0[T]];
+			FVector const R1 = Reference[I1[T]] - Reference[I0[T]], R2 = Reference[I2[T]] - Reference[I0[T]];
+			FVector const wu = Cu1[T] * E1 + Cu2[T] * E2, wv = Cv1[T] * E1 + Cv2[T] * E2;
+			FVector const ru = Cu1[T] * R1 + Cu2[T] * R2, rv = Cv1[T] * R1 + Cv2[T] * R2;
+			float const wuNorm = wu.Size(), wvNorm = wv.Size(), ruNorm = ru.Size(), rvNorm = rv.Size();
+			Max = std::max(Max, FMath::Abs(wuNorm - ruNorm) / RestU);
+			Max = std::max(Max, FMath::Abs(wvNorm - rvNorm) / RestV);
+			Max = std::max(Max, 1.f - (wu | ru) / (wuNorm * ruNorm));
+			Max = std::max(Max, 1.f - (wv | rv) / (wvNorm * rvNorm));
+		}
+		ChunkMax[Chunk] = Max;
+	});
+	float Max = 0;
+	for (float const M : ChunkMax)
+	{
+		Max = std::max(Max, M);
+	}
+	return Max;
+}
+
+template <bool bDamping, bool bShear>
+void FRTStretchShearKernel::MembranePass(int32 Begin, int32 End, FVector const* X, FVector const* V, FVector *Forces) const
+{
+	if (RTCloth::Simd::HasAVX2())
+	{
+		Begin = MembraneAVX2<bDamping, bShear>(Begin, End, X, V, Forces);
+	}
+	// scalar tail
+	MembraneScalar<bDamping, bShear>(Begin, End, X, V, Forces);
+}
+
+template <bool bDamping, bool bShear>
+void FRTStretchShearKernel::MembraneScalar(int32 Begin, int32 End, FVector const* X, FVector const* V, FVector *Forces) const
+{
+	for (int32 T = Begin; T < End; T ++)
+	{
+		FVector const E1 = X[I1[T]] - X[I0[T]];
+		FVector const E2 = X[I2[T]] - X[I0[T]];
+		FVector const wu = Cu1[T] * E1 + Cu2[T] * E2;
+		FVector const wv = Cv1[T] * E1 + Cv2[T] * E2;
+		float const a = Area[T];
+		float const wuNorm = wu.Size();
+		float const wvNorm = wv.Size();
+		float const a_wuNorm = a / wuNorm;
+		float const a_wvNorm = a / wvNorm;
+
+		// stretch: C0 = a * (|wu| - RestU), dC0/dt = a / |wu| * wu . (dwu/dt)
+		float const C0 = a * (wuNorm - RestU);
+		float const C1 = a * (wvNorm - RestV);
+		float const k = KScale[T];
+		float S0 = k * Params.K_Stretch * C0;
+		float S1 = k * Params.K_Stretch * C1;
+		StretchEnergy[T] = 0.5f * (S0 * C0 + S1 * C1);
+		// shear: C = a * wu . wv
+		float S = 0;
+		if (bShear)
+		{
+			float const C = a * (wu | wv);
+			S = k * Params.K_Shear * C;
+			ShearEnergy[T] = 0.5f * S * C;
+		}
+		if (bDamping)
+		{
+			FVector const V1 = V[I1[T]] - V[I0[T]];
+			FVector const V2 = V[I2[T]] - V[I0[T]];
+			FVector const dwu = Cu1[T] * V1 + Cu2[T] * V2;
+			FVector const dwv = Cv1[T] * V1 + Cv2[T] * V2;
+			float const d = DScale[T];
+			S0 += d * Params.D_Stretch * a_wuNorm * (wu | dwu);
+			S1 += d * Params.D_Stretch * a_wvNorm * (wv | dwv);
+			if (bShear)
+			{
+				S += d * Params.D_Shear * a * ((wv | dwu) + (wu | dwv));
+			}
+		}
+
+		// f_i = -(K * C + D * dC/dt) * dC/dX_i,
+		// stretch dC0/dX_i = Cu_i * a / |wu| * wu, shear dC/dX_i = a * (Cu_i * wv + Cv_i * wu)
+		FVector Hu = (S0 * a_wuNorm) * wu;
+		FVector Hv = (S1 * a_wvNorm) * wv;
+		if (bShear)
+		{
+			Hu += (S * a) * wv;
+			Hv += (S * a) * wu;
+		}
+		Scatter(T, Hu, Hv, Forces);
+	}
+}
+
+template <bool bDamping, bool bShear>
+void FRTStretchShearKernel::MembraneDerivativesScalar(
+	int32 Begin, int32 End, FVector const* X, FVector const* V, FVector *Forces,
+	FRTBBSSMatrix<float> &dfdx, FRTBBSSMatrix<float> &dddx, FRTBBSSMatrix<float> &dddv) const
+{
+	// the implicit integrator passes the same matrix as dfdx and dddx, add both in one lookup
+	bool const bSameDX = &dfdx == &dddx;
+	for (int32 T = Begin; T < End; T ++)
+	{
+		int32 const Idx[3] = {I0[T], I1[T], I2[T]};
+		float const Cu[3] = {-Cu1[T] - Cu2[T], Cu1[T], Cu2[T]};
+		float const Cv[3] = {-Cv1[T] - Cv2[T], Cv1[T], Cv2[T]};
+		FVector const E1 = X[Idx[1]] - X[Idx[0]];
+		FVector const E2 = X[Idx[2]] - X[Idx[0]];
+		FVector const wu = Cu[1] * E1 + Cu[2] * E2;
+		FVector const wv = Cv[1] * E1 + Cv[2] * E2;
+		float const a = Area[T];
+		float const wuNorm = wu.Size();
+		float const wvNorm = wv.Size();
+		FVector const nu = wu / wuNorm;
+		FVector const nv = wv / wvNorm;
+		// material of this triangle
+		float const K_Stretch = KScale[T] * Params.K_Stretch, K_Shear = KScale[T] * Params.K_Shear;
+		float const D_Stretch = DScale[T] * Params.D_Stretch, D_Shear = DScale[T] * Params.D_Shear;
+
+		// conditions and their time derivatives
+		float const C0 = a * (wuNorm - RestU);
+		float const C1 = a * (wvNorm - RestV);
+		float const C = bShear ? a * (wu | wv) : 0.f;
+		StretchEnergy[T] = 0.5f * K_Stretch * (C0 * C0 + C1 * C1);
+		ShearEnergy[T] = 0.5f * K_Shear * C * C;
+		float dC0dt = 0, dC1dt = 0, dCdt = 0;
+		if (bDamping)
+		{
+			FVector const V1 = V[Idx[1]] - V[Idx[0]];
+			FVector const V2 = V[Idx[2]] - V[Idx[0]];
+			FVector const dwu = Cu[1] * V1 + Cu[2] * V2;
+			FVector const dwv = Cv[1] * V1 + Cv[2] * V2;
+			dC0dt = a * (nu | dwu);
+			dC1dt = a * (nv | dwv);
+			dCdt = bShear ? a * ((wv | dwu) + (wu | dwv)) : 0.f;
+		}
+
+		// first derivatives of the conditions
+		FVector dC0dX[3], dC1dX[3], dCdX[3];
+		for (int32 i = 0; i < 3; i ++)
+		{
+			dC0dX[i] = (a * Cu[i]) * nu;
+			dC1dX[i] = (a * Cv[i]) * nv;
+			FVector F = (K_Stretch * C0 + D_Stretch * dC0dt) * dC0dX[i]
+				+ (K_Stretch * C1 + D_Stretch * dC1dt) * dC1dX[i];
+			if (bShear)
+			{
+				dCdX[i] = a * (Cu[i] * wv + Cv[i] * wu);
+				F += (K_Shear * C + D_Shear * dCdt) * dCdX[i];
+			}
+			Forces[Idx[i]] -= F;
+		}
+
+		// second derivatives:
+		// d2C0/dXmdXn = a * Cu_m * Cu_n * (I - nu nu^T) / |wu|, d2C1/dXmdXn alike with v,
+		// d2C/dXmdXn = a * (Cu_m * Cv_n + Cv_m * Cu_n) * I
+		float Pu[3][3], Pv[3][3];
+		for (int32 i = 0; i < 3; i ++)
+		{
+			for (int32 j = 0; j < 3; j ++)
+			{
+				Pu[i][j] = ((i == j) - nu[i] * nu[j]) / wuNorm;
+				Pv[i][j] = ((i == j) - nv[i] * nv[j]) / wvNorm;
+			}
+		}
+		for (int32 m = 0; m < 3; m ++)
+		{
+			for (int32 n = 0; n < 3; n ++)
+			{
+				float const S0 = a * Cu[m] * Cu[n];
+				float const S1 = a * Cv[m] * Cv[n];
+				float const SC = a * (Cu[m] * Cv[n] + Cv[m] * Cu[n]);
+				for (int32 i = 0; i < 3; i ++)
+				{
+					for (int32 j = 0; j < 3; j ++)
+					{
+						float const H0 = S0 * Pu[i][j];
+						float const H1 = S1 * Pv[i][j];
+						float const G = dC0dX[m][i] * dC0dX[n][j] + dC1dX[m][i] * dC1dX[n][j];
+						// df/dx = -K * (dC/dXm dC/dXn^T + C * d2C/dXmdXn)
+						float DF = -K_Stretch * (G + C0 * H0 + C1 * H1);
+						float DX = 0, DV = 0;
+						if (bDamping)
+						{
+							// dd/dx = -D * dC/dt * d2C/dXmdXn, dd/dv = -D * dC/dXm dC/dXn^T
+							DX = -D_Stretch * (dC0dt * H0 + dC1dt * H1);
+							DV = -D_Stretch * G;
+						}
+						if (bShear)
+						{
+							float const H = i == j ? SC : 0.f;
+							float const GC = dCdX[m][i] * dCdX[n][j];
+							DF -= K_Shear * (GC + C * H);
+							if (bDamping)
+							{
+								DX -= D_Shear * dCdt * H;
+								DV -= D_Shear * GC;
+							}
+						}
+						uint32 const Row = 3 * Idx[m] + i, Col = 3 * Idx[n] + j;
+						if (!bDamping)
+						{
+							dfdx[Row][Col] += DF;
+						}
+						else if (bSameDX)
+						{
+							dfdx[Row][Col] += DF + DX;
+							dddv[Row][Col] += DV;
+						}
+						else
+						{
+							dfdx[Row][Col] += DF;
+							dddx[Row][Col] += DX;
+							dddv[Row][Col] += DV;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+#if RTCLOTH_WITH_AVX2
+using namespace RTCloth::Simd;
+
+// SoA arrays of the kernel
+struct FTriangleArrays
+{
+	int32 const *I0, *I1, *I2;
+	float const *Area, *Cu1, *Cu2, *Cv1, *Cv2;
+	float const *KScale, *DScale;
+};
+
+// gather positions and velocities of 8 triangles, and compute wu, wv and their time derivatives
+struct FTriangleLanes
+{
+	FVec8 wu, wv, dwu, dwv;
+	FFloat8 a;
+};
+
+// velocities are gathered only with damping
+template <bool bDamping>
+RTCLOTH_AVX2_FUNC static FORCEINLINE FTriangleLanes GatherTriangles(
+	FTriangleArrays const& Arr, int32 T, FVector const* X, FVector const* V)
+{
+	FInt8 const Idx0 = Times3(Load(Arr.I0 + T));
+	FInt8 const Idx1 = Times3(Load(Arr.I1 + T));
+	FInt8 const Idx2 = Times3(Load(Arr.I2 + T));
+	FVec8 const X0 = Gather(X, Idx0);
+	FVec8 const E1 = Sub(Gather(X, Idx1), X0);
+	FVec8 const E2 = Sub(Gather(X, Idx2), X0);
+	FFloat8 const cu1 = Load(Arr.Cu1 + T), cu2 = Load(Arr.Cu2 + T);
+	FFloat8 const cv1 = Load(Arr.Cv1 + T), cv2 = Load(Arr.Cv2 + T);
+
+	FTriangleLanes Res;
+	Res.wu = ScaleAdd(E1, cu1, Scale(E2, cu2));
+	Res.wv = ScaleAdd(E1, cv1, Scale(E2, cv2));
+	if (bDamping)
+	{
+		FVec8 const V0 = Gather(V, Idx0);
+		FVec8 const V1 = Sub(Gather(V, Idx1), V0);
+		FVec8 const V2 = Sub(Gather(V, Idx2), V0);
+		Res.dwu = ScaleAdd(V1, cu1, Scale(V2, cu2));
+		Res.dwv = ScaleAdd(V1, cv1, Scale(V2, cv2));
+	}
+	Res.a = Load(Arr.Area + T);
+	return Res;
+}
+
+// Hu, Hv of 8 triangles starting from T, stretch and shear added up
+template <bool bDamping, bool bShear>
+RTCLOTH_AVX2_FUNC static void MembraneBatchAVX2(
+	FTriangleArrays const& Arr, int32 T, FVector const* X, FVector const* V,
+	FRTMembraneParams const& Params, float RestU, float RestV, float Hu[3][Width], float Hv[3][Width],
+	float *StretchEnergy, float *ShearEnergy)
+{
+	FTriangleLanes const L = GatherTriangles<bDamping>(Arr, T, X, V);
+
+	// stretch
+	FFloat8 const wuNorm = Sqrt(Dot(L.wu, L.wu));
+	FFloat8 const wvNorm = Sqrt(Dot(L.wv, L.wv));
+	FFloat8 const a_wuNorm = Div(L.a, wuNorm);
+	FFloat8 const a_wvNorm = Div(L.a, wvNorm);
+	FFloat8 const k = Load(Arr.KScale + T), Half = Set1(0.5f);
+	FFloat8 const KStretch = Mul(Set1(Params.K_Stretch), k);
+	FFloat8 const C0 = Mul(L.a, Sub(wuNorm, Set1(RestU)));
+	FFloat8 const C1 = Mul(L.a, Sub(wvNorm, Set1(RestV)));
+	FFloat8 S0 = Mul(KStretch, C0);
+	FFloat8 S1 = Mul(KStretch, C1);
+	Store(StretchEnergy, Mul(Half, MulAdd(S0, C0, Mul(S1, C1))));
+	if (bDamping)
+	{
+		FFloat8 const DStretch = Mul(Set1(Params.D_Stretch), Load(Arr.DScale + T));
+		S0 = MulAdd(DStretch, Mul(a_wuNorm, Dot(L.wu, L.dwu)), S0);
+		S1 = MulAdd(DStretch, Mul(a_wvNorm, Dot(L.wv, L.dwv)), S1);
+	}
+	FVec8 Su = Scale(L.wu, Mul(S0, a_wuNorm));
+	FVec8 Sv = Scale(L.wv, Mul(S1, a_wvNorm));
+
+	// shear
+	if (bShear)
+	{
+		FFloat8 const C = Mul(L.a, Dot(L.wu, L.wv));
+		FFloat8 S = Mul(Mul(Set1(Params.K_Shear), k), C);
+		Store(ShearEnergy, Mul(Half, Mul(S, C)));
+		if (bDamping)
+		{
+			FFloat8 const DShear = Mul(Set1(Params.D_Shear), Load(Arr.DScale + T));
+			S = MulAdd(DShear, Mul(L.a, Add(Dot(L.wv, L.dwu), Dot(L.wu, L.dwv))), S);
+		}
+		S = Mul(S, L.a);
+		Su = ScaleAdd(L.wv, S, Su);
+		Sv = ScaleAdd(L.wu, S, Sv);
+	}
+
+	Store(Hu[0], Hu[1], Hu[2], Su);
+	Store(Hv[0], Hv[1], Hv[2], Sv);
+}
+#endif
+
+template <bool bDamping, bool bShear>
+int32 FRTStretchShearKernel::MembraneAVX2(int32 Begin, int32 End, FVector const* X, FVector const* V, FVector *Forces) const
+{
+	int32 T = Begin;
+#if RTCLOTH_WITH_AVX2
+	FTriangleArrays const Arr{I0.GetData(), I1.GetData(), I2.GetData(),
+		Area.GetData(), Cu1.GetData(), Cu2.GetData(), Cv1.GetData(), Cv2.GetData(), KScale.GetData(), DScale.GetData()};
+	alignas(32) float Hu[3][Width], Hv[3][Width];
+	for (; T + Width <= End; T += Width)
+	{
+		MembraneBatchAVX2<bDamping, bShear>(Arr, T, X, V, Params, RestU, RestV, Hu, Hv,
+			StretchEnergy.GetData() + T, ShearEnergy.GetData() + T);
+		for (int32 l = 0; l < Width; l ++)
+		{
+			Scatter(T + l, {Hu[0][l], Hu[1][l], Hu[2][l]}, {Hv[0][l], Hv[1][l], Hv[2][l]}, Forces);
+		}
+	}
+#endif
+	return T;
+}
+
+float FRTStretchShearKernel::CompareWithConditions(FClothRawMesh *Mesh, float &DerivativeError)
+{
+	// stretch, shear and move the cloth a bit, relative to the mean edge length
+	float EdgeLength = 0;
+	for (int32 T = 0; T < Num(); T ++)
+	{
+		EdgeLength += (Mesh->Positions[I1[T]] - Mesh->Positions[I0[T]]).Size();
+	}
+	EdgeLength = Num() > 0 ? EdgeLength / Num() : 1.f;
+	TArray<FVector> X = Mesh->Positions, V;
+	V.SetNumZeroed(X.Num());
+	for (int32 i = 0; i < X.Num(); i ++)
+	{
+		X[i] *= FVector(1.1f, 0.9f, 1.f);
+		X[i].Z += 0.2f * EdgeLength * FMath::Sin(0.37f * i);
+		V[i] = FVector(FMath::Cos(0.11f * i), FMath::Sin(0.23f * i), 0.5f);
+	}
+	TArray<float> Dir;
+	Dir.SetNumUninitialized(3 * X.Num());
+	for (int32 i = 0; i < Dir.Num(); i ++)
+	{
+		Dir[i] = FMath::Sin(0.17f * i);
+	}
+	float const h = 1e-2f * EdgeLength;
+
+	FRTMembraneParams const Saved = Params;
+	float Error = 0;
+	DerivativeError = 0;
+	// one material per variant
+	FRTMembraneParams const Materials[4] = {{100, 6, 1, 1}, {100, 6, 0, 0}, {100, 0, 1, 0}, {100, 0, 0, 0}};
+	for (FRTMembraneParams const& Material : Materials)
+	{
+		// forces and energies, compared with the conditions
+		SetParams(Material);
+		TArray<FVector> Expected, Actual;
+		Expected.SetNumZeroed(X.Num());
+		Actual.SetNumZeroed(X.Num());
+		double ExpectedStretch = 0, ExpectedShear = 0;
+		for (int32 T = 0; T < Num(); T ++)
+		{
+			FRTStretchCondition Stretch(Mesh, I0[T], I1[T], I2[T], RestU, RestV);
+			Stretch.UpdateCondition(X, V, Mesh->TexCoords);
+			Stretch.ComputeForces(KScale[T] * Material.K_Stretch, DScale[T] * Material.D_Stretch, Expected, Expected);
+			ExpectedStretch += Stretch.Energy(KScale[T] * Material.K_Stretch);
+			FRTShearCondition Shear(Mesh, I0[T], I1[T], I2[T]);
+			Shear.UpdateCondition(X, V, Mesh->TexCoords);
+			Shear.ComputeForces(KScale[T] * Material.K_Shear, DScale[T] * Material.D_Shear, Expected, Expected);
+			ExpectedShear += Shear.Energy(KScale[T] * Material.K_Shear);
+		}
+		ComputeForces(X, V, Actual);
+
+		// energies, relative to the total
+		Error = std::max(Error, float(FMath::Abs(LastStretchEnergy() - ExpectedStretch) / std::max(ExpectedStretch, 1e-6)));
+		Error = std::max(Error, float(FMath::Abs(LastShearEnergy() - ExpectedShear) / std::max(ExpectedStretch + ExpectedShear, 1e-6)));
+
+		float MaxForce = 0, MaxDiff = 0;
+		for (int32 i = 0; i < X.Num(); i ++)
+		{
+			MaxForce = std::max(MaxForce, Expected[i].GetAbsMax());
+			MaxDiff = std::max(MaxDiff, (Expected[i] - Actual[i]).GetAbsMax());
+		}
+		Error = std::max(Error, MaxForce > 0 ? MaxDiff / MaxForce : MaxDiff);
+
+		// dfdx with damping off and dddv with stiffness off, compared with central differences along Dir
+		for (int32 Pass = 0; Pass < 2; Pass ++)
+		{
+			bool const bVelocity = Pass == 1;
+			SetParams(bVelocity ? FRTMembraneParams{0, Material.D_Stretch, 0, Material.D_Shear}
+				: FRTMembraneParams{Material.K_Stretch, 0, Material.K_Shear, 0});
+			if (bVelocity && Material.D_Stretch == 0)
+			{
+				continue;
+			}
+			FRTBBSSMatrix<float> dfdx, dddx, dddv;
+			for (auto *Mat : {&dfdx, &dddx, &dddv})
+			{
+				Mat->UpdateSize(3 * X.Num());
+			}
+			TArray<FVector> Unused;
+			Unused.SetNumZeroed(X.Num());
+			ComputeForcesAndDerivatives(X, V, Unused, dfdx, dddx, dddv);
+			FRTBBSSMatrix<float> &Mat = bVelocity ? dddv : dfdx;
+			Mat.LockPattern();
+			TArray<float> HDir;
+			HDir.SetNumZeroed(Dir.Num());
+			Mat.MulVector(HDir.GetData(), Dir.GetData(), Dir.Num());
+
+			TArray<FVector> Plus = bVelocity ? V : X, Minus = Plus, FPlus, FMinus;
+			FPlus.SetNumZeroed(X.Num());
+			FMinus.SetNumZeroed(X.Num());
+			for (int32 i = 0; i < X.Num(); i ++)
+			{
+				FVector const D(Dir[3 * i], Dir[3 * i + 1], Dir[3 * i + 2]);
+				Plus[i] += h * D;
+				Minus[i] -= h * D;
+			}
+			ComputeForces(bVelocity ? X : Plus, bVelocity ? Plus : V, FPlus);
+			ComputeForces(bVelocity ? X : Minus, bVelocity ? Minus : V, FMinus);
+
+			float MaxHDir = 0, MaxHDirDiff = 0;
+			for (int32 i = 0; i < X.Num(); i ++)
+			{
+				for (int32 c = 0; c < 3; c ++)
+				{
+					float const Diff = (FPlus[i][c] - FMinus[i][c]) / (2 * h);
+					MaxHDir = std::max(MaxHDir, FMath::Abs(HDir[3 * i + c]));
+					MaxHDirDiff = std::max(MaxHDirDiff, FMath::Abs(Diff - HDir[3 * i + c]));
+				}
+			}
+			DerivativeError = std::max(DerivativeError, MaxHDir > 0 ? MaxHDirDiff / MaxHDir : MaxHDirDiff);
+		}
+	}
+	SetParams(Saved);
+	return Error;
+}
@@ -1,5 +1,7 @@
 ﻿#include "ModifiedCGSolver.h"
 
+#include "Async/ParallelFor.h"
+
 void FModifiedCGSolver::Init(FRTBBSSMatrix<float> const&Mat)
 {
 	P.SetNumZeroed(Mat.Size());
@@ -7,101 +9,239 @@ void FModifiedCGSolver::Init(FRTBBSSMatrix<float> const&Mat)
 	C.SetNumZeroed(Mat.Size());
 	S.SetNumZeroed(Mat.Size());
 	Q.SetNumZeroed(Mat.Size());
+	if (Rows.Num() != int32(Mat.Size()))
+	{
+		// one island of all rows
+		Rows.SetNumUninitialized(Mat.Size());
+		for (uint32 i = 0; i < Mat.Size(); i ++)
+		{
+			Rows[i] = i;
+		}
+		RowOffsets = {0, int32(Mat.Size())};
+		VertexIslands.Init(0, Mat.Size() / 3);
+		UpdateIslandConstraints();
+	}
+	UpdateBlocks();
 }
 
-void FModifiedCGSolver::Solve(FRTBBSSMatrix<float> & A, TArray<float> const& B, TArray<float> &X)
+void FModifiedCGSolver::SetIslands(TArray<int32> const& Offsets, TArray<int32> const& Vertices)
 {
-	// setup precondition
-	for (int32 i = 0; i < P.Num(); i ++)
+	int32 const NumOfIslands = Offsets.Num() - 1;
+	Rows.Reset(3 * Vertices.Num());
+	RowOffsets.Reset(Offsets.Num());
+	VertexIslands.SetNumUninitialized(Vertices.Num());
+	RowOffsets.Add(0);
+	for (int32 Island = 0; Island < NumOfIslands; Island ++)
 	{
-		P[i] = A[i][i];
+		for (int32 k = Offsets[Island]; k < Offsets[Island + 1]; k ++)
+		{
+			int32 const V = Vertices[k];
+			VertexIslands[V] = Island;
+			Rows.Add(3 * V);
+			Rows.Add(3 * V + 1);
+			Rows.Add(3 * V + 2);
+		}
+		RowOffsets.Add(Rows.Num());
+	}
+	UpdateIslandConstraints();
+	UpdateBlocks();
+}
+
+void FModifiedCGSolver::SetSubdomains(TArray<int32> const& VertexSubdomains, int32 InLocalSweeps)
+{
+	Subdomains = VertexSubdomains;
+	LocalSweeps = InLocalSweeps;
+	UpdateBlocks();
+}
+
+void FModifiedCGSolver::UpdateBlocks()
+{
+	int32 const NumOfIslands = RowOffsets.Num() - 1;
+	BlockOffsets.Reset();
+	IslandBlocks.Reset();
+	if (NumOfIslands <= 0) return;
+	bool const bSubdomains = Subdomains.Num() * 3 == Rows.Num();
+	if (bSubdomains)
+	{
+		// rows stay grouped by island and keep their order within a subdomain
+		Rows.StableSort([this](uint32 A, uint32 B)
+		{
+			int32 const IslandA = VertexIslands[A / 3];
+			int32 const IslandB = VertexIslands[B / 3];
+			return IslandA != IslandB ? IslandA < IslandB : Subdomains[A / 3] < Subdomains[B / 3];
+		});
 	}
-	uint32 const Size = X.Num();
-	// set up velocity constraints
-	if (VelConstraint.Size() > 0)
+	RowBlocks.SetNumUninitialized(Rows.Num());
+	BlockOffsets.Add(0);
+	IslandBlocks.Add(0);
+	for (int32 Island = 0; Island < NumOfIslands; Island ++)
 	{
-		for (uint32 i = 0; i < Size / 3; i ++)
+		for (int32 k = RowOffsets[Island]; k < RowOffsets[Island + 1]; k ++)
 		{
-			X[3 * i] = VelConstraint[0];
-			X[3 * i + 1] = VelConstraint[1];
-			X[3 * i + 2] = VelConstraint[2];
+			if (bSubdomains && k > RowOffsets[Island] && Subdomains[Rows[k] / 3] != Subdomains[Rows[k - 1] / 3])
+			{
+				BlockOffsets.Add(k);
+			}
+			RowBlocks[Rows[k]] = BlockOffsets.Num() - 1;
 		}
+		BlockOffsets.Add(RowOffsets[Island + 1]);
+		IslandBlocks.Add(BlockOffsets.Num() - 1);
+	}
+	BlockSums.SetNumZeroed(BlockOffsets.Num() - 1);
+}
+
+template <typename FBody>
+void FModifiedCGSolver::ForEachBlock(int32 Island, FBody const& Body) const
+{
+	int32 const First = IslandBlocks[Island];
+	int32 const NumOfBlocks = IslandBlocks[Island + 1] - First;
+	ParallelFor(NumOfBlocks, [&](int32 k)
+	{
+		Body(First + k, BlockOffsets[First + k], BlockOffsets[First + k + 1]);
+	}, NumOfBlocks == 1);
+}
+
+void FModifiedCGSolver::UpdateIslandConstraints()
+{
+	int32 const NumOfIslands = RowOffsets.Num() - 1;
+	ConstraintOffsets.Init(0, NumOfIslands + 1);
+	IslandConstraints.SetNumUninitialized(ConstraintIds.Num());
+	if (NumOfIslands <= 0) return;
+	for (auto const Id : ConstraintIds)
+	{
+		ConstraintOffsets[VertexIslands[Id] + 1] ++;
+	}
+	for (int32 Island = 0; Island < NumOfIslands; Island ++)
+	{
+		ConstraintOffsets[Island + 1] += ConstraintOffsets[Island];
+	}
+	TArray<int32> Next(ConstraintOffsets.GetData(), NumOfIslands);
+	for (int32 i = 0; i < ConstraintIds.Num(); i ++)
+	{
+		IslandConstraints[Next[VertexIslands[ConstraintIds[i]]] ++] = i;
+	}
+}
+
+void FModifiedCGSolver::Solve(FRTBBSSMatrix<float> & A, TArray<float> const& B, TArray<float> &X)
+{
+	int32 const NumOfIslands = RowOffsets.Num() - 1;
+	check(Rows.Num() == X.Num());
+	double const Init = FPlatformTime::Seconds();
+	TArray<uint32> IslandIterations;
+	IslandIterations.Init(0, NumOfIslands);
+	ParallelFor(NumOfIslands, [&](int32 Island)
+	{
+		if (SkippedIslands && (*SkippedIslands)[Island]) return;
+		IslandIterations[Island] = SolveIsland(Island, A, B, X);
+	}, NumOfIslands == 1);
+	uint32 Total = 0;
+	Iterations = 0;
+	for (auto const I : IslandIterations)
+	{
+		Iterations = FMath::Max(Iterations, I);
+		Total += I;
 	}
+	double const Cost = (FPlatformTime::Seconds() - Init) * 1000.0;
+	UE_LOG(LogTemp, Warning, TEXT("Iterations %d (max of %d islands, %d in total, %d blocks), Cost %f"),
+		Iterations, NumOfIslands, Total, BlockSums.Num(), Cost);
+}
 
-	// calculate delta0
-	// δ0 = filter(b)TP filter(b)
+uint32 FModifiedCGSolver::SolveIsland(int32 Island, FRTBBSSMatrix<float> const& A, TArray<float> const& B, TArray<float> &X)
+{
+	// setup precondition and velocity constraints, C = b
+	ForEachBlock(Island, [&](int32, int32 Begin, int32 End)
+	{
+		for (int32 k = Begin; k < End; k ++)
+		{
+			uint32 const i = Rows[k];
+			P[i] = A.Diagonal(i);
+			if (VelConstraint.Size() > 0)
+			{
+				X[i] = VelConstraint[i % 3];
+			}
+			C[i] = B[i];
+		}
+	});
+
+	// calculate delta0 with the preconditioner of δ_new, so the relative test means the same in every mode
+	// δ0 = filter(b)T P−1 filter(b)
 	// C = filter(b)
-	for (uint32 i = 0; i < Size; i ++)
-		C[i] = B[i];
-	Filter(C);
-	// S = P filter(b)
-	Precondition(C, false, S);
-	// delta0 = C.Dot(S)
-	float Delta_0 = 0;
-	for (uint32 i = 0; i < Size; i ++)
-		Delta_0 += C[i] * S[i];
+	Filter(Island, C);
+	// S = P−1 filter(b)
+	ForEachBlock(Island, [&](int32 Block, int32, int32)
+	{
+		Precondition(Block, A, C, S);
+	});
+	float const Delta_0 = Dot(Island, C, S);
 
 	// r = filter(b − AX)
-	A.MulVector(R.GetData(), X.GetData(), X.Num());
-	for (uint32 i = 0; i < Size; i ++)
-		R[i] = B[i] - R[i];
-	Filter(R);
+	ForEachBlock(Island, [&](int32, int32 Begin, int32 End)
+	{
+		for (int32 k = Begin; k < End; k ++)
+			R[Rows[k]] = B[Rows[k]] - A.MulRow(Rows[k], X.GetData());
+	});
+	Filter(Island, R);
 
 	// c = filter(P−1r)
-	Precondition(R, true, C);
-	Filter(C);
+	ForEachBlock(Island, [&](int32 Block, int32, int32)
+	{
+		Precondition(Block, A, R, C);
+	});
+	Filter(Island, C);
 
 	// δ_new = rT c
-	float Delta_new = 0;
-	for (uint32 i = 0; i < Size; i ++)
-		Delta_new += C[i] * R[i];
+	float Delta_new = Dot(Island, C, R);
 	uint32 I = 0;
-	double Init = FPlatformTime::Seconds();
-	double MatVecMul = 0, Other = 0;
 	for (;Delta_new > Tolerance * Tolerance * Delta_0 && I < MaxIterations; I ++)
 	{
-		double Timer = FPlatformTime::Seconds();
 		// q = filter(Ac)
-		A.MulVector(Q.GetData(), C.GetData(), C.Num());
-		Filter(Q);
-		MatVecMul += FPlatformTime::Seconds() - Timer;
-		Timer = FPlatformTime::Seconds();
+		ForEachBlock(Island, [&](int32, int32 Begin, int32 End)
+		{
+			for (int32 k = Begin; k < End; k ++)
+				Q[Rows[k]] = A.MulRow(Rows[k], C.GetData());
+		});
+		Filter(Island, Q);
 
 		// α = δnew/(cT q)
-		float Alpha = 0;
-		for (uint32 i = 0; i < Size; i ++)
-			Alpha += C[i] * Q[i];
+		float Alpha = Dot(Island, C, Q);
 		check(!isnan(Alpha) && !isinf(Alpha))
 		Alpha = Delta_new / Alpha;
 
 		// X = X + αc
-		for (uint32 i = 0; i < Size; i ++)
-			X[i] += Alpha * C[i];
-
 		// r = r − αq
-		for (uint32 i = 0; i < Size; i ++)
-			R[i] -= Alpha * Q[i];
-
-		// s = P−1r
-		Precondition(R, true, S);
+		// s = P−1r, the preconditioner only reads r of its own block
+		// δnew = rT s
+		ForEachBlock(Island, [&](int32 Block, int32 Begin, int32 End)
+		{
+			for (int32 k = Begin; k < End; k ++)
+			{
+				X[Rows[k]] += Alpha * C[Rows[k]];
+				R[Rows[k]] -= Alpha * Q[Rows[k]];
+			}
+			Precondition(Block, A, R, S);
+			float Sum = 0;
+			for (int32 k = Begin; k < End; k ++)
+				Sum += R[Rows[k]] * S[Rows[k]];
+			BlockSums[Block] = Sum;
+		});
 
 		float Delta_old = Delta_new;
 		Delta_new = 0;
-		// δnew = rT s
-		for (uint32 i = 0; i < Size; i ++)
-			Delta_new += R[i] * S[i];
+		for (int32 Block = IslandBlocks[Island]; Block < IslandBlocks[Island + 1]; Block ++)
+			Delta_new += BlockSums[Block];
 		
 		check(!isnan(Delta_new) && !isinf(Delta_new))
 		// c = filter(s + δnew/δold * c)
 		Delta_old = Delta_new / Delta_old;
-		for (uint32 i = 0; i < Size; i ++)
-			C[i] = S[i] + Delta_old * C[i];
+		ForEachBlock(Island, [&](int32, int32 Begin, int32 End)
+		{
+			for (int32 k = Begin; k < End; k ++)
+				C[Rows[k]] = S[Rows[k]] + Delta_old * C[Rows[k]];
+		});
 
-		Filter(C);
-		Other += FPlatformTime::Seconds() - Timer;
+		Filter(Island, C);
 	}
-	double const Cost = (FPlatformTime::Seconds() - Init) * 1000.0;
-	UE_LOG(LogTemp, Warning, TEXT("Iterations %d, Final Delta Radio %f, Cost %f (/It), MulVec %f, VecVec %f"), I, Delta_new / (Tolerance * Tolerance * Delta_0), Cost / (I + 1), MatVecMul * 1000, Other * 1000);
+	return I;
 }
 
 FModifiedCGSolver::~FModifiedCGSolver()
@@ -109,22 +249,59 @@ FModifiedCGSolver::~FModifiedCGSolver()
 	
 }
 
-void FModifiedCGSolver::Precondition(TArray<float> const&In, bool Inverse, TArray<float> &Out)
+void FModifiedCGSolver::Precondition(int32 Block, FRTBBSSMatrix<float> const& A, TArray<float> const&In, TArray<float> &Out) const
 {
-	for (int32 i = 0; i < In.Num(); i ++) 
+	int32 const Begin = BlockOffsets[Block];
+	int32 const End = BlockOffsets[Block + 1];
+	if (LocalSweeps <= 0 || Subdomains.Num() * 3 != Rows.Num())
 	{
-		Out[i] = Inverse ? In[i] / P[i] : In[i] * P[i];
+		for (int32 k = Begin; k < End; k ++)
+			Out[Rows[k]] = In[Rows[k]] / P[Rows[k]];
+		return;
+	}
+	// symmetric Gauss-Seidel sweeps from zero on the block of A, keeps P symmetric for CG
+	for (int32 k = Begin; k < End; k ++)
+		Out[Rows[k]] = 0;
+	auto const InBlock = [this, Block](uint32 J) {return RowBlocks[J] == Block;};
+	for (int32 Sweep = 0; Sweep < LocalSweeps; Sweep ++)
+	{
+		for (int32 k = Begin; k < End; k ++)
+		{
+			uint32 const i = Rows[k];
+			Out[i] = (In[i] - A.MulRowOffDiagonal(i, Out.GetData(), InBlock)) / P[i];
+		}
+		for (int32 k = End - 1; k >= Begin; k --)
+		{
+			uint32 const i = Rows[k];
+			Out[i] = (In[i] - A.MulRowOffDiagonal(i, Out.GetData(), InBlock)) / P[i];
+		}
 	}
 }
 
-void FModifiedCGSolver::Filter(TArray<float> &Out)
+float FModifiedCGSolver::Dot(int32 Island, TArray<float> const& U, TArray<float> const& V) const
 {
-	for (int32 i = 0; i < ConstraintIds.Num(); i ++)
+	ForEachBlock(Island, [&](int32 Block, int32 Begin, int32 End)
+	{
+		float Sum = 0;
+		for (int32 k = Begin; k < End; k ++)
+			Sum += U[Rows[k]] * V[Rows[k]];
+		BlockSums[Block] = Sum;
+	});
+	float Res = 0;
+	for (int32 Block = IslandBlocks[Island]; Block < IslandBlocks[Island + 1]; Block ++)
+		Res += BlockSums[Block];
+	return Res;
+}
+
+void FModifiedCGSolver::Filter(int32 Island, TArray<float> &Out) const
+{
+	for (int32 k = ConstraintOffsets[Island]; k < ConstraintOffsets[Island + 1]; k ++)
 	{
+		int32 const i = IslandConstraints[k];
 		uint32 const idx  = ConstraintIds[i];
 		auto res = ConstraintMats[i] * FVector(Out[3 * idx], Out[3 * idx + 1], Out[3 * idx + 2]);
 		Out[3 * idx] = res[0];
 		Out[3 * idx + 1] = res[1];
 		Out[3 * idx + 2] = res[2];
 	}
-}
\ No newline at end of file
+}
@@ -4,6 +4,8 @@
 
 #define LOCTEXT_NAMESPACE "FRTClothMeshModule"
 
+DEFINE_LOG_CATEGORY(LogRTCloth);
+
 void FRTClothMeshModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
@@ -0,0 +1,106 @@
+﻿#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#include "FRTBendKernel.h"
+#include "FRTCorotationalKernel.h"
+#include "FRTStretchShearKernel.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// N x N vertices over a 100 x 100 square, two triangles per quad
+	void MakeGrid(FClothRawMesh &Mesh, int32 N)
+	{
+		for (int32 j = 0; j < N; j ++)
+		{
+			for (int32 i = 0; i < N; i ++)
+			{
+				FVector2D const UV(float(i) / (N - 1), float(j) / (N - 1));
+				Mesh.Positions.Add(FVector(100.f * UV.X, 0, -100.f * UV.Y));
+				Mesh.TexCoords.Add(UV);
+				Mesh.Colors.Add(FColor::White);
+			}
+		}
+		for (int32 j = 0; j < N - 1; j ++)
+		{
+			for (int32 i = 0; i < N - 1; i ++)
+			{
+				uint32 const A = j * N + i, B = A + 1, C = A + N, D = C + 1;
+				Mesh.Indices.Append({A, C, B, B, C, D});
+			}
+		}
+	}
+
+	// hinges of the interior edges, in the order the CPU systems add them from the half edges
+	void AddHinges(FRTBendKernel &Kernel, FClothRawMesh const& Mesh)
+	{
+		// directed edge P -> Q to the opposite vertex of its triangle
+		TMap<uint64, uint32> Opposite;
+		for (int32 t = 0; t < Mesh.Indices.Num(); t += 3)
+		{
+			for (int32 e = 0; e < 3; e ++)
+			{
+				uint64 const P = Mesh.Indices[t + e], Q = Mesh.Indices[t + (e + 1) % 3];
+				Opposite.Add(P << 32 | Q, Mesh.Indices[t + (e + 2) % 3]);
+			}
+		}
+		TArray<TTuple<uint32, uint32, uint32, uint32>> Hinges;
+		for (auto const& Pair : Opposite)
+		{
+			uint32 const P = uint32(Pair.Key >> 32), Q = uint32(Pair.Key);
+			uint32 const* Other = Opposite.Find(uint64(Q) << 32 | P);
+			if (Other && P < Q)
+			{
+				Hinges.Add(MakeTuple(Pair.Value, P, Q, *Other));
+			}
+		}
+		Kernel.Reset(Hinges.Num(), 0);
+		for (auto const& H : Hinges)
+		{
+			Kernel.Add(H.Get<0>(), H.Get<1>(), H.Get<2>(), H.Get<3>(), Mesh.TexCoords);
+		}
+		Kernel.Finalize(Mesh.Positions.Num());
+	}
+}
+
+// forces and energies of the batched kernels against the per element conditions,
+// their Hessians against central differences of the forces
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRTClothKernelsTest, "RTClothMesh.Kernels.MatchConditions",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FRTClothKernelsTest::RunTest(FString const& Parameters)
+{
+	// central differences in float are only good to about 1e-2
+	float const ForceTolerance = 1e-3f, DerivativeTolerance = 1e-2f;
+	auto const Check = [&](TCHAR const* Name, float Error, float DerivativeError)
+	{
+		TestTrue(FString::Printf(TEXT("%s forces, relative error %f"), Name, Error), Error < ForceTolerance);
+		TestTrue(FString::Printf(TEXT("%s derivatives, relative error %f"), Name, DerivativeError), DerivativeError < DerivativeTolerance);
+	};
+
+	FClothRawMesh Mesh;
+	MakeGrid(Mesh, 9);
+	float DerivativeError = 0;
+	{
+		FRTStretchShearKernel Kernel;
+		Kernel.Init(Mesh, 100, 100);
+		float const Error = Kernel.CompareWithConditions(&Mesh, DerivativeError);
+		Check(TEXT("Stretch/Shear kernel"), Error, DerivativeError);
+	}
+	{
+		FRTCorotationalKernel Kernel;
+		Kernel.Init(Mesh, 100, 100);
+		float const Error = Kernel.CompareWithConditions(&Mesh, DerivativeError);
+		Check(TEXT("Co-rotational kernel"), Error, DerivativeError);
+	}
+	{
+		FRTBendKernel Kernel;
+		AddHinges(Kernel, Mesh);
+		float const Error = Kernel.CompareWithConditions(&Mesh, DerivativeError);
+		Check(TEXT("Bend kernel"), Error, DerivativeError);
+	}
+	return true;
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include "ModifiedCGSolver.h"
 
 #include <RenderingThread.h>
+#include <Async/Async.h>
 #include <RenderResource.h>
 
 #include <PrimitiveViewRelevance.h>
@@ -23,6 +24,8 @@
 
 #include "FRTClothSystem_ImplicitIntegration_CPU.h"
 #include "FRTClothSystem_Leapfrog_CPU.h"
+#include "FRTClothSystem_ProjectiveDynamics_CPU.h"
+#include "FRTClothSystem_XPBD_CPU.h"
 #include "FRTClothSystemGPUBase.h"
 #include "FRTClothSystem_Verlet_CPU.h"
 #include "Components/BoxComponent.h"
@@ -238,6 +241,11 @@ URTClothMeshComponent::URTClothMeshComponent(const FObjectInitializer& ObjectIni
 
 void URTClothMeshComponent::OnRegister()
 {
+	// the cloth is rebuilt below
+	WaitForSimulation();
+	SimulationTask.Reset();
+	PendingTime = 0;
+	GameTime = 0;
 	Super::OnRegister();
 	// Get Original Mesh Data and Materials
 	TArray<UStaticMeshComponent*> Components;
@@ -269,9 +277,34 @@ void URTClothMeshComponent::OnRegister()
 			switch(PlainEnum)
 			{
 				case CPU_Verlet:ClothSystem = std::make_unique<FRTClothSystem_Verlet_CPU>(); break;
-				case CPU_Implicit:ClothSystem = std::make_unique<FRTClothSystem_ImplicitIntegration_CPU>(std::make_shared<FModifiedCGSolver>()); break;
+				case CPU_Implicit:
+				{
+					auto Implicit = std::make_unique<FRTClothSystem_ImplicitIntegration_CPU>(std::make_shared<FModifiedCGSolver>());
+					Implicit->SetHessianReuse({HessianRefreshInterval, HessianRefreshStrain, HessianBroydenUpdate});
+					Implicit->SetNewton({NewtonIterations, NewtonTolerance, NewtonLineSearchSteps});
+					Implicit->SetDomainDecomposition({Subdomains, SubdomainSweeps});
+					Implicit->SetQuadraticBend(QuadraticBend);
+					Implicit->SetCorotationalMembrane(CorotationalMembrane);
+					ClothSystem = std::move(Implicit);
+					break;
+				}
 				case CPU_Leapfrog:ClothSystem = std::make_unique<FRTClothSystem_Leapfrog_CPU>(); break;
 				case GPU_Verlet:ClothSystem = std::make_unique<FRTClothSystemGPUBase>(); break;
+				case CPU_ProjectiveDynamics:
+				{
+					auto Projective = std::make_unique<FRTClothSystem_ProjectiveDynamics_CPU>();
+					Projective->SetIterations(SolverIterations);
+					Projective->SetChebyshev(ChebyshevAcceleration, ChebyshevSpectralRadius);
+					ClothSystem = std::move(Projective);
+					break;
+				}
+				case CPU_XPBD:
+				{
+					auto XPBD = std::make_unique<FRTClothSystem_XPBD_CPU>();
+					XPBD->SetIterations(SolverIterations);
+					ClothSystem = std::move(XPBD);
+					break;
+				}
 				default:ClothSystem = std::make_unique<FRTClothSystem_Verlet_CPU>();
 			}
 
@@ -286,6 +319,10 @@ void URTClothMeshComponent::OnRegister()
 			}
 			ClothSystem->SetGravity({0, 0, -100});
 			ClothSystem->SetWind(WindVelocity);
+			if (ScatterMode != ScatterFastest)
+			{
+				ClothSystem->SetScatterMode(ScatterMode == ScatterColoring ? ERTScatterMode::Coloring : ERTScatterMode::PrivateBuffers);
+			}
 			 
 			ClothSystem->Init(ClothMesh,
 				{
@@ -293,9 +330,32 @@ void URTClothMeshComponent::OnRegister()
 					K_Stretch, D_Stretch,
 					K_Shear, D_Shear,
 					Rest_U, Rest_V, Density, InitTheta / 180 * PI
-					,K_Collision,D_Collision, AirFriction, EnableCollision, EnableInnerCollision}
+					,K_Collision,D_Collision, AirFriction, EnableCollision, EnableInnerCollision
+					,MinStretch, MaxStretch, StrainLimitIterations}
 				);
-			ClothSystem->UpdateTransform(ClothMesh->LocalToWorld, 0.005);
+			ClothSystem->UpdateTransform(ClothMesh->LocalToWorld, FixedTimeStep);
+			ClothSystem->EndFrame();
+			ClothSystem->SetRenderSmoothing(
+				RenderSmoothing == RenderInterpolate ? ERTRenderSmoothing::Interpolate :
+				RenderSmoothing == RenderExtrapolate ? ERTRenderSmoothing::Extrapolate : ERTRenderSmoothing::None,
+				MaxExtrapolation);
+			ClothSystem->PublishPositions(GameTime);
+			PreviousTransform = ClothMesh->LocalToWorld;
+			TimeAccumulator = 0;
+			CurrentTimeStep = FixedTimeStep;
+			// the GPU Verlet pass has no previous step, a change of step would change the velocity
+			bAdaptive = AdaptiveTimeStep && PlainEnum != GPU_Verlet;
+			if (AdaptiveTimeStep && !bAdaptive)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Adaptive Time Step is not supported by GPU Verlet, using Fixed Time Step"));
+			}
+			ClothSystem->SetMeasureSteps(bAdaptive);
+			ClothSystem->SetSleep(SleepSpeed, EnableSleep ? SleepFrames : 0);
+			// the GPU solver runs its passes on the render thread
+			bAsync = AsyncSimulation && PlainEnum != GPU_Verlet;
+			// projective dynamics factors its system again on every change of the step, keep the changes to powers of two
+			StepController.SetParams({MinTimeStep, FMath::Max(MinTimeStep, MaxTimeStep), MaxStrainChange, MaxMotion, MaxPenetration, 1.25f,
+				PlainEnum == CPU_ProjectiveDynamics});
 			// add a hit box that wrap the cloth to perform collision from UE4 objects
 			if (EnableCollision)
 			{
@@ -331,6 +391,7 @@ void URTClothMeshComponent::OnRegister()
 
 void URTClothMeshComponent::OnUnregister()
 {
+	WaitForSimulation();
 	Super::OnUnregister();
 }
 
@@ -346,6 +407,7 @@ void URTClothMeshComponent::OnOverLapBegin(UPrimitiveComponent* OverlappedCompon
 	if (Comps.Num()>0) return;
 	if (OverlappedComponent == HitBox && ClothSystem && EnableCollision)
 	{
+		WaitForSimulation();
 		FCollisionShape const CollisionShape = OtherComp->GetCollisionShape();
 		FVector V = OtherActor->GetVelocity();
 		float A = 0, B = 0, C = 0;
@@ -390,6 +452,7 @@ void URTClothMeshComponent::OnOverLapEnd(UPrimitiveComponent* OverlappedComponen
 	if (Comps.Num()>0) return;
 	if (OverlappedComponent == HitBox && ClothSystem && EnableCollision)
 	{
+		WaitForSimulation();
 		ClothSystem->RemoveCollider(OtherComp);
 	}
 }
@@ -430,6 +493,19 @@ bool URTClothMeshComponent::SetupCloth_CPU(UStaticMesh *Mesh) const
 			ClothMesh->TangentZArray.Add(SVB.VertexTangentZ(i));
 			ClothMesh->Colors.Add(FColor::Cyan);
 		}
+		// painted stiffness and damping
+		auto const& CVB = LODResource.VertexBuffers.ColorVertexBuffer;
+		if (StiffnessFromVertexColor && CVB.GetNumVertices() == NumVertex)
+		{
+			ClothMesh->StiffnessScale.Reserve(NumVertex);
+			ClothMesh->DampingScale.Reserve(NumVertex);
+			for (uint32 i = 0; i < NumVertex; i ++)
+			{
+				FColor const& Color = CVB.VertexColor(i);
+				ClothMesh->StiffnessScale.Add(FMath::Lerp(StiffnessMapMin, StiffnessMapMax, Color.R / 255.f));
+				ClothMesh->DampingScale.Add(FMath::Lerp(DampingMapMin, DampingMapMax, Color.G / 255.f));
+			}
+		}
 		// get index data;
 		auto const &IBData = IB.GetArrayView();
 		auto const NumIndices = IB.GetNumIndices();
@@ -556,27 +632,127 @@ void URTClothMeshComponent::TickComponent(float DeltaTime, enum ELevelTick TickT
 	GetOwner()->GetComponents<UStaticMeshComponent>(Components);
 	if (Components.Num() > 0 && ClothMesh != nullptr)
 	{
+		GameTime += DeltaTime;
+		// smoothing draws every tick, between or past the simulated frames
+		bool const bSmoothing = RenderSmoothing != RenderLatest;
+		if (bAsync && SimulationTask.IsValid())
+		{
+			if (!SimulationTask.IsReady())
+			{
+				// keep showing the last finished frame, this time is simulated with the next frame
+				PendingTime += DeltaTime;
+				if (bSmoothing)
+				{
+					MarkRenderDynamicDataDirty();
+				}
+				return;
+			}
+			// the frame in flight is done, show it
+			SimulationTask.Reset();
+			UpdateHitBox();
+			MarkRenderDynamicDataDirty();
+		}
 		auto Transform = Components[0]->GetComponentTransform();
-		ENQUEUE_RENDER_COMMAND(URTClothMeshComponentTick)(
-		[this, Transform, DeltaTime](FRHICommandListImmediate &CmdList)
+		ClothSystem->SetWind(WindVelocity);
+		// asleep until an input changes, nothing to simulate or upload
+		if (ClothSystem->CheckSleep(!Transform.Equals(PreviousTransform)))
 		{
-			ClothSystem->UpdateTransform(Transform, DeltaTime);
-			ClothSystem->TickOnce(0.005f);
-		});
-		FlushRenderingCommands();
-		if (HitBox)
+			PendingTime = 0;
+			return;
+		}
+		auto const FrameStartTransform = PreviousTransform;
+		float const FrameTime = DeltaTime + PendingTime;
+		PendingTime = 0;
+		PreviousTransform = Transform;
+		ClothSystem->CaptureColliders();
+		double const FrameEndTime = GameTime;
+		if (bAsync)
 		{
-			HitBox->SetRelativeLocation((ClothSystem->BoundingBoxMax() + ClothSystem->BoundingBoxMin()) / 2);
-			HitBox->SetBoxExtent((ClothSystem->BoundingBoxMax() - ClothSystem->BoundingBoxMin()) / 2);// Need to send new data to render thread
+			SimulationTask = Async(EAsyncExecution::ThreadPool, [this, FrameStartTransform, Transform, FrameTime, FrameEndTime]()
+			{
+				SimulateFrame(FrameStartTransform, Transform, FrameTime, FrameEndTime);
+			});
+			if (bSmoothing)
+			{
+				MarkRenderDynamicDataDirty();
+			}
+		}
+		else
+		{
+			ENQUEUE_RENDER_COMMAND(URTClothMeshComponentTick)(
+			[this, FrameStartTransform, Transform, FrameTime, FrameEndTime](FRHICommandListImmediate &CmdList)
+			{
+				SimulateFrame(FrameStartTransform, Transform, FrameTime, FrameEndTime);
+			});
+			FlushRenderingCommands();
+			UpdateHitBox();
+			MarkRenderDynamicDataDirty();
 		}
-		MarkRenderDynamicDataDirty();
 		UpdateComponentToWorld();
 	}
 }
 
+void URTClothMeshComponent::SimulateFrame(FTransform const& FrameStartTransform, FTransform const& Transform, float DeltaTime, double FrameEndTime)
+{
+	// run the whole steps of the time since the last frame, the remainder is carried to the next frame
+	TimeAccumulator += DeltaTime;
+	bool const bStepped = TimeAccumulator >= CurrentTimeStep;
+	for (int32 NumOfSteps = 1; TimeAccumulator >= CurrentTimeStep; NumOfSteps ++)
+	{
+		float const Step = CurrentTimeStep;
+		TimeAccumulator -= Step;
+		// the last substep allowed catches up with the frame and the rest is dropped,
+		// a step shrunk by the controller below must not run more substeps on the rest
+		bool const bLastStep = NumOfSteps >= MaxSubSteps;
+		if (bLastStep)
+		{
+			TimeAccumulator = 0;
+		}
+		// cloth and collider transforms at the end of the substep
+		float const Alpha = DeltaTime > 0 ? FMath::Clamp(1.f - TimeAccumulator / DeltaTime, 0.f, 1.f) : 1.f;
+		FTransform SubStepTransform;
+		SubStepTransform.Blend(FrameStartTransform, Transform, Alpha);
+		ClothSystem->UpdateTransform(SubStepTransform, Step, Alpha);
+		ClothSystem->TickOnce(Step);
+		if (bAdaptive)
+		{
+			CurrentTimeStep = StepController.NextStep(ClothSystem->MeasureLastStep(), Step);
+		}
+		if (bLastStep)
+		{
+			break;
+		}
+	}
+	ClothSystem->EndFrame();
+	// the positions lag the frame by the time left over, frames without substeps publish nothing new
+	if (bStepped)
+	{
+		ClothSystem->PublishPositions(FrameEndTime - TimeAccumulator);
+	}
+}
+
+void URTClothMeshComponent::WaitForSimulation()
+{
+	if (SimulationTask.IsValid())
+	{
+		SimulationTask.Wait();
+	}
+}
+
+void URTClothMeshComponent::UpdateHitBox()
+{
+	if (HitBox)
+	{
+		HitBox->SetRelativeLocation((ClothSystem->BoundingBoxMax() + ClothSystem->BoundingBoxMin()) / 2);
+		HitBox->SetBoxExtent((ClothSystem->BoundingBoxMax() - ClothSystem->BoundingBoxMin()) / 2);// Need to send new data to render thread
+	}
+}
+
 // override scene proxy
 FPrimitiveSceneProxy *URTClothMeshComponent::CreateSceneProxy()
 {
+	// the proxy copies the positions of the mesh
+	WaitForSimulation();
 	return new FClothMeshSceneProxy(this, ClothMesh);
 }
 
@@ -601,13 +777,14 @@ void URTClothMeshComponent::SendRenderDynamicData_Concurrent()
 {
 	if (SceneProxy)
 	{
+		double const DisplayTime = GameTime + DisplayLatency;
 		ENQUEUE_RENDER_COMMAND(URTClothMeshComponentUpdate)(
-			[this](FRHICommandListImmediate &CmdList)
+			[this, DisplayTime](FRHICommandListImmediate &CmdList)
 			{
 				auto const ProcProxy = static_cast<FClothMeshSceneProxy *>(SceneProxy);
 				if (ProcProxy &&ProcProxy->PositionBuffer().VertexBufferRHI.IsValid())
 				{
-					ClothSystem->UpdatePositionDataTo(CmdList, ProcProxy->PositionBuffer());
+					ClothSystem->UpdatePositionDataTo(CmdList, ProcProxy->PositionBuffer(), DisplayTime);
 				}
 			}
 		);
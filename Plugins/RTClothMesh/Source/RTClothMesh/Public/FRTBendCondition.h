@@ -1,4 +1,4 @@
-#pragma once
+﻿#pragma once
 
 #include "FRTEnergyCondition.h"
 #include "RTClothStructures.h"
@@ -15,6 +15,11 @@ public:
 	virtual void UpdateCondition(
 		TArray<FVector> const& X, TArray<FVector> const& V,TArray<FVector2D> const& UV
 	) override;
+
+	virtual float Energy(float K) const override
+	{
+		return 0.5f * K * L * Theta * Theta;
+	}
 	
 	virtual void ComputeForces(
 		 float K, float D,
@@ -0,0 +1,103 @@
+﻿#pragma once
+
+#include "FRTBendCondition.h"
+#include "FRTPrivateForceBuffers.h"
+
+// Dihedral bend conditions of all hinges, stored in SoA form and evaluated 8 hinges per batch.
+// Hinge: triangles (X0, X1, X2) and (X3, X2, X1) sharing the edge X1 - X2, same as FRTBendCondition.
+// Evaluated in parallel, by hinge color or into private force buffers (see ERTScatterMode).
+// Without AVX2 the kernel falls back to FRTBendCondition.
+class FRTBendKernel
+{
+public:
+	FRTBendKernel();
+
+	void Reset(int32 NumOfHinges, float InitTheta);
+
+	// add one hinge, the rest length of the shared edge is taken from UV
+	void Add(uint32 V0, uint32 V1, uint32 V2, uint32 V3, TArray<FVector2D> const& UV);
+
+	// color the hinges and lay them out for evaluation, call once after all hinges are added
+	void Finalize(int32 NumOfVertices);
+
+	int32 Num() const {return NumOfHinges;}
+
+	// set stiffness and damping, and pick the variant that skips damping (and the velocity gather) when D is zero.
+	// call when the material changes
+	void SetParams(float InK, float InD);
+
+	// per vertex multipliers of K and D (painted maps), each hinge takes the mean of its shared edge.
+	// empty arrays reset the multipliers to 1, call after Finalize
+	void SetScaleMaps(TArray<float> const& VertexK, TArray<float> const& VertexD);
+
+	// use Pinned, or time the force pass on positions X under both scatter modes and keep the faster one
+	void SelectScatterMode(TArray<FVector> const& X, TArray<FVector2D> const& UV, TOptional<ERTScatterMode> const& Pinned);
+
+	// Forces += bend forces and damping forces
+	void ComputeForces(
+		TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector2D> const& UV,
+		TArray<FVector> &Forces);
+
+	// Forces += bend forces and damping forces, and add up Hessians for the implicit integrator.
+	// Damping blocks are not touched when D is zero. Runs in parallel only when the patterns of the matrices are locked
+	void ComputeForcesAndDerivatives(
+		TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector2D> const& UV,
+		TArray<FVector> &Forces,
+		FRTBBSSMatrix<float> &dfdx,
+		FRTBBSSMatrix<float> &dddx,
+		FRTBBSSMatrix<float> &dddv);
+
+	// elastic energy K * L / 2 * theta^2 of the last force pass, the passes store it per hinge on the way
+	float LastEnergy() const;
+
+	// check both variants on a deformed state of the mesh: forces and energy against FRTBendCondition with the material of each hinge,
+	// dfdx against central differences,
+	// returns max force/energy difference relative to the largest value, the derivative one goes to DerivativeError.
+	// params are restored afterwards
+	float CompareWithConditions(FClothRawMesh *Mesh, float &DerivativeError);
+
+private:
+	template <bool bDamping>
+	void Compute(
+		TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector2D> const& UV,
+		TArray<FVector> &Forces,
+		FRTBBSSMatrix<float> *dfdx,
+		FRTBBSSMatrix<float> *dddx,
+		FRTBBSSMatrix<float> *dddv);
+
+	// vertex indices in the order of Add, sorted by color in Finalize,
+	// then each color is padded to a multiple of 8 by repeating its last hinge
+	TArray<int32> I0, I1, I2, I3;
+	// length of the shared edge in uv space
+	TArray<float> L;
+	// multipliers of K and D, 1 without maps, always applied
+	TArray<float> KScale, DScale;
+	// [ColorOffsets[c], ColorOffsets[c + 1]) are the hinges of color c, including padding
+	TArray<int32> ColorOffsets;
+	// number of real hinges in each batch of 8
+	TArray<uint8> BatchValid;
+	int32 NumOfHinges = 0;
+	float Theta_0 = 0;
+
+	// energy of each hinge (or condition), written by the force passes, padded lanes included
+	TArray<float> HingeEnergy;
+
+	// used when avx2 is not supported, sorted by color, without padding
+	TArray<FRTBendCondition> Conditions;
+	TArray<int32> ConditionOffsets;
+	// hinge of each condition
+	TArray<int32> ConditionHinges;
+
+	// hinges per parallel task, a multiple of 8
+	static constexpr int32 ChunkSize = 256;
+
+	ERTScatterMode ScatterMode = ERTScatterMode::Coloring;
+	FRTPrivateForceBuffers PrivateBuffers;
+
+	// active variant, selected by SetParams
+	float K = 0, D = 0;
+	typedef void (FRTBendKernel::*FComputePass)(
+		TArray<FVector> const&, TArray<FVector> const&, TArray<FVector2D> const&, TArray<FVector>&,
+		FRTBBSSMatrix<float>*, FRTBBSSMatrix<float>*, FRTBBSSMatrix<float>*);
+	FComputePass ComputePass = nullptr;
+};
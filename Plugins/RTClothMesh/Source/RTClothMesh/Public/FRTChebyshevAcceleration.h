@@ -0,0 +1,61 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+// Chebyshev semi-iterative acceleration (Wang 2015) of a fixed point iteration X_{k+1} = G(X_k),
+// such as the local / global loop of projective dynamics or a Jacobi relaxation:
+// X_{k+1} = Omega_{k+1} * (Gamma * (G(X_k) - X_k) + X_k - X_{k-1}) + X_{k-1},
+// Omega_1 = 1, Omega_2 = 2 / (2 - Rho^2), Omega_{k+1} = 4 / (4 - Rho^2 * Omega_k), Rho is the spectral radius of G.
+// Without a given Rho the first solves run plain and estimate it from the decay of |X_{k+1} - X_k|.
+// An iteration whose change grows restarts the recurrence. Vertices are updated in parallel.
+// After a small change of the system (Refine) the estimate is kept and lowered on the restarts of the next solves.
+class FRTChebyshevAcceleration
+{
+public:
+	// InRho <= 0 estimates Rho over WarmUpSolves solves, plain iterations before Delay are not accelerated
+	void SetParams(float InRho, float InGamma, int32 InDelay, int32 InWarmUpSolves);
+
+	// forget the estimated Rho, call when the system changes
+	void Reset();
+
+	// keep accelerating with the estimated Rho and refine it over the next WarmUpSolves solves,
+	// call when the system changed a little, such as a new step
+	void Refine();
+
+	// call with the first iterate of a solve
+	void BeginSolve(TArray<FVector> const& X);
+
+	// call with each new iterate G(X_k), replaced by the accelerated one
+	void Iterate(TArray<FVector> &X);
+
+	// call after the last iteration of a solve
+	void EndSolve();
+
+	bool IsWarmingUp() const {return GivenRho <= 0 && NumOfWarmUps < WarmUpSolves;}
+
+	float SpectralRadius() const {return GivenRho > 0 ? GivenRho : EstimatedRho;}
+
+private:
+	// X_k and X_{k-1}
+	TArray<FVector> Current, Previous;
+	int32 Iteration = 0;
+	float Omega = 1;
+
+	// squared changes of the current solve
+	TArray<double> Changes;
+
+	float GivenRho = 0;
+	float Gamma = 1;
+	int32 Delay = 2;
+	int32 WarmUpSolves = 10;
+	int32 NumOfWarmUps = 0;
+	float EstimatedRho = 0;
+	// solves left to refine the estimate in, and if it was lowered in the current one
+	int32 NumOfRefines = 0;
+	bool bLowered = false;
+
+	// vertices per parallel task
+	static constexpr int32 ChunkSize = 1024;
+	// step of the estimate on a restart while refining
+	static constexpr float RefineScale = 0.98f;
+};
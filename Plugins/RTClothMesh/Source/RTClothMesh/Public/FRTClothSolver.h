@@ -11,10 +11,21 @@ public:
 	IRTLinearSolver(Real Tol, uint32 MaxItNums) : Tolerance(Tol), MaxIterations(MaxItNums) {}
 	virtual void Init(FRTBBSSMatrix<Real> const&) = 0;
 	virtual void Solve(FRTBBSSMatrix<Real> & A, TArray<Real> const& B, TArray<Real> &X) = 0;
-	virtual void UpdateConstraints(TArray<uint32> const&Ids, TArray<FRTMatrix<Real, 3,3>> const& Mats) = 0;
+	virtual void UpdateConstraints(TArray<int32> const&Ids, TArray<FRTMatrix<Real, 3,3>> const& Mats) = 0;
 	virtual void UpdateVelocityConstraints(FVector const&Vel) = 0;
+	// independent blocks of the matrix, [Offsets[i], Offsets[i + 1]) of Vertices are the vertices of island i.
+	// solvers may solve the islands separately, empty arrays are one island
+	virtual void SetIslands(TArray<int32> const& Offsets, TArray<int32> const& Vertices) {}
+	// islands left out of Solve, their X is not touched. nullptr solves all islands
+	virtual void SetSkippedIslands(TArray<uint8> const* Skipped) {}
+	// subdomain of each vertex for domain decomposition, solvers may precondition and run in parallel by subdomain.
+	// LocalSweeps sets the work of the local solves, empty arrays turn it off
+	virtual void SetSubdomains(TArray<int32> const& VertexSubdomains, int32 LocalSweeps) {}
 	virtual ~IRTLinearSolver() {}
+	// iterations used by the last Solve
+	uint32 LastIterations() const {return Iterations;}
 protected:
 	Real Tolerance;
 	uint32 MaxIterations;
+	uint32 Iterations = 0;
 };
\ No newline at end of file
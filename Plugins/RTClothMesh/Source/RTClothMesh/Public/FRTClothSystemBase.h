@@ -4,7 +4,10 @@
 
 #include <memory>
 
+#include "Containers/TripleBuffer.h"
+
 #include "FRTClothSolver.h"
+#include "FRTPrivateForceBuffers.h"
 #include "FRTDynamicVertexBuffer.h"
 #include "FBVHTree.h"
 
@@ -41,6 +44,56 @@ struct FRTClothPhysicalMaterial
 	Real AirFriction;
 	int EnableCollision;
 	int EnableInnerCollision;
+
+	// strain limiting after integration, principal stretches are clamped into [MinStretch, MaxStretch],
+	// a bound <= 0 is off
+	Real MinStretch;
+	Real MaxStretch;
+	int StrainLimitIterations;
+};
+
+// energies of a cloth system
+struct FRTClothEnergy
+{
+	float Stretch = 0;
+	float Shear = 0;
+	float Bend = 0;
+	float Kinetic = 0;
+
+	float Total() const {return Stretch + Shear + Bend + Kinetic;}
+};
+
+// motion of one tick, lengths are relative to the shortest rest edge of the mesh
+struct FRTStepMeasures
+{
+	// largest speed of a vertex, edges per second
+	float MotionRate = 0;
+	// largest rate of change of the stretch of an edge, per second
+	float StrainRate = 0;
+	// deepest penetration resolved by the collisions, in edges
+	float Penetration = 0;
+};
+
+// how UpdatePositionDataTo places the published frames at the display time
+enum class ERTRenderSmoothing : uint8
+{
+	// the latest frame as it is
+	None,
+	// blend the two latest frames, the cloth is drawn up to one frame behind the display time
+	Interpolate,
+	// move the latest frame along its velocities to the display time,
+	// or along the difference of the two latest frames for systems without velocities
+	Extrapolate
+};
+
+// a finished frame for the render thread
+struct FRTPositionSnapshot
+{
+	TArray<FVector> Positions;
+	// empty when the system keeps no velocities
+	TArray<FVector> Velocities;
+	// time of the positions, on the clock of the display time
+	double Time = 0;
 };
 
 class FRTClothSystemBase
@@ -58,35 +111,54 @@ public:
 
 	FORCEINLINE void SetGravity(FVector const&G)
 	{
+		bWakeUp |= !G.Equals(WorldSpaceGravity);
 		WorldSpaceGravity = G;
 	}
 
 	FORCEINLINE void SetWind(FVector const&Wind)
 	{
+		bWakeUp |= !Wind.Equals(WorldSpaceWindVelocity);
 		WorldSpaceWindVelocity = Wind;
 	}
 
 	void AddConstraint(uint32 Id, FClothConstraint const& Constraint)
 	{
 		Constraints.Add(Id, Constraint.ConstraintsMat());
+		bConstraintsChanged = true;
+		bWakeUp = true;
 	}
 	void RemoveConstraint(uint32 Id)
 	{
 		Constraints.Remove(Id);
+		bConstraintsChanged = true;
+		bWakeUp = true;
 	}
 
-	void UpdateCollider(UPrimitiveComponent *Com, FRTClothCollider const&Collider)
-	{
-		Colliders.FindOrAdd(Com) = Collider;
-	}
+	// add or update a collider, its current transform is captured as well
+	void UpdateCollider(UPrimitiveComponent *Com, FRTClothCollider const&Collider);
 
 	void RemoveCollider(UPrimitiveComponent *Com)
 	{
 		Colliders.Remove(Com);
+		ColliderFrameStart.Remove(Com);
+		ColliderFrameEnd.Remove(Com);
+		bWakeUp = true;
 	}
 
-	// update transform of Cloth to World
-	void UpdateTransform(FTransform const& ClothToWorld, float Duration);
+	// keep the current transforms of the colliders as the end of the next frame. Call on the game thread before the substeps,
+	// the substeps and EndFrame do not touch the components and may run on another thread
+	void CaptureColliders();
+
+	// update transform of Cloth to World, Duration is the time since the last update.
+	// colliders are blended from their transforms at the last EndFrame (ColliderAlpha = 0) to the current ones (1)
+	void UpdateTransform(FTransform const& ClothToWorld, float Duration, float ColliderAlpha = 1.f);
+
+	// keep the captured transforms of the colliders as the start of the next frame, call after the substeps of a frame
+	void EndFrame();
+
+	// publish the positions and velocities for UpdatePositionDataTo, call after EndFrame of a frame that ran substeps.
+	// Time is the time of the positions on the clock of the display time
+	void PublishPositions(double Time);
 	
 
 	// update material
@@ -106,13 +178,57 @@ public:
 	// simulate for one tick
 	virtual void TickOnce(float Duration);
 
-	// update data into DstBuffer
-	virtual void UpdatePositionDataTo(FRHICommandList &CmdList, FRTDynamicVertexBuffer &DstBuffer);
+	// keep the positions at the start of each tick and track collision depths for MeasureLastStep
+	void SetMeasureSteps(bool bEnable) {bMeasureSteps = bEnable;}
+
+	// motion of the last tick, one pass over the vertices and the edges. zero when measuring is off
+	FRTStepMeasures MeasureLastStep() const;
+
+	// each island falls asleep when its rms speed stays below Speed for Frames frames with unchanged inputs,
+	// the cloth sleeps when all islands do. Frames <= 0 keeps it awake. Needs CurrentVelocities, GPU systems never sleep
+	void SetSleep(float Speed, int32 Frames);
+
+	// wake up when bTransformChanged, the gravity, wind, constraints or material changed,
+	// or a collider was added, removed or moved since the last EndFrame.
+	// returns true while asleep, the frame is not simulated or uploaded then
+	bool CheckSleep(bool bTransformChanged);
+
+	bool IsSleeping() const {return bSleeping;}
+
+	// Extrapolate moves at most MaxExtrapolation seconds past the latest frame. Call before the first frame is published
+	void SetRenderSmoothing(ERTRenderSmoothing Mode, float MaxExtrapolation)
+	{
+		RenderSmoothing = Mode;
+		MaxExtrapolationTime = MaxExtrapolation;
+	}
+
+	// scatter mode of the parallel CPU force passes, unset times both modes on the mesh. Call before Init
+	void SetScatterMode(TOptional<ERTScatterMode> Mode) {PinnedScatterMode = Mode;}
+
+	// update data into DstBuffer at DisplayTime from the frames published by PublishPositions, see ERTRenderSmoothing.
+	// never waits for a frame in flight on another thread
+	virtual void UpdatePositionDataTo(FRHICommandList &CmdList, FRTDynamicVertexBuffer &DstBuffer, double DisplayTime);
+
+	// elastic energies at the last force evaluation and the current kinetic energy,
+	// taken from the per element values of the force passes, no extra pass over the mesh
+	virtual FRTClothEnergy Energy() const {return {};}
 	
 protected:
 
 	// setup runtime variables, before tick
 	virtual void PrepareSimulation() = 0;
+
+	// 1 / 2 * m * v^2 over all vertices
+	float KineticEnergy(TArray<FVector> const& Velocities) const;
+
+	// velocities of the vertices for sleeping, nullptr when they are not on the CPU
+	virtual TArray<FVector> const* CurrentVelocities() const {return nullptr;}
+
+	// CurrentVelocities times this is dX/dt over the last step, for systems that store another difference
+	virtual float CurrentVelocityScale() const {return 1.f;}
+
+	// called by UpdateMaterial after M_Material is replaced
+	virtual void MaterialUpdated() {}
 	
 	// Directed Edge Structure
 	typedef unsigned int HalfEdgeRef;
@@ -202,11 +318,41 @@ protected:
 	std::shared_ptr<FClothRawMesh> Mesh;
 	
 	TArray<float> Masses;
+	// 1 / Masses, 0 for vertices without faces
+	TArray<float> InverseMasses;
 
 	// Constraints
 	TMap<uint32, FRTMatrix3> Constraints;
 
+	// dense copy of Constraints for the per vertex loops, rebuilt by TickOnce after constraints change.
+	// ConstraintIndex of each vertex is its index into ConstrainedVertices and ConstraintMats, INDEX_NONE when free
+	TArray<int32> ConstraintIndex;
+	TArray<int32> ConstrainedVertices;
+	TArray<FRTMatrix3> ConstraintMats;
+	bool bConstraintsChanged = true;
+
+	void UpdateConstraintIndex();
+
+	FORCEINLINE FRTMatrix3 const* FindConstraint(int32 Id) const
+	{
+		int32 const Index = ConstraintIndex[Id];
+		return Index != INDEX_NONE ? &ConstraintMats[Index] : nullptr;
+	}
+
 	TMap<UPrimitiveComponent *, FRTClothCollider> Colliders;
+	// collider to world at the last EndFrame
+	TMap<UPrimitiveComponent *, FTransform> ColliderFrameStart;
+	// collider to world at CaptureColliders
+	TMap<UPrimitiveComponent *, FTransform> ColliderFrameEnd;
+
+	// finished frames, written by PublishPositions on the simulating thread and read on the render thread
+	TTripleBuffer<FRTPositionSnapshot> PositionSnapshots;
+	// the frame before the latest one, kept by the render thread
+	FRTPositionSnapshot PreviousSnapshot;
+	ERTRenderSmoothing RenderSmoothing = ERTRenderSmoothing::None;
+	float MaxExtrapolationTime = 0.05f;
+
+	TOptional<ERTScatterMode> PinnedScatterMode;
 
 	// Gravity
 	FVector WorldSpaceGravity = {0, 0, 0};
@@ -231,6 +377,43 @@ protected:
 	};
 	TArray<FHitSphere> TriangleBoundingSpheres;
 
+	// step measures, see SetMeasureSteps
+	bool bMeasureSteps = false;
+	TArray<FVector> StepStartPositions;
+	float StepDuration = 0;
+	// deepest collision of the current tick, in cm
+	float StepPenetration = 0;
+	// both vertices of each edge
+	TArray<uint32> EdgeVertices;
+
+	// islands: connected pieces of the mesh, built from the half edges before PrepareSimulation.
+	// [IslandOffsets[i], IslandOffsets[i + 1]) of IslandVertices are the vertices of island i
+	TArray<int32> VertexIslands;
+	TArray<int32> IslandOffsets;
+	TArray<int32> IslandVertices;
+
+	int32 NumOfIslands() const {return IslandOffsets.Num() - 1;}
+
+	// sleeping, see SetSleep
+	float SleepSpeed = 0;
+	int32 SleepFrames = 0;
+	bool bSleeping = false;
+	// per island, asleep islands may be skipped by the systems
+	TArray<uint8> IslandAsleep;
+	TArray<int32> IslandQuietFrames;
+	bool bAnyIslandAsleep = false;
+	// an input changed since the last CheckSleep
+	bool bWakeUp = false;
+
+	void BuildIslands();
+
+	// wake all islands
+	void WakeIslands();
+
+	// update the sleep states at the end of a frame,
+	// an asleep island is woken when the bounds of an awake island touch it
+	void UpdateIslandSleep(TArray<FVector> const& Velocities);
+
 	// update Mesh, rebuild Conditions
 	void _UpdateMesh(std::shared_ptr<FClothRawMesh> const&);
 
@@ -123,7 +123,7 @@ public:
 	virtual void TickOnce(float Duration) override;
 
 	// update data into DstBuffer
-	// virtual void UpdatePositionDataTo(FRHICommandList &CmdList, FRTDynamicVertexBuffer &DstBuffer) override;
+	// virtual void UpdatePositionDataTo(FRHICommandList &CmdList, FRTDynamicVertexBuffer &DstBuffer, double DisplayTime) override;
 	
 protected:
 	void SetupExternalForces_RenderThread();
@@ -3,13 +3,52 @@
 #include "FRTClothSystemBase.h"
 
 #include "Math/FRTSparseMatrix.h"
-#include "FRTShearCondition.h"
-#include "FRTStretchCondition.h"
-#include "FRTBendCondition.h"
+#include "FRTBendKernel.h"
+#include "FRTCorotationalKernel.h"
+#include "FRTQuadraticBendKernel.h"
+#include "FRTStretchShearKernel.h"
+#include "FRTStrainLimiter.h"
 
 #include <memory>
 #include "FRTClothSolver.h"
 
+// reuse of Df_Dx and Df_Dv across steps, forces are computed every step
+struct FRTHessianReuseSettings
+{
+	// refresh the derivatives at least every RefreshInterval steps, 1 refreshes every step
+	int32 RefreshInterval = 1;
+	// refresh early when the membrane strain (or the rotation, for the co-rotational membrane)
+	// changed more than this since the last refresh
+	float StrainThreshold = 0.05f;
+	// sparse Broyden updates of Df_Dx from the force changes between refreshes
+	bool bBroydenUpdate = false;
+};
+
+// Newton iterations on the backward Euler step M (V - V_n) = h * f(X_n + h * V, V).
+// The first iteration is the linearized solve, each further iteration evaluates forces and derivatives at the iterate again.
+// Steps are halved until the incremental potential 1 / 2 * |V - V_n|^2_M + U(X_n + h * V) does not grow,
+// U is the elastic energy and gravity, damping is not part of it
+struct FRTNewtonSettings
+{
+	// 1 is the single linearized solve
+	int32 MaxIterations = 1;
+	// stop when the largest velocity change of an iteration is below this
+	float Tolerance = 0.1f;
+	// halvings of the step before the iterations stop
+	int32 MaxLineSearchSteps = 5;
+};
+
+// Domain decomposition of the linear solve for large meshes: the vertices are partitioned into subdomains
+// on the half edge graph, the solver preconditions each subdomain on its own and runs them in parallel
+struct FRTDomainDecompositionSettings
+{
+	// 1 keeps the whole mesh (each island) as one domain
+	int32 NumOfSubdomains = 1;
+	// symmetric Gauss-Seidel sweeps of the local solve in each subdomain, 0 keeps the diagonal preconditioner
+	// and only runs the subdomains in parallel
+	int32 LocalSweeps = 1;
+};
+
 class FRTClothSystem_ImplicitIntegration_CPU : public FRTClothSystemBase
 {
 public:
@@ -17,25 +56,83 @@ public:
 		: Solver(ASolver) {}
 
 	virtual void TickOnce(float Duration) override;
+
+	virtual FRTClothEnergy Energy() const override;
+
+	void SetHessianReuse(FRTHessianReuseSettings const& Settings) {HessianReuse = Settings;}
+
+	void SetNewton(FRTNewtonSettings const& Settings) {Newton = Settings;}
+
+	// call before PrepareSimulation
+	void SetDomainDecomposition(FRTDomainDecompositionSettings const& Settings) {DomainDecomposition = Settings;}
+
+	// use the quadratic bend model with a constant Hessian instead of the dihedral bend, call before PrepareSimulation
+	void SetQuadraticBend(bool bEnable) {bQuadraticBend = bEnable;}
+
+	// use the co-rotational FEM membrane instead of the stretch and shear conditions, call before PrepareSimulation
+	void SetCorotationalMembrane(bool bEnable) {bCorotational = bEnable;}
 	
 private:
+	// velocities for sleeping
+	virtual TArray<FVector> const* CurrentVelocities() const override {return &Velocity;}
+
 	// calculate forces and derivatives
 	void ForcesAndDerivatives();
 
+	// calculate forces only, keep the last derivatives
+	void ForcesOnly();
+
+	// true if the derivatives are too old or the cloth deformed too much since they were computed
+	bool ShouldRefreshDerivatives();
+
+	// measure the secant error of the kept Df_Dx on the last step, and apply the Broyden update if enabled
+	void UpdateReusedDerivatives();
+
+	// remember positions, velocities and forces of this step for the next secant
+	void SaveSecantState();
+
+	// write the constant quadratic bend derivatives into BakedDf_Dx and BakedDf_Dv
+	void BakeQuadraticBend();
+
+	// A = M - dfdx * dt * dt - dfdv * dt from the current derivatives
+	void AssembleSystemMatrix(float Duration);
+
+	// spring forces of inner collisions, when enabled
+	void AddInnerCollisionForces();
+
+	// Newton iterations after the first solve, from StartPositions and StartVelocity
+	void NewtonIterations(float Duration);
+
+	// incremental potential of the current iterate, from the energies of the last force pass
+	float NewtonMerit(float Duration) const;
+
 	// setup runtime variables
 	virtual void PrepareSimulation() override;
 
+	// pick kernel variants for the active terms of the material
+	virtual void MaterialUpdated() override;
+
 	// TODO : solve inner collision
 
 	// pre computed conditions cache
-	TArray<FRTStretchCondition> StretchConditions;
-	TArray<FRTShearCondition> ShearConditions;
-	TArray<FRTBendCondition> BendConditions;
+	FRTStretchShearKernel StretchShearKernel;
+	FRTCorotationalKernel CorotationalKernel;
+	bool bCorotational = false;
+	FRTBendKernel BendKernel;
+	FRTQuadraticBendKernel QuadraticBendKernel;
+	bool bQuadraticBend = false;
+
+	// clamps the membrane stretch after integration
+	FRTStrainLimiter StrainLimiter;
 
 	// forces and derivatives
 	TArray<FVector> Forces;
 	FRTBBSSMatrix<float> Df_Dx;
 	FRTBBSSMatrix<float> Df_Dv;
+	// constant part of the derivatives (quadratic bend), the starting values of Df_Dx and Df_Dv at each refresh
+	FRTBBSSMatrix<float> BakedDf_Dx;
+	FRTBBSSMatrix<float> BakedDf_Dv;
+	bool bBaked = false;
 
 	// For solvers x = A/B
 	FRTBBSSMatrix<float> A;
@@ -47,4 +144,28 @@ private:
 
 	// check if it's fist frame of the incoming mesh
 	bool IsFirstFrame = false;
+
+	// Newton iterations
+	FRTNewtonSettings Newton;
+	// X_n and V_n of the step
+	TArray<FVector> StartPositions;
+	TArray<FVector> StartVelocity;
+	// direction and start velocity of the line search
+	TArray<float> NewtonStep;
+	TArray<FVector> SearchVelocity;
+
+	// subdomains of the solver
+	FRTDomainDecompositionSettings DomainDecomposition;
+
+	// derivative reuse
+	FRTHessianReuseSettings HessianReuse;
+	int32 StepsSinceRefresh = 0;
+	bool bRefreshedThisStep = true;
+	// positions where the derivatives were computed
+	TArray<FVector> RefreshPositions;
+	// state of the previous step
+	TArray<FVector> PrevPositions;
+	TArray<FVector> PrevVelocity;
+	TArray<FVector> PrevForces;
+	TArray<float> SecantS, SecantY, SecantJS;
 };
\ No newline at end of file
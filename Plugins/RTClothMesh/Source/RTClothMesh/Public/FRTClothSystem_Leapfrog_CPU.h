@@ -2,9 +2,10 @@
 
 #include "FRTClothSystemBase.h"
 
-#include "FRTShearCondition.h"
-#include "FRTStretchCondition.h"
-#include "FRTBendCondition.h"
+#include "FRTBendKernel.h"
+#include "FRTStretchShearKernel.h"
+#include "FRTStrainLimiter.h"
+#include "FRTExplicitIntegrator.h"
 
 // LeafFrog Integration
 // V_{i + 1/2} = V[i] + Acc[i] * h / 2
@@ -17,20 +18,33 @@ public:
 	explicit FRTClothSystem_Leapfrog_CPU() = default;
 
 	virtual void TickOnce(float Duration) override;
+
+	virtual FRTClothEnergy Energy() const override;
 	
 private:
+	// velocities for sleeping
+	virtual TArray<FVector> const* CurrentVelocities() const override {return &Velocities;}
+
 	// calculate forces and derivatives
 	void Acceleration();
 
 	// setup runtime variables
 	virtual void PrepareSimulation() override;
 
+	// pick kernel variants for the active terms of the material
+	virtual void MaterialUpdated() override;
+
 	// TODO : solve inner collision
 
 	// pre computed conditions cache. use forces only
-	TArray<FRTStretchCondition> StretchConditions;
-	TArray<FRTShearCondition> ShearConditions;
-	TArray<FRTBendCondition> BendConditions;
+	FRTStretchShearKernel StretchShearKernel;
+	FRTBendKernel BendKernel;
+
+	// clamps the membrane stretch after integration
+	FRTStrainLimiter StrainLimiter;
+
+	// per vertex update, gravity and air friction are applied here
+	FRTExplicitIntegrator Integrator;
 
 	// Forces
 	TArray<FVector> Forces;
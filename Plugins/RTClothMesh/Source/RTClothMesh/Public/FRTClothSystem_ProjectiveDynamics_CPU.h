@@ -0,0 +1,124 @@
+﻿#pragma once
+
+#include "FRTClothSystemBase.h"
+
+#include "FRTEnvelopeCholesky.h"
+#include "FRTChebyshevAcceleration.h"
+
+// Projective Dynamics (Bouaziz et al. 2014)
+// E(X) = 1 / (2 h^2) |M^1/2 (X - S)|^2 + sum w / 2 |A X - P|^2, S = X + h * V + h^2 * M^-1 * F_ext,
+// each constraint projects A X onto its rest manifold (local step, P), then X is solved from the constant system
+// (M / h^2 + sum w A^T A) X = M / h^2 * S + sum w A^T P (global step), factored once by FRTEnvelopeCholesky.
+// Membrane: F = [wu / Rest_U, wv / Rest_V] is projected onto its rotation (as FRTCorotationalKernel),
+// the columns are weighted by K_Stretch * a^2 * Rest_U^2 and K_Stretch * a^2 * Rest_V^2.
+// Bend: the quadratic hinge of FRTQuadraticBendKernel, W^T X is projected onto its length in the rest shape.
+// Constrained vertices take an explicit step and are pinned during the solve.
+class FRTClothSystem_ProjectiveDynamics_CPU : public FRTClothSystemBase
+{
+public:
+	explicit FRTClothSystem_ProjectiveDynamics_CPU() = default;
+
+	virtual void TickOnce(float Duration) override;
+
+	virtual FRTClothEnergy Energy() const override;
+
+	// local / global iterations per tick
+	void SetIterations(int32 InIterations) {Iterations = FMath::Max(1, InIterations);}
+
+	// Chebyshev acceleration of the local / global iterations, Rho <= 0 estimates the spectral radius
+	// over the first ticks after the system is assembled and refines it when the step changes
+	void SetChebyshev(bool bEnable, float Rho = 0)
+	{
+		bChebyshev = bEnable;
+		Chebyshev.SetParams(Rho, 1.f, 2, 10);
+	}
+
+private:
+	// velocities for sleeping
+	virtual TArray<FVector> const* CurrentVelocities() const override {return &Velocities;}
+
+	// setup runtime variables
+	virtual void PrepareSimulation() override;
+
+	// weights depend on the material, the system is assembled again on the next tick
+	virtual void MaterialUpdated() override {bAssembled = false;}
+
+	// map free vertices to rows, order and size the factor and assemble sum w A^T A, which depends on the mesh,
+	// the pins and the material only. couplings of free and pinned vertices are kept to move them to the right hand side
+	void Assemble();
+
+	// add M / h^2 to the assembled matrix and factor it, numeric only
+	void Factorize(float Duration);
+
+	// true if the constrained vertices are not those of the last factorization
+	bool PinsChanged() const;
+
+	// projections of the constraints and their sum w A^T P into Rhs, per vertex.
+	// stores the energies of X on the way
+	void LocalStep(TArray<FVector> const& X);
+
+	struct FHinge
+	{
+		// vertices (V1, V2, V0, V3) and their weights, see FRTQuadraticBendKernel
+		int32 Idx[4];
+		float W[4];
+		// S * K_Bend, without the material
+		float S;
+		// |W^T X| of the rest shape
+		float RestNorm;
+	};
+
+	// triangles in color order, vertex indices
+	TArray<int32> I0, I1, I2;
+	// dF/dX1 and dF/dX2 as (u, v) weights, dF/dX0 = -dF/dX1 - dF/dX2
+	TArray<float> Gu1, Gu2, Gv1, Gv2;
+	// a^2 * Rest_U^2 and a^2 * Rest_V^2, weights of the columns of F per unit K
+	TArray<float> WU, WV;
+	// [TriangleOffsets[c], TriangleOffsets[c + 1]) are the triangles of color c
+	TArray<int32> TriangleOffsets;
+
+	// hinges in color order
+	TArray<FHinge> Hinges;
+	TArray<int32> HingeOffsets;
+
+	// elements per parallel task
+	static constexpr int32 ChunkSize = 512;
+
+	// painted multipliers of K per triangle and per hinge
+	TArray<float> TriangleKScale, HingeKScale;
+
+	// energy of each triangle and hinge at the last local step
+	TArray<float> StretchEnergy, BendEnergy;
+
+	// row of each vertex, INDEX_NONE for pinned vertices
+	TArray<int32> Rows;
+	// vertex of each row
+	TArray<int32> RowVertices;
+	// pinned vertices of the factorization, sorted
+	TArray<uint32> PinnedVertices;
+	// off diagonal entries between a free row and a pinned vertex
+	TArray<int32> CouplingRows;
+	TArray<int32> CouplingVertices;
+	TArray<float> CouplingValues;
+
+	FRTEnvelopeCholesky Cholesky;
+	bool bAssembled = false;
+	bool bFactorized = false;
+	// the factorization of FactorizedDuration failed, retried when the material, pins or step change
+	bool bFactorizationFailed = false;
+	float FactorizedDuration = 0;
+
+	int32 Iterations = 10;
+
+	bool bChebyshev = false;
+	FRTChebyshevAcceleration Chebyshev;
+
+	TArray<FVector> Velocities;
+	// positions at the start of the tick
+	TArray<FVector> Pre_Positions;
+	// inertial target S
+	TArray<FVector> Inertial;
+	// right hand side per vertex, and per row for the solve
+	TArray<FVector> Rhs;
+	TArray<FVector> Solution;
+};
@@ -2,12 +2,14 @@
 
 #include "FRTClothSystemBase.h"
 
-#include "FRTShearCondition.h"
-#include "FRTStretchCondition.h"
-#include "FRTBendCondition.h"
+#include "FRTBendKernel.h"
+#include "FRTStretchShearKernel.h"
+#include "FRTStrainLimiter.h"
+#include "FRTExplicitIntegrator.h"
 
 // Verlet Integration
-// X_{i + 1} = 2 * X_{i} - X_{i-1} + Acc(X_{i}) * h ^ 2
+// X_{i + 1} = 2 * X_{i} - X_{i-1} + Acc(X_{i}) * h ^ 2,
+// for a step h_i that differs from h_{i-1}: X_{i + 1} = X_{i} + h_i / h_{i-1} * (X_{i} - X_{i-1}) + Acc(X_{i}) * h_i * (h_i + h_{i-1}) / 2
 
 class FRTClothSystem_Verlet_CPU : public FRTClothSystemBase
 {
@@ -15,20 +17,36 @@ public:
 	explicit FRTClothSystem_Verlet_CPU() = default;
 
 	virtual void TickOnce(float Duration) override;
+
+	virtual FRTClothEnergy Energy() const override;
 	
 private:
+	// velocities for sleeping
+	virtual TArray<FVector> const* CurrentVelocities() const override {return &Velocities;}
+
+	// Velocities is (X_{i+1} - X_i) / (h + h_{i-1}), the published one is (X_{i+1} - X_i) / h
+	virtual float CurrentVelocityScale() const override {return VelocityScale;}
+
 	// calculate forces and derivatives
 	void Acceleration();
 
 	// setup runtime variables
 	virtual void PrepareSimulation() override;
 
+	// pick kernel variants for the active terms of the material
+	virtual void MaterialUpdated() override;
+
 	// TODO : solve inner collision
 
 	// pre computed conditions cache. use forces only
-	TArray<FRTStretchCondition> StretchConditions;
-	TArray<FRTShearCondition> ShearConditions;
-	TArray<FRTBendCondition> BendConditions;
+	FRTStretchShearKernel StretchShearKernel;
+	FRTBendKernel BendKernel;
+
+	// clamps the membrane stretch after integration
+	FRTStrainLimiter StrainLimiter;
+
+	// per vertex update, gravity and air friction are applied here
+	FRTExplicitIntegrator Integrator;
 
 	// Forces
 	TArray<FVector> Forces;
@@ -36,5 +54,9 @@ private:
 	// X_{i-1}
 	TArray<FVector> Pre_Positions;
 	TArray<FVector> Velocities;
+	// h_{i-1}, 0 before the first step
+	float PreDuration = 0;
+	// (h + h_{i-1}) / h of the last step
+	float VelocityScale = 1;
 
 };
\ No newline at end of file
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include "FRTClothSystemBase.h"
+
+// Extended Position Based Dynamics (Macklin et al. 2016)
+// X is predicted from V and the external forces, then constraints C(X) = 0 with compliance alpha are solved by
+// Gauss-Seidel sweeps: dLambda = (-C - alpha / h^2 * Lambda) / (sum w |grad C|^2 + alpha / h^2), dX = w * grad C * dLambda.
+// The Lambdas accumulate over the sweeps of one tick, so the stiffness does not depend on the step or the iterations.
+// Distance: every edge, rest length in uv space, 1 / alpha = K_Stretch * sum a^2 * Rest_U * Rest_V / L^2
+// over the triangles of the edge, which matches the stretch condition for edges along u or v.
+// Bend: C = |W^T X| - |W^T X_rest| of the quadratic hinge (see FRTQuadraticBendKernel), 1 / alpha = K_Bend * S.
+// Damping (eq. 26 of the paper): each constraint is damped by D * grad C^T grad C with D = D_Stretch or D_Bend
+// times the same weights as its stiffness, gamma = alpha / h^2 * D * h, so
+// dLambda = (-C - alpha / h^2 * Lambda - gamma * grad C (X - X_n)) / ((1 + gamma) sum w |grad C|^2 + alpha / h^2).
+// Attachment: constrained vertices follow their constrained explicit step with zero compliance (infinite mass).
+// Constraints of one color share no vertex and are solved in parallel.
+class FRTClothSystem_XPBD_CPU : public FRTClothSystemBase
+{
+public:
+	explicit FRTClothSystem_XPBD_CPU() = default;
+
+	virtual void TickOnce(float Duration) override;
+
+	virtual FRTClothEnergy Energy() const override;
+
+	// Gauss-Seidel sweeps per tick
+	void SetIterations(int32 InIterations) {Iterations = FMath::Max(1, InIterations);}
+
+private:
+	// velocities for sleeping
+	virtual TArray<FVector> const* CurrentVelocities() const override {return &Velocities;}
+
+	// setup runtime variables
+	virtual void PrepareSimulation() override;
+
+	// one sweep over all distance constraints, then all bend constraints
+	void SolveConstraints(float Duration);
+
+	struct FHinge
+	{
+		// vertices (V1, V2, V0, V3) and their weights, see FRTQuadraticBendKernel
+		int32 Idx[4];
+		float W[4];
+		// S of the hinge times its painted multiplier, 1 / alpha per unit K_Bend
+		float S;
+		// S of the hinge times its painted damping multiplier, damping per unit D_Bend
+		float SD;
+		// |W^T X| of the rest shape
+		float RestNorm;
+	};
+
+	// edges in color order
+	TArray<int32> E0, E1;
+	TArray<float> RestLength;
+	// 1 / alpha per unit K_Stretch and damping per unit D_Stretch, painted multipliers included
+	TArray<float> EdgeStiffness, EdgeDamping;
+	// [EdgeOffsets[c], EdgeOffsets[c + 1]) are the edges of color c
+	TArray<int32> EdgeOffsets;
+
+	// hinges in color order
+	TArray<FHinge> Hinges;
+	TArray<int32> HingeOffsets;
+
+	// constraints per parallel task
+	static constexpr int32 ChunkSize = 512;
+
+	// accumulated multipliers of the current tick
+	TArray<float> EdgeLambda, HingeLambda;
+	// C^2 / (2 alpha) of each constraint at the last sweep
+	TArray<float> StretchEnergy, BendEnergy;
+
+	int32 Iterations = 10;
+
+	// 1 / mass, 0 for constrained vertices
+	TArray<float> InvMasses;
+	TArray<FVector> Velocities;
+	// positions at the start of the tick
+	TArray<FVector> Pre_Positions;
+	TArray<FVector> Forces;
+};
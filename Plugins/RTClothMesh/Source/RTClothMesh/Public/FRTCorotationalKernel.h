@@ -0,0 +1,82 @@
+﻿#pragma once
+
+#include "FRTStretchShearKernel.h"
+
+// Co-rotational linear FEM membrane. F = [wu / Rest_U, wv / Rest_V] is split by a 2x2 polar decomposition
+// in the plane of the triangle into the rotation R (3x2) and the symmetric stretch R^T F,
+// the energy is linear elasticity on e = R^T F - I with R held fixed:
+// E = 1 / 2 * (Ku * e_uu^2 + Kv * e_vv^2 + Ks * (2 e_uv)^2).
+// Ku = K_Stretch * a^2 * Rest_U^2, Kv = K_Stretch * a^2 * Rest_V^2, Ks = K_Shear * a^2 * Rest_U^2 * Rest_V^2,
+// so the stiffness matches FRTStretchCondition and FRTShearCondition for small strains.
+// The Hessian is a constant per triangle matrix rotated by R, no normalization or curvature terms.
+// Damping uses the same matrix with D_Stretch, D_Shear.
+// Evaluated in parallel by triangle color.
+class FRTCorotationalKernel
+{
+public:
+	FRTCorotationalKernel() = default;
+
+	// precompute the rest data of all triangles of the mesh
+	void Init(FClothRawMesh const& Mesh, float Rest_U, float Rest_V);
+
+	int32 Num() const {return I0.Num();}
+
+	// call when the material changes
+	void SetParams(FRTMembraneParams const& InParams) {Params = InParams;}
+
+	// per vertex multipliers of K and D (painted maps), each triangle takes the mean of its vertices.
+	// empty arrays reset the multipliers to 1
+	void SetScaleMaps(TArray<float> const& VertexK, TArray<float> const& VertexD);
+
+	// Forces += elastic and damping forces
+	void ComputeForces(TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector> &Forces) const;
+
+	// Forces += elastic and damping forces, dfdx += -R K R^T, dddv += -R D R^T, dddx is not touched.
+	// Runs in parallel only when the patterns of the matrices are locked
+	void ComputeForcesAndDerivatives(
+		TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector> &Forces,
+		FRTBBSSMatrix<float> &dfdx,
+		FRTBBSSMatrix<float> &dddv) const;
+
+	// elastic energies of the last force pass, the passes store them per triangle on the way
+	float LastStretchEnergy() const;
+	float LastShearEnergy() const;
+
+	// largest change of the columns of R between Reference and X,
+	// the Hessian only depends on R, so this measures how far it has drifted since it was computed at Reference
+	float MaxRotationChange(TArray<FVector> const& X, TArray<FVector> const& Reference) const;
+
+	// check on a rotated state with small strain: forces against FRTStretchCondition and FRTShearCondition,
+	// which agree to first order, dfdx and dddv against central differences,
+	// returns max force difference relative to the largest value, the derivative one goes to DerivativeError.
+	// params are restored afterwards
+	float CompareWithConditions(FClothRawMesh *Mesh, float &DerivativeError);
+
+private:
+	// rotation of triangle T, false if the triangle is degenerated
+	bool Rotation(int32 T, FVector const* X, FVector &Ru, FVector &Rv) const;
+
+	template <bool bDerivatives>
+	void Pass(int32 Begin, int32 End, FVector const* X, FVector const* V, FVector *Forces,
+		FRTBBSSMatrix<float> *dfdx, FRTBBSSMatrix<float> *dddv) const;
+
+	// vertex indices
+	TArray<int32> I0, I1, I2;
+	// dF/dX1 and dF/dX2 as (u, v) weights, dF/dX0 = -dF/dX1 - dF/dX2
+	TArray<float> Gu1, Gu2, Gv1, Gv2;
+	// a^2 * Rest_U^2, a^2 * Rest_V^2 and a^2 * Rest_U^2 * Rest_V^2, the stiffness per unit K
+	TArray<float> WU, WV, WS;
+	// multipliers of K and D, 1 without maps
+	TArray<float> KScale, DScale;
+
+	// energy of each triangle, written by the force passes
+	mutable TArray<float> StretchEnergy, ShearEnergy;
+
+	// triangles are sorted by color, [ColorOffsets[c], ColorOffsets[c + 1]) is color c
+	TArray<int32> ColorOffsets;
+	// triangles per parallel task
+	static constexpr int32 ChunkSize = 512;
+
+	float RestU = 1.f, RestV = 1.f;
+	FRTMembraneParams Params = {0, 0, 0, 0};
+};
@@ -14,6 +14,8 @@ public:
 	// 	TArray<FVector> &DampingF,  FRTBBSSMatrix<float> &dddx,  FRTBBSSMatrix<float> &dddv
 	// ) = 0;
 	virtual void UpdateCondition(TArray<FVector> const& X, TArray<FVector> const& V,TArray<FVector2D> const& UV) = 0;
+	// elastic energy K / 2 * C^2 at the state of the last UpdateCondition
+	virtual float Energy(float K) const = 0;
 	virtual void ComputeForces(
 		float K, float D,
 		TArray<FVector> &Forces, TArray<FVector> &DampingF
@@ -24,4 +26,26 @@ public:
 		FRTBBSSMatrix<float> &dddx,
 		FRTBBSSMatrix<float> &dddv
 	) = 0;
+
+protected:
+	// M[3I..3I+2][3J..3J+2] += Block
+	static void AddBlock(FRTBBSSMatrix<float> &M, uint32 I, uint32 J, FRTMatrix3 const& Block)
+	{
+		for (uint32 i = 0; i < 3; i ++)
+		{
+			for (uint32 j = 0; j < 3; j ++)
+			{
+				M[3 * I + i][3 * J + j] += Block[i][j];
+			}
+		}
+	}
+
+	// M[3I..3I+2][3J..3J+2] += Value * Identity
+	static void AddDiag(FRTBBSSMatrix<float> &M, uint32 I, uint32 J, float Value)
+	{
+		for (uint32 i = 0; i < 3; i ++)
+		{
+			M[3 * I + i][3 * J + i] += Value;
+		}
+	}
 };
\ No newline at end of file
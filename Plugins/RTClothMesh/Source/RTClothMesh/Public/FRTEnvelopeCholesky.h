@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+// Sparse Cholesky factorization L L^T of a symmetric positive definite matrix in envelope (skyline) form.
+// Rows are reordered by reverse Cuthill-McKee on the adjacency graph to keep the envelope narrow,
+// all fill-in of the factor stays inside the envelope. Factored in double precision.
+// One factorization solves any number of right hand sides, the three coordinates of FVectors at once.
+class FRTEnvelopeCholesky
+{
+public:
+	// order the rows and size the envelope from the adjacency of each row, clears the values
+	void Analyze(TArray<TArray<int32>> const& Adjacency);
+
+	int32 Size() const {return Permutation.Num();}
+
+	// A(I, J) += Value and A(J, I) += Value for I != J, I and J must be adjacent (or equal).
+	// call between Analyze and Factorize
+	void Add(int32 I, int32 J, double Value);
+
+	// keep a copy of the values added so far, RestoreValues puts them back over the factor.
+	// a matrix that only changes in some entries is then updated and factored again without the analysis
+	void StoreValues() {Stored = Values;}
+	void RestoreValues() {Values = Stored;}
+
+	// L L^T = A in place, false if A is not positive definite
+	bool Factorize();
+
+	// B = A^-1 B
+	void Solve(TArray<FVector> &B) const;
+
+	// number of stored entries of the factor
+	int32 NumOfEntries() const {return Values.Num();}
+
+private:
+	double& At(int32 Row, int32 Col) {return Values[RowOffsets[Row] + Col - First[Row]];}
+	double At(int32 Row, int32 Col) const {return Values[RowOffsets[Row] + Col - First[Row]];}
+
+	// row of each index and index of each row
+	TArray<int32> Permutation;
+	TArray<int32> Inverse;
+	// row R stores the columns [First[R], R], from Values[RowOffsets[R]]
+	TArray<int32> First;
+	TArray<int32> RowOffsets;
+	TArray<double> Values;
+	TArray<double> Stored;
+
+	// permuted right hand sides, reused by Solve
+	mutable TArray<double> Work;
+};
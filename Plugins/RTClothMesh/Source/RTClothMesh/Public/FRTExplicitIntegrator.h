@@ -0,0 +1,52 @@
+﻿#pragma once
+
+#include "RTClothStructures.h"
+
+// Per vertex updates of the explicit integrators, streamed over the xyz floats of the FVector arrays.
+// Acc = F * InvMass + Bias - Drag * V, Bias is a constant acceleration (gravity, motion of the cloth frame, wind),
+// Drag is the air friction. Inverse masses are kept per float, so every float is updated the same way,
+// 24 floats (8 vertices) per avx2 iteration keep Bias in line with the lanes.
+// Constrained vertices are corrected afterwards to Acc = C * Acc, one pass over the constrained vertices only.
+class FRTExplicitIntegrator
+{
+public:
+	// per float inverse masses, call when the masses change
+	void Init(TArray<float> const& InverseMasses);
+
+	void SetAcceleration(FVector const& InBias, float InDrag)
+	{
+		Bias = InBias;
+		Drag = InDrag;
+	}
+
+	// variable step Verlet, h is this step and PrevH the step from Pre to X:
+	// Pre = X + h / PrevH * (X - Pre) + Acc * h * (h + PrevH) / 2, V = (Pre - X) / (h + PrevH),
+	// which is 2 * X - Pre + Acc * h^2 and (Pre - X) / (2 * h) for a constant step.
+	// Pre holds the new positions afterwards, swap it with X
+	void Verlet(
+		TArray<FVector> const& X, TArray<FVector> &Pre, TArray<FVector> &V, TArray<FVector> const& F, float h, float PrevH,
+		TArray<int32> const& ConstrainedVertices, TArray<FRTMatrix3> const& ConstraintMats);
+
+	// first half of leapfrog with the acceleration A of the last step:
+	// VHalf = V + h / 2 * A, X += h * VHalf, V += h * A
+	static void LeapfrogDrift(TArray<FVector> &X, TArray<FVector> &V, TArray<FVector> &VHalf, TArray<FVector> const& A, float h);
+
+	// second half of leapfrog: A = Acc, V = VHalf + h / 2 * A
+	void LeapfrogKick(
+		TArray<FVector> &A, TArray<FVector> &V, TArray<FVector> const& VHalf, TArray<FVector> const& F, float h,
+		TArray<int32> const& ConstrainedVertices, TArray<FRTMatrix3> const& ConstraintMats);
+
+private:
+	FORCEINLINE FVector Acceleration(int32 i, FVector const& F, FVector const& V) const
+	{
+		return F * InvMass3[3 * i] + Bias - Drag * V;
+	}
+
+	// inverse mass of each float
+	TArray<float> InvMass3;
+	FVector Bias = {0, 0, 0};
+	float Drag = 0;
+
+	// results of the constrained vertices, computed before the pass overwrites their inputs
+	TArray<FVector> ConstrainedPositions, ConstrainedVelocities;
+};
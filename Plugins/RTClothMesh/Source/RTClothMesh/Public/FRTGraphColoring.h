@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/ParallelFor.h"
+
+// Greedy coloring of mesh elements (triangles, hinges), elements of one color share no vertex.
+// Elements of one color can scatter into per-vertex arrays from different threads without atomics.
+struct FRTGraphColoring
+{
+	// element ids sorted by color
+	TArray<int32> Order;
+	// Order[Offsets[c]] ... Order[Offsets[c + 1] - 1] are elements of color c
+	TArray<int32> Offsets;
+
+	// ElementVertices holds VerticesPerElement vertex ids for each element
+	void Build(TArray<uint32> const& ElementVertices, int32 VerticesPerElement, int32 NumOfVertices);
+
+	int32 NumOfColors() const {return Offsets.Num() - 1;}
+
+	// call Body(Color, Begin, End) on chunks of [Offsets[c], Offsets[c + 1]),
+	// colors run one after another, chunks of one color run in parallel
+	template <typename FBody>
+	static void ParallelForEachColor(TArray<int32> const& Offsets, int32 ChunkSize, FBody const& Body, bool bForceSingleThread = false)
+	{
+		for (int32 c = 0; c + 1 < Offsets.Num(); c ++)
+		{
+			int32 const Begin = Offsets[c];
+			int32 const End = Offsets[c + 1];
+			int32 const NumOfChunks = (End - Begin + ChunkSize - 1) / ChunkSize;
+			ParallelFor(NumOfChunks, [&](int32 Chunk)
+			{
+				int32 const ChunkBegin = Begin + Chunk * ChunkSize;
+				Body(c, ChunkBegin, std::min(ChunkBegin + ChunkSize, End));
+			}, bForceSingleThread);
+		}
+	}
+};
@@ -0,0 +1,34 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+// Recursive bisection of a vertex graph into parts of nearly equal size.
+// Each cut orders the vertices of a part by breadth first search from a pseudo peripheral vertex and splits the order,
+// so parts stay connected where the graph allows it and the interfaces between parts stay short.
+struct FRTGraphPartition
+{
+	// part of each vertex
+	TArray<int32> VertexParts;
+
+	// ElementVertices holds VerticesPerElement vertex ids for each element, vertices of one element are adjacent
+	void Build(TArray<uint32> const& ElementVertices, int32 VerticesPerElement, int32 NumOfVertices, int32 NumOfParts);
+
+private:
+	// split Order[Begin, End) into NumOfParts parts starting at FirstPart
+	void Split(int32 Begin, int32 End, int32 FirstPart, int32 NumOfParts);
+
+	// breadth first search over the vertices of Order[Begin, End) into Queue, restarting at unvisited vertices
+	// when a component is exhausted. returns the last vertex reached from Start
+	int32 Search(int32 Begin, int32 End, int32 Start);
+
+	// adjacency in CSR form
+	TArray<int32> AdjacencyOffsets;
+	TArray<int32> Adjacency;
+
+	TArray<int32> Order;
+	TArray<int32> Queue;
+	// last Tag that marked each vertex as part of the current range, and as visited
+	TArray<int32> InRange;
+	TArray<int32> Visited;
+	int32 Tag = 0;
+};
@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/ParallelFor.h"
+
+// how a parallel force pass avoids races on the per-vertex force array
+enum class ERTScatterMode : uint8
+{
+	// elements of one color share no vertex and write forces directly, see FRTGraphColoring
+	Coloring,
+	// fixed ranges of elements write into their own buffers, buffers are summed in range order
+	PrivateBuffers,
+};
+
+// Private force buffers, one per range of elements.
+// Ranges are fixed at Init and summed in the same order every time,
+// so the result does not depend on which thread ran which range.
+class FRTPrivateForceBuffers
+{
+public:
+	// split NumOfElements into one range per worker, range boundaries are multiples of Alignment
+	void Init(int32 NumOfElements, int32 NumOfVertices, int32 Alignment = 1);
+
+	void Reset();
+
+	bool IsEmpty() const {return Buffers.Num() == 0;}
+
+	// Body(Begin, End, Buffer) adds forces of elements in [Begin, End) into Buffer,
+	// then Forces += all buffers
+	template <typename FBody>
+	void Run(TArray<FVector> &Forces, FBody const& Body)
+	{
+		ParallelFor(Buffers.Num(), [&](int32 r)
+		{
+			TArray<FVector> &Buffer = Buffers[r];
+			FMemory::Memzero(Buffer.GetData(), Buffer.Num() * sizeof(FVector));
+			Body(RangeOffsets[r], RangeOffsets[r + 1], Buffer);
+		});
+		Reduce(Forces);
+	}
+
+private:
+	void Reduce(TArray<FVector> &Forces) const;
+
+	TArray<int32> RangeOffsets;
+	TArray<TArray<FVector>> Buffers;
+};
+
+// run Run(Mode) a few times under each scatter mode and return the faster mode.
+// private buffers have to win by Margin, close timings keep coloring so the choice does not flip between runs
+template <typename FRun>
+ERTScatterMode PickFasterScatterMode(FRun const& Run, int32 Repeats = 4, double Margin = 0.1)
+{
+	double Cost[2] = {0, 0};
+	for (int32 Mode = 0; Mode < 2; Mode ++)
+	{
+		// warm up caches and the task graph
+		Run(ERTScatterMode(Mode));
+		double const Start = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Repeats; i ++)
+		{
+			Run(ERTScatterMode(Mode));
+		}
+		Cost[Mode] = FPlatformTime::Seconds() - Start;
+	}
+	return Cost[1] < Cost[0] * (1 - Margin) ? ERTScatterMode::PrivateBuffers : ERTScatterMode::Coloring;
+}
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/FRTSparseMatrix.h"
+
+// Quadratic isometric bending (Bergou et al. 2006): E = K / 2 * x^T Q x, Q summed over hinges from cotangent weights
+// of the rest shape, which is taken as flat. Scaled to match K * L / 2 * theta^2 of FRTBendCondition for small angles.
+// Q does not depend on the positions, so the bend Hessian is -K * Q at all times
+// and the forces -K * Q * x - D * Q * v are one constant sparse matrix vector product per step.
+// Hinge: triangles (X0, X1, X2) and (X3, X2, X1) sharing the edge X1 - X2, same as FRTBendKernel.
+// Accurate for isometric deformations of nearly flat cloth, InitTheta is not supported.
+class FRTQuadraticBendKernel
+{
+public:
+	FRTQuadraticBendKernel();
+
+	void Reset(int32 NumOfVertices);
+
+	// add one hinge, the cotangent weights are taken from the rest positions RestX, the rest length of the shared edge from UV.
+	// hinges with degenerated triangles are skipped
+	void Add(uint32 V0, uint32 V1, uint32 V2, uint32 V3, TArray<FVector> const& RestX, TArray<FVector2D> const& UV);
+
+	// weights W of the vertices (V1, V2, V0, V3) and the scale S of one hinge, Q of the hinge is S * W W^T.
+	// false for degenerated triangles
+	static bool HingeWeights(uint32 V0, uint32 V1, uint32 V2, uint32 V3,
+		TArray<FVector> const& RestX, TArray<FVector2D> const& UV, float W[4], float &S);
+
+	// build the compressed rows of Q, call once after all hinges are added
+	void Finalize();
+
+	int32 Num() const {return Hinges.Num();}
+
+	// set stiffness and damping, the damping (and the velocity read) is skipped when D is zero
+	void SetParams(float InK, float InD);
+
+	// per vertex multipliers of K and D (painted maps), each hinge takes the mean of its shared edge.
+	// rebuilds the values of Q, empty arrays reset the multipliers to 1, call after Finalize
+	void SetScaleMaps(TArray<float> const& VertexK, TArray<float> const& VertexD);
+
+	// Forces += -K * Q * X - D * Q * V, rows are independent and run in parallel
+	void ComputeForces(TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector> &Forces) const;
+
+	// dfdx += -K * Q, dddv += -D * Q (skipped when D is zero), on the diagonal of each 3x3 block.
+	// the result is constant, add it once into a baked matrix instead of every step
+	void AddDerivatives(FRTBBSSMatrix<float> &dfdx, FRTBBSSMatrix<float> &dddv) const;
+
+	// elastic energy K / 2 * x^T Q x of the last force pass, stored per vertex on the way
+	float LastEnergy() const;
+
+private:
+	template <bool bDamping>
+	void Pass(int32 Begin, int32 End, FVector const* X, FVector const* V, FVector *Forces) const;
+
+	// Q of one hinge is S * W W^T on the vertices Idx, the shared edge is Idx[0] - Idx[1]
+	struct FHinge
+	{
+		int32 Idx[4];
+		float W[4];
+		float S;
+	};
+	TArray<FHinge> Hinges;
+	int32 NumOfRows = 0;
+
+	// Q in compressed rows, [RowOffsets[i], RowOffsets[i + 1]) are the entries of row i, the diagonal included.
+	// the stiffness and the damping multipliers give two sets of values on the same pattern
+	TArray<int32> RowOffsets;
+	TArray<int32> Cols;
+	TArray<float> ValuesK;
+	TArray<float> ValuesD;
+
+	// energy of each row, written by the force pass
+	mutable TArray<float> RowEnergy;
+
+	// rows per parallel task
+	static constexpr int32 ChunkSize = 512;
+
+	float K = 0, D = 0;
+	typedef void (FRTQuadraticBendKernel::*FForcePass)(int32, int32, FVector const*, FVector const*, FVector*) const;
+	FForcePass ForcePass = nullptr;
+};
@@ -1,4 +1,4 @@
-#pragma once
+﻿#pragma once
 
 #include "FRTEnergyCondition.h"
 #include "RTClothStructures.h"
@@ -15,6 +15,11 @@ public:
 	virtual void UpdateCondition(
 		TArray<FVector> const& X, TArray<FVector> const& V,TArray<FVector2D> const& UV
 	) override;
+
+	virtual float Energy(float K) const override
+	{
+		return 0.5f * K * C * C;
+	}
 	
 	virtual void ComputeForces(
 		 float K, float D,
@@ -27,7 +32,7 @@ public:
 		FRTBBSSMatrix<float> &dddx,
 		FRTBBSSMatrix<float> &dddv
 	) override;
-	virtual void Update(const FVector &P0, const FVector &P1, const FVector &P2, const FVector& V0, const FVector& V1, const FVector& V2) override;
+	void Update(const FVector &P0, const FVector &P1, const FVector &P2, const FVector& V0, const FVector& V1, const FVector& V2);
 private:
 	// C condition:
 	float C = 0;
@@ -35,6 +40,9 @@ private:
 	// time derivative of C:
 	float dCdt = 0;
 
-	// dcdx
-	FVector dCdX[3];
+	// dC/dX_i = a * (dwudXScalar[i] * wv + dwvdXScalar[i] * wu), computed from wu, wv when needed
+	FORCEINLINE FVector dCdX(uint32 i) const
+	{
+		return a * (dwudXScalar[i] * wv + dwvdXScalar[i] * wu);
+	}
 };
\ No newline at end of file
@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include "FRTClothSystemBase.h"
+
+// bounds and targets of adaptive time stepping
+struct FRTStepControl
+{
+	float MinStep;
+	float MaxStep;
+	// largest change of the stretch of an edge in one step
+	float MaxStrainChange;
+	// largest move of a vertex in one step, in shortest rest edges
+	float MaxMotion;
+	// deeper collisions (in shortest rest edges) halve the step
+	float MaxPenetration;
+	// largest growth of the step from one tick to the next
+	float Growth;
+	// steps are MinStep times a power of two and grow by one power per tick at most, instead of by Growth.
+	// for solvers that factor a matrix of the step, which is then factored again only when the step changes by 2x
+	bool bPowerOfTwo;
+};
+
+// Picks the next time step of a cloth from the motion of its last tick (FRTStepMeasures).
+// The step shrinks at once to keep the strain change and the vertex motion per step under their targets,
+// and to half after a deep collision. Calm cloth grows the step by Growth per tick up to MaxStep.
+// With bPowerOfTwo the step is the largest MinStep * 2^k under these limits and doubles only when twice the step is under them.
+class FRTStepController
+{
+public:
+	void SetParams(FRTStepControl const& InParams) {Params = InParams;}
+
+	FRTStepControl const& GetParams() const {return Params;}
+
+	// next step after a tick of Duration
+	float NextStep(FRTStepMeasures const& Measures, float Duration) const;
+
+private:
+	FRTStepControl Params = {0.002f, 0.02f, 0.01f, 0.25f, 0.1f, 1.25f, false};
+};
@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include "RTClothStructures.h"
+
+// Strain limiting of the membrane after integration.
+// The principal stretches of each triangle (singular values of F = [wu / Rest_U, wv / Rest_V]) are clamped
+// into [MinStretch, MaxStretch] by moving its vertices to the clamped shape around their mass weighted center.
+// Triangles are projected color by color (Gauss-Seidel), triangles of one color share no vertex and run in parallel.
+// Constrained vertices are treated as pinned.
+class FRTStrainLimiter
+{
+public:
+	// build SoA data from triangles of the mesh
+	void Init(FClothRawMesh const& Mesh, float Rest_U, float Rest_V);
+
+	// MaxStretch <= 0 disables the stretch limit, MinStretch <= 0 disables the compression limit
+	void SetLimits(float InMinStretch, float InMaxStretch, int32 InIterations);
+
+	bool IsEnabled() const {return Iterations > 0 && (MaxStretch > 0 || MinStretch > 0);}
+
+	int32 Num() const {return I0.Num();}
+
+	// project positions X, V += DeltaToVelocity * (change of X).
+	// vertices with a ConstraintIndex other than INDEX_NONE are pinned.
+	// returns the number of triangles clamped in the first iteration
+	int32 Apply(
+		TArray<FVector> &X, TArray<FVector> &V, float DeltaToVelocity,
+		TArray<float> const& InverseMasses, TArray<int32> const& ConstraintIndex) const;
+
+private:
+	// clamp the principal stretches of triangle T, return true if it was clamped
+	bool Project(int32 T, FVector *X, FVector *V, float DeltaToVelocity, float const* InverseMasses, int32 const* ConstraintIndex) const;
+
+	// vertex indices
+	TArray<int32> I0, I1, I2;
+	// rest shape: R1 = P1 - P0, R2 = P2 - P0 in (u * Rest_U, v * Rest_V)
+	TArray<float> R1U, R1V, R2U, R2V;
+	// inverse of [R1 R2]
+	TArray<float> InvA, InvB, InvC, InvD;
+
+	// triangles are sorted by color, [ColorOffsets[c], ColorOffsets[c + 1]) is color c
+	TArray<int32> ColorOffsets;
+	// triangles per parallel task
+	static constexpr int32 ChunkSize = 512;
+
+	float MinStretch = 0;
+	float MaxStretch = 0;
+	int32 Iterations = 0;
+};
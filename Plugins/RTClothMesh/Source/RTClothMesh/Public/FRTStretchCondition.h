@@ -1,4 +1,4 @@
-#pragma once
+﻿#pragma once
 
 #include "FRTEnergyCondition.h"
 #include "RTClothStructures.h"
@@ -15,6 +15,11 @@ public:
 	virtual void UpdateCondition(
 		TArray<FVector> const& X, TArray<FVector> const& V,TArray<FVector2D> const& UV
 	) override;
+
+	virtual float Energy(float K) const override
+	{
+		return 0.5f * K * (C0 * C0 + C1 * C1);
+	}
 	
 	virtual void ComputeForces(
 		 float K, float D,
@@ -32,7 +37,7 @@ public:
 	{
 	}
 private:
-	virtual void Update(const FVector &P0, const FVector &P1, const FVector &P2, const FVector& V0, const FVector& V1, const FVector& V2) override;
+	void Update(const FVector &P0, const FVector &P1, const FVector &P2, const FVector& V0, const FVector& V1, const FVector& V2);
 	
 	// energy condition:
 	float C0 = 0, C1 = 0;
@@ -43,7 +48,8 @@ private:
 	// time derivatives of energy condition:
 	float dC0dt = 0, dC1dt = 0;
 
-	// derivatives of the energy conditions:
-	FVector dC0dX[3];
-	FVector dC1dX[3];
+	// derivatives of the energy conditions on wu and wv,
+	// dC0/dX_i = dwudXScalar[i] * dC0dwu, dC1/dX_i = dwvdXScalar[i] * dC1dwv
+	FVector dC0dwu;
+	FVector dC1dwv;
 };
\ No newline at end of file
@@ -0,0 +1,138 @@
+﻿#pragma once
+
+#include "RTClothStructures.h"
+#include "Math/FRTSparseMatrix.h"
+#include "FRTPrivateForceBuffers.h"
+
+// stiffness and damping of the in-plane (membrane) terms
+struct FRTMembraneParams
+{
+	float K_Stretch;
+	float D_Stretch;
+	float K_Shear;
+	float D_Shear;
+
+	// from FRTClothPhysicalMaterial
+	template <typename MaterialType>
+	static FRTMembraneParams FromMaterial(MaterialType const& Material)
+	{
+		return {Material.K_Stretch, Material.D_Stretch, Material.K_Shear, Material.D_Shear};
+	}
+};
+
+// Stretch and shear (membrane) terms of all triangles, stored in SoA form and evaluated in one pass,
+// wu, wv and their time derivatives are computed once per triangle and shared by both terms.
+// wu = Cu1 * (X1 - X0) + Cu2 * (X2 - X0), wv = Cv1 * (X1 - X0) + Cv2 * (X2 - X0),
+// Cu, Cv are dwudXScalar, dwvdXScalar of FClothTriangleStaticProperties (Cu0 = -Cu1 - Cu2).
+// Same energies as FRTStretchCondition and FRTShearCondition.
+// Evaluated in parallel, by triangle color or into private force buffers (see ERTScatterMode).
+class FRTStretchShearKernel
+{
+public:
+	FRTStretchShearKernel();
+
+	// build SoA data from triangles of the mesh
+	void Init(FClothRawMesh const& Mesh, float Rest_U, float Rest_V);
+
+	int32 Num() const {return I0.Num();}
+
+	// set stiffness and damping, and pick the variant that skips inactive terms:
+	// shear when K_Shear and D_Shear are zero, damping (and the velocity gather) when all D are zero.
+	// call when the material changes
+	void SetParams(FRTMembraneParams const& InParams);
+
+	FRTMembraneParams const& GetParams() const {return Params;}
+
+	// per vertex multipliers of K and D (painted maps), each triangle takes the mean of its vertices.
+	// empty arrays reset the multipliers to 1
+	void SetScaleMaps(TArray<float> const& VertexK, TArray<float> const& VertexD);
+
+	// use Pinned, or time the force pass on positions X under both scatter modes and keep the faster one.
+	// the modes sum forces in different orders, pin one for results that repeat across runs
+	void SelectScatterMode(TArray<FVector> const& X, TOptional<ERTScatterMode> const& Pinned);
+
+	// Forces += stretch and shear forces and damping forces
+	void ComputeForces(TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector> &Forces) const;
+
+	// Forces += stretch and shear forces and damping forces, and add up Hessians for the implicit integrator.
+	// Blocks of inactive terms are not touched. Runs in parallel only when the patterns of the matrices are locked
+	void ComputeForcesAndDerivatives(
+		TArray<FVector> const& X, TArray<FVector> const& V, TArray<FVector> &Forces,
+		FRTBBSSMatrix<float> &dfdx,
+		FRTBBSSMatrix<float> &dddx,
+		FRTBBSSMatrix<float> &dddv) const;
+
+	// elastic energies K / 2 * C^2 of the last force pass, the passes store them per triangle on the way
+	float LastStretchEnergy() const {return SumEnergy(StretchEnergy);}
+	float LastShearEnergy() const {return Params.K_Shear != 0 ? SumEnergy(ShearEnergy) : 0.f;}
+
+	// largest change between Reference and X of the stretch (|wu|, |wv| over the rest lengths) and of the directions of wu, wv,
+	// measures how far the membrane Hessian has drifted since it was computed at Reference
+	float MaxStrainChange(TArray<FVector> const& X, TArray<FVector> const& Reference) const;
+
+	// check every variant on a deformed state of the mesh: forces and energies against FRTStretchCondition and FRTShearCondition
+	// with the material of each triangle,
+	// dfdx and dddv against central differences, returns max force/energy difference relative to the largest value,
+	// the derivative one goes to DerivativeError. params are restored afterwards
+	float CompareWithConditions(FClothRawMesh *Mesh, float &DerivativeError);
+
+private:
+	template <bool bDamping, bool bShear>
+	void SelectVariant();
+
+	// avx2 batches, then the scalar tail
+	template <bool bDamping, bool bShear>
+	void MembranePass(int32 Begin, int32 End, FVector const* X, FVector const* V, FVector *Forces) const;
+
+	template <bool bDamping, bool bShear>
+	void MembraneScalar(int32 Begin, int32 End, FVector const* X, FVector const* V, FVector *Forces) const;
+
+	// return the first triangle in [Begin, End) that is not processed
+	template <bool bDamping, bool bShear>
+	int32 MembraneAVX2(int32 Begin, int32 End, FVector const* X, FVector const* V, FVector *Forces) const;
+
+	template <bool bDamping, bool bShear>
+	void MembraneDerivativesScalar(
+		int32 Begin, int32 End, FVector const* X, FVector const* V, FVector *Forces,
+		FRTBBSSMatrix<float> &dfdx, FRTBBSSMatrix<float> &dddx, FRTBBSSMatrix<float> &dddv) const;
+
+	static float SumEnergy(TArray<float> const& Energy);
+
+	// scatter per-triangle Hu, Hv: F_i -= Cu_i * Hu + Cv_i * Hv
+	FORCEINLINE void Scatter(int32 T, FVector const& Hu, FVector const& Hv, FVector *Forces) const
+	{
+		Forces[I0[T]] += (Cu1[T] + Cu2[T]) * Hu + (Cv1[T] + Cv2[T]) * Hv;
+		Forces[I1[T]] -= Cu1[T] * Hu + Cv1[T] * Hv;
+		Forces[I2[T]] -= Cu2[T] * Hu + Cv2[T] * Hv;
+	}
+
+	// vertex indices
+	TArray<int32> I0, I1, I2;
+	// triangle area in uv space
+	TArray<float> Area;
+	// first derivatives of wu, wv on X1 and X2
+	TArray<float> Cu1, Cu2, Cv1, Cv2;
+	// multipliers of K and D, 1 without maps, always applied
+	TArray<float> KScale, DScale;
+
+	// energy of each triangle, written by the force passes
+	mutable TArray<float> StretchEnergy, ShearEnergy;
+
+	// triangles are sorted by color, [ColorOffsets[c], ColorOffsets[c + 1]) is color c
+	TArray<int32> ColorOffsets;
+	// triangles per parallel task
+	static constexpr int32 ChunkSize = 512;
+
+	ERTScatterMode ScatterMode = ERTScatterMode::Coloring;
+	mutable FRTPrivateForceBuffers PrivateBuffers;
+
+	float RestU = 1.f, RestV = 1.f;
+
+	// active variant, selected by SetParams
+	FRTMembraneParams Params = {0, 0, 0, 0};
+	typedef void (FRTStretchShearKernel::*FForcePass)(int32, int32, FVector const*, FVector const*, FVector*) const;
+	typedef void (FRTStretchShearKernel::*FDerivativePass)(int32, int32, FVector const*, FVector const*, FVector*,
+		FRTBBSSMatrix<float>&, FRTBBSSMatrix<float>&, FRTBBSSMatrix<float>&) const;
+	FForcePass ForcePass = nullptr;
+	FDerivativePass DerivativePass = nullptr;
+};
@@ -60,7 +60,7 @@ public:
 		FRTMatrix Res;
 		for (uint32 i = 0; i < Raw * Col; i ++)
 		{
-			Res.Data[i] = Data[i] - Other.Data[i];
+			Res.Data[i] = Data[i] + Other.Data[i];
 		}
 		return Res;
 	}
@@ -0,0 +1,157 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+// 8-wide float lanes for the CPU condition kernels.
+// AVX2 code is compiled per function and selected at runtime, the module itself is built without /arch:AVX2
+#if PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_64BITS && defined(PLATFORM_CPU_X86_FAMILY) && PLATFORM_CPU_X86_FAMILY
+#define RTCLOTH_WITH_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#else
+#define RTCLOTH_WITH_AVX2 0
+#endif
+
+#if RTCLOTH_WITH_AVX2 && (defined(__clang__) || defined(__GNUC__))
+#define RTCLOTH_AVX2_FUNC __attribute__((target("avx2,fma")))
+#else
+#define RTCLOTH_AVX2_FUNC
+#endif
+
+namespace RTCloth
+{
+namespace Simd
+{
+	constexpr int32 Width = 8;
+
+	// check once if the running cpu (and os) supports avx2 + fma
+	FORCEINLINE bool HasAVX2()
+	{
+#if RTCLOTH_WITH_AVX2
+		static const bool bHasAVX2 = []()
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			int Info[4];
+			__cpuid(Info, 0);
+			if (Info[0] < 7) return false;
+			__cpuid(Info, 1);
+			bool const bOSXSave = (Info[2] & (1 << 27)) != 0;
+			bool const bFMA = (Info[2] & (1 << 12)) != 0;
+			if (!bOSXSave || !bFMA || (_xgetbv(0) & 0x6) != 0x6) return false;
+			__cpuidex(Info, 7, 0);
+			return (Info[1] & (1 << 5)) != 0;
+#else
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+		}();
+		return bHasAVX2;
+#else
+		return false;
+#endif
+	}
+
+#if RTCLOTH_WITH_AVX2
+	typedef __m256 FFloat8;
+	typedef __m256i FInt8;
+
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Load(const float *P) { return _mm256_loadu_ps(P); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FInt8 Load(const int32 *P) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(P)); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE void Store(float *P, FFloat8 const A) { _mm256_storeu_ps(P, A); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Set1(float const A) { return _mm256_set1_ps(A); }
+
+	// gather one component of FVectors, Base points at the first FVector, Idx are vertex indices
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 GatherComponent(const float *Base, FInt8 const Idx3, int32 const Component)
+	{
+		return _mm256_i32gather_ps(Base + Component, Idx3, 4);
+	}
+	RTCLOTH_AVX2_FUNC FORCEINLINE FInt8 Times3(FInt8 const Idx) { return _mm256_add_epi32(_mm256_add_epi32(Idx, Idx), Idx); }
+
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Add(FFloat8 const A, FFloat8 const B) { return _mm256_add_ps(A, B); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Sub(FFloat8 const A, FFloat8 const B) { return _mm256_sub_ps(A, B); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Mul(FFloat8 const A, FFloat8 const B) { return _mm256_mul_ps(A, B); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Div(FFloat8 const A, FFloat8 const B) { return _mm256_div_ps(A, B); }
+	// A * B + C
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 MulAdd(FFloat8 const A, FFloat8 const B, FFloat8 const C) { return _mm256_fmadd_ps(A, B, C); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Sqrt(FFloat8 const A) { return _mm256_sqrt_ps(A); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Neg(FFloat8 const A) { return _mm256_xor_ps(A, _mm256_set1_ps(-0.f)); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Abs(FFloat8 const A) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), A); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Min(FFloat8 const A, FFloat8 const B) { return _mm256_min_ps(A, B); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Max(FFloat8 const A, FFloat8 const B) { return _mm256_max_ps(A, B); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Zero() { return _mm256_setzero_ps(); }
+	// lane masks
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Greater(FFloat8 const A, FFloat8 const B) { return _mm256_cmp_ps(A, B, _CMP_GT_OQ); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Less(FFloat8 const A, FFloat8 const B) { return _mm256_cmp_ps(A, B, _CMP_LT_OQ); }
+	// Mask ? A : B
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Select(FFloat8 const Mask, FFloat8 const A, FFloat8 const B) { return _mm256_blendv_ps(B, A, Mask); }
+
+	// atan2 with cephes' atanf polynomial on [0, tan(pi/8)], max error about 1e-7 rad
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Atan2(FFloat8 const Y, FFloat8 const X)
+	{
+		FFloat8 const AX = Abs(X), AY = Abs(Y);
+		FFloat8 const Hi = Max(AX, AY);
+		// atan(Z), Z in [0, 1]
+		FFloat8 Z = Select(Greater(Hi, Zero()), Div(Min(AX, AY), Hi), Zero());
+		FFloat8 const Reduce = Greater(Z, Set1(0.414213562373095f));
+		Z = Select(Reduce, Div(Sub(Z, Set1(1.f)), Add(Z, Set1(1.f))), Z);
+		FFloat8 const Z2 = Mul(Z, Z);
+		FFloat8 P = MulAdd(Set1(8.05374449538e-2f), Z2, Set1(-1.38776856032e-1f));
+		P = MulAdd(P, Z2, Set1(1.99777106478e-1f));
+		P = MulAdd(P, Z2, Set1(-3.33329491539e-1f));
+		FFloat8 R = MulAdd(Mul(P, Z2), Z, Z);
+		R = Select(Reduce, Add(R, Set1(0.785398163397448f)), R);
+		// back to the full circle
+		R = Select(Greater(AY, AX), Sub(Set1(1.570796326794897f), R), R);
+		R = Select(Less(X, Zero()), Sub(Set1(3.141592653589793f), R), R);
+		return Select(Less(Y, Zero()), Neg(R), R);
+	}
+
+	// 3 lanes of float8 as a vector of 8 FVectors
+	struct FVec8
+	{
+		FFloat8 X, Y, Z;
+	};
+
+	RTCLOTH_AVX2_FUNC FORCEINLINE FVec8 Gather(const FVector *Base, FInt8 const Idx3)
+	{
+		const float *F = reinterpret_cast<const float *>(Base);
+		return {GatherComponent(F, Idx3, 0), GatherComponent(F, Idx3, 1), GatherComponent(F, Idx3, 2)};
+	}
+	RTCLOTH_AVX2_FUNC FORCEINLINE FVec8 Add(FVec8 const& A, FVec8 const& B) { return {Add(A.X, B.X), Add(A.Y, B.Y), Add(A.Z, B.Z)}; }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FVec8 Sub(FVec8 const& A, FVec8 const& B) { return {Sub(A.X, B.X), Sub(A.Y, B.Y), Sub(A.Z, B.Z)}; }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FVec8 Scale(FVec8 const& A, FFloat8 const S) { return {Mul(A.X, S), Mul(A.Y, S), Mul(A.Z, S)}; }
+	// A * S + B
+	RTCLOTH_AVX2_FUNC FORCEINLINE FVec8 ScaleAdd(FVec8 const& A, FFloat8 const S, FVec8 const& B)
+	{
+		return {MulAdd(A.X, S, B.X), MulAdd(A.Y, S, B.Y), MulAdd(A.Z, S, B.Z)};
+	}
+	RTCLOTH_AVX2_FUNC FORCEINLINE FVec8 Neg(FVec8 const& A) { return {Neg(A.X), Neg(A.Y), Neg(A.Z)}; }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FVec8 ZeroVec() { return {Zero(), Zero(), Zero()}; }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Component(FVec8 const& A, int32 const I) { return I == 0 ? A.X : (I == 1 ? A.Y : A.Z); }
+	RTCLOTH_AVX2_FUNC FORCEINLINE FFloat8 Dot(FVec8 const& A, FVec8 const& B)
+	{
+		return MulAdd(A.X, B.X, MulAdd(A.Y, B.Y, Mul(A.Z, B.Z)));
+	}
+	RTCLOTH_AVX2_FUNC FORCEINLINE FVec8 Cross(FVec8 const& A, FVec8 const& B)
+	{
+		return {
+			Sub(Mul(A.Y, B.Z), Mul(A.Z, B.Y)),
+			Sub(Mul(A.Z, B.X), Mul(A.X, B.Z)),
+			Sub(Mul(A.X, B.Y), Mul(A.Y, B.X))
+		};
+	}
+	RTCLOTH_AVX2_FUNC FORCEINLINE FVec8 Normalize(FVec8 const& A)
+	{
+		return Scale(A, Div(Set1(1.f), Sqrt(Dot(A, A))));
+	}
+	RTCLOTH_AVX2_FUNC FORCEINLINE void Store(float *X, float *Y, float *Z, FVec8 const& A)
+	{
+		Store(X, A.X);
+		Store(Y, A.Y);
+		Store(Z, A.Z);
+	}
+#endif
+}
+}
@@ -95,6 +95,7 @@ public:
 			Pattern.ColIndexAtEntrance.Empty();
 			Pattern.PreSumNumEntriesOfRaw.Empty();
 			IDToCompressedID.Reset();
+			TransposeCompressedID.Empty();
 			Compressed = false;
 		}
 	}
@@ -136,6 +137,17 @@ public:
 			CurrentStartIndex += Raw.Num();
 			Pattern.PreSumNumEntriesOfRaw[i] = CurrentStartIndex;
 		}
+		// entry of the transposed block, looked up once here instead of on every symmetrization
+		TransposeCompressedID.SetNumUninitialized(NumOfOffDiagEntries);
+		for (uint32 i = 0; i < Pattern.Size; i ++)
+		{
+			uint32 const StartIndex = i == 0 ? 0 : Pattern.PreSumNumEntriesOfRaw[i - 1];
+			for (uint32 Eid = StartIndex; Eid < Pattern.PreSumNumEntriesOfRaw[i]; Eid ++)
+			{
+				uint32 const *T = IDToCompressedID.Find(Pattern.ColIndexAtEntrance[Eid] * Pattern.Size + i);
+				TransposeCompressedID[Eid] = T ? int32(*T) : INDEX_NONE;
+			}
+		}
 		TempData.SetNumZeroed(Pattern.Size);
 		Compressed = true;
 	}
@@ -157,6 +169,13 @@ public:
 		}
 	}
 
+	// with a locked pattern, writes to different entries do not touch shared data,
+	// blocks of disjoint rows can be filled from different threads
+	bool IsPatternLocked() const
+	{
+		return IsLockPattern;
+	}
+
 	uint32 Size() const
 	{
 		return Pattern.Size;
@@ -182,6 +201,42 @@ public:
 		}
 	}
 	
+	// row I times a vector, under Compressed State
+	FORCEINLINE BlockType MulRow(uint32 const I, BlockType const* InData) const
+	{
+		uint32 const StartIndex = I == 0 ? 0 : Pattern.PreSumNumEntriesOfRaw[I - 1];
+		uint32 const EndIndex = Pattern.PreSumNumEntriesOfRaw[I];
+		BlockType Res = DiagData[I] * InData[I];
+		for (uint32 E = StartIndex; E < EndIndex; E ++)
+		{
+			uint32 const J = Pattern.ColIndexAtEntrance[E];
+			if (J != I)
+				Res += OffDiagData[E] * InData[J];
+		}
+		return Res;
+	}
+
+	// off diagonal part of row I times a vector, only on the columns J with Pred(J), under Compressed State
+	template <typename FPredicate>
+	FORCEINLINE BlockType MulRowOffDiagonal(uint32 const I, BlockType const* InData, FPredicate const& Pred) const
+	{
+		uint32 const StartIndex = I == 0 ? 0 : Pattern.PreSumNumEntriesOfRaw[I - 1];
+		uint32 const EndIndex = Pattern.PreSumNumEntriesOfRaw[I];
+		BlockType Res = BlockType();
+		for (uint32 E = StartIndex; E < EndIndex; E ++)
+		{
+			uint32 const J = Pattern.ColIndexAtEntrance[E];
+			if (J != I && Pred(J))
+				Res += OffDiagData[E] * InData[J];
+		}
+		return Res;
+	}
+
+	BlockType const& Diagonal(uint32 const I) const
+	{
+		return DiagData[I];
+	}
+
 	// Apply Operation with another matrix that has same pattern
 	bool Execute(FRTBBSSMatrix & OutMat, FRTBBSSMatrix const& InMat,
 		TFunction<float(int32, float, float)> const& Diag,
@@ -199,6 +254,48 @@ public:
 		return true;
 	}
 
+	// Sparse Broyden (Schubert) update towards M * S = Y, keeping the locked pattern:
+	// row I += (Y[I] - M_I S) S_I^T / (S_I^T S_I), S_I is S on the columns of row I.
+	// The pattern is symmetric, entries are averaged with their transposes afterwards
+	void SparseBroydenUpdate(BlockType const* S, BlockType const* Y)
+	{
+		check(Compressed);
+		for (uint32 I = 0; I < Pattern.Size; I ++)
+		{
+			uint32 const StartIndex = I == 0 ? 0 : Pattern.PreSumNumEntriesOfRaw[I - 1];
+			uint32 const EndIndex = Pattern.PreSumNumEntriesOfRaw[I];
+			BlockType MS = DiagData[I] * S[I];
+			BlockType SS = S[I] * S[I];
+			for (uint32 E = StartIndex; E < EndIndex; E ++)
+			{
+				uint32 const J = Pattern.ColIndexAtEntrance[E];
+				MS += OffDiagData[E] * S[J];
+				SS += S[J] * S[J];
+			}
+			if (!(SS > 0)) continue;
+			BlockType const Scale = (Y[I] - MS) / SS;
+			DiagData[I] += Scale * S[I];
+			for (uint32 E = StartIndex; E < EndIndex; E ++)
+			{
+				OffDiagData[E] += Scale * S[Pattern.ColIndexAtEntrance[E]];
+			}
+		}
+		for (uint32 I = 0; I < Pattern.Size; I ++)
+		{
+			uint32 const StartIndex = I == 0 ? 0 : Pattern.PreSumNumEntriesOfRaw[I - 1];
+			uint32 const EndIndex = Pattern.PreSumNumEntriesOfRaw[I];
+			for (uint32 E = StartIndex; E < EndIndex; E ++)
+			{
+				uint32 const J = Pattern.ColIndexAtEntrance[E];
+				int32 const T = TransposeCompressedID[E];
+				if (J <= I || T == INDEX_NONE) continue;
+				BlockType const Mean = (OffDiagData[E] + OffDiagData[T]) * 0.5f;
+				OffDiagData[E] = Mean;
+				OffDiagData[T] = Mean;
+			}
+		}
+	}
+
 	// Set zero
 	void SetValues(BlockType Value)
 	{
@@ -218,12 +315,21 @@ public:
 		}
 	}
 	
+	// copy the values of a matrix with the same locked pattern
+	void CopyValues(FRTBBSSMatrix const& Other)
+	{
+		check(Compressed && Other.Compressed && OffDiagData.Num() == Other.OffDiagData.Num());
+		DiagData = Other.DiagData;
+		OffDiagData = Other.OffDiagData;
+	}
+
 	static FRTBBSSMatrix MatrixFromOtherPattern(FRTBBSSMatrix const& Other)
 	{
 		FRTBBSSMatrix Res;
 		Res.Compressed = true;
 		Res.IsLockPattern = true;
 		Res.IDToCompressedID = Other.IDToCompressedID;
+		Res.TransposeCompressedID = Other.TransposeCompressedID;
 		Res.Pattern = Other.Pattern;
 		Res.DiagData.SetNumZeroed(Res.Pattern.Size);
 		Res.OffDiagData.SetNumZeroed(Res.Pattern.PreSumNumEntriesOfRaw.Last());
@@ -235,6 +341,8 @@ private:
 	bool IsLockPattern = false;
 	TArray<TMap<uint32, BlockType>> TempData;
 	TMap<uint32, uint32> IDToCompressedID;
+	// compressed id of the transposed entry of each off-diagonal entry, INDEX_NONE if it is not in the pattern
+	TArray<int32> TransposeCompressedID;
 	FrtSparsePattern Pattern;
 	TArray<BlockType> OffDiagData;
 	TArray<BlockType> DiagData;
@@ -10,26 +10,76 @@ public:
 	virtual void Solve(FRTBBSSMatrix<float> & A, TArray<float> const& B, TArray<float> &X) override;
 	virtual ~FModifiedCGSolver() override;
 
-	virtual void UpdateConstraints(TArray<uint32> const&Ids, TArray<FRTMatrix3> const& Mats) override
+	virtual void UpdateConstraints(TArray<int32> const&Ids, TArray<FRTMatrix3> const& Mats) override
 	{
 		ConstraintIds = Ids;
 		ConstraintMats = Mats;
+		UpdateIslandConstraints();
 	}
 
 	virtual void UpdateVelocityConstraints(FVector const& Vel) override
 	{
 		VelConstraint = Vel;
 	}
+
+	// each island runs its own iterations and convergence check, islands are solved in parallel
+	virtual void SetIslands(TArray<int32> const& Offsets, TArray<int32> const& Vertices) override;
+
+	virtual void SetSkippedIslands(TArray<uint8> const* Skipped) override
+	{
+		SkippedIslands = Skipped;
+	}
+
+	// additive Schwarz preconditioner: the rows of each island are grouped by the subdomain of their vertex,
+	// each subdomain applies LocalSweeps symmetric Gauss-Seidel sweeps on its own block of A, couplings between subdomains
+	// are dropped. Subdomains run in parallel in every step of the iterations.
+	// Without subdomains or with zero sweeps P is the diagonal of A
+	virtual void SetSubdomains(TArray<int32> const& VertexSubdomains, int32 InLocalSweeps) override;
 	
 private:
+	// conjugate gradients on rows [RowOffsets[Island], RowOffsets[Island + 1]) of Rows, returns the iterations
+	uint32 SolveIsland(int32 Island, FRTBBSSMatrix<float> const& A, TArray<float> const& B, TArray<float> &X);
 
-	void Precondition(TArray<float> const&In, bool Inverse, TArray<float> &Out);
-	void Filter(TArray<float> &Out);
+	// Out = P^-1 In on the rows of a block
+	void Precondition(int32 Block, FRTBBSSMatrix<float> const& A, TArray<float> const&In, TArray<float> &Out) const;
+	// apply the constraints of an island
+	void Filter(int32 Island, TArray<float> &Out) const;
+	float Dot(int32 Island, TArray<float> const& U, TArray<float> const& V) const;
+
+	// call Body(Block, Begin, End) on the blocks of an island in parallel, [Begin, End) are positions in Rows
+	template <typename FBody>
+	void ForEachBlock(int32 Island, FBody const& Body) const;
+
+	// sort the constraints by island
+	void UpdateIslandConstraints();
+	// group the rows of each island by subdomain
+	void UpdateBlocks();
 	
-	TArray<uint32> ConstraintIds;
+	TArray<int32> ConstraintIds;
 	TArray<FRTMatrix3> ConstraintMats;
 	FVector VelConstraint;
 
+	// rows of the islands, all rows in one island when islands are not set
+	TArray<int32> VertexIslands;
+	TArray<int32> RowOffsets;
+	TArray<uint32> Rows;
+	// [ConstraintOffsets[i], ConstraintOffsets[i + 1]) of IslandConstraints are the constraints of island i
+	TArray<int32> ConstraintOffsets;
+	TArray<int32> IslandConstraints;
+	TArray<uint8> const* SkippedIslands = nullptr;
+
+	// subdomain of each vertex, empty without domain decomposition
+	TArray<int32> Subdomains;
+	int32 LocalSweeps = 0;
+	// [BlockOffsets[b], BlockOffsets[b + 1]) of Rows are the rows of block b (a subdomain within an island),
+	// [IslandBlocks[i], IslandBlocks[i + 1]) are the blocks of island i
+	TArray<int32> BlockOffsets;
+	TArray<int32> IslandBlocks;
+	// block of each row
+	TArray<int32> RowBlocks;
+	// partial sums of the dot products
+	mutable TArray<float> BlockSums;
+
 	// Precondition
 	TArray<float> P;
 	
@@ -24,6 +24,8 @@ struct FClothRawMesh
 		TangentZArray = std::move(Other.TangentZArray);
 		Colors = std::move(Other.Colors);
 		Indices = std::move(Other.Indices);
+		StiffnessScale = std::move(Other.StiffnessScale);
+		DampingScale = std::move(Other.DampingScale);
 		LocalToWorld = Other.LocalToWorld;
 		return *this;
 	}
@@ -34,6 +36,9 @@ struct FClothRawMesh
 	TArray<FVector> TangentZArray;
 	TArray<FColor> Colors;
 	TArray<uint32> Indices;
+	// painted per vertex multipliers of the stiffness and damping of all conditions, empty when not painted
+	TArray<float> StiffnessScale;
+	TArray<float> DampingScale;
 	FTransform LocalToWorld;
 };
 
@@ -94,6 +99,8 @@ static const float Q_rsqrt( float number )
 }
 
 // computed only once
+// wu, wv are linear in the positions, dwudX[i] = dwudXScalar[i] * I and dwvdX[i] = dwvdXScalar[i] * I,
+// so the conditions keep the scalars and no 3x3 matrices. no virtual functions, the conditions call UpdateTangents directly
 struct FClothTriangleProperties : public FClothTriangleStaticProperties
 {
 public:
@@ -101,25 +108,14 @@ public:
 	FVector wu, wv;
 	float wuNorm = 0, wvNorm = 0;
 
-	// partial derivatives of Wu Wv on Three Positions:
-	FRTMatrix3 dwudX[3];
-	FRTMatrix3 dwvdX[3];
-
 	FClothTriangleProperties (
 		const int P0, const int P1, const int P2, 
 		const FVector2D &uv0, const FVector2D &uv1, const FVector2D &uv2
 	) : FClothTriangleStaticProperties(P0, P1, P2, uv0, uv1, uv2)
 	{
-		for (uint32 i = 0; i < 3; i ++)
-		{
-			dwudX[i] = FRTMatrix3::Diag(dwudXScalar[i]);
-			dwvdX[i] = FRTMatrix3::Diag(dwvdXScalar[i]);
-		}
 	}
 
-	virtual ~FClothTriangleProperties() {}
-
-	virtual void Update(const FVector &P0, const FVector &P1, const FVector &P2, const FVector& V0, const FVector& V1, const FVector& V2)
+	void UpdateTangents(const FVector &P0, const FVector &P1, const FVector &P2)
 	{
 		// trangle tangents in reference directions:
 		wu = ((P1 - P0) * dv2 - (P2 - P0) * dv1) / d;
@@ -4,8 +4,10 @@
 
 #include "RTClothStructures.h"
 #include "FRTClothSystemBase.h"
+#include "FRTStepController.h"
 
 #include "CoreMinimal.h"
+#include "Async/Future.h"
 #include "UObject/ObjectMacros.h"
 #include "Components/MeshComponent.h"
 #include "Components/BoxComponent.h"
@@ -20,7 +22,27 @@ enum FRTClothSolverType
 	CPU_Verlet,
 	CPU_Implicit,
 	CPU_Leapfrog,
-	GPU_Verlet
+	GPU_Verlet,
+	CPU_ProjectiveDynamics,
+	CPU_XPBD
+};
+
+// see ERTRenderSmoothing
+UENUM()
+enum FRTClothRenderSmoothing
+{
+	RenderLatest,
+	RenderInterpolate,
+	RenderExtrapolate
+};
+
+// see ERTScatterMode, Fastest times both modes when the cloth is set up
+UENUM()
+enum FRTClothScatterMode
+{
+	ScatterFastest,
+	ScatterColoring,
+	ScatterPrivateBuffers
 };
 
 //This is a mesh effect component
@@ -82,6 +104,152 @@ public:
 	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="WindVelocity", ClampMin="0", ClampMax="1000"))
 	FVector WindVelocity = {0, 0, 0};
 
+	// CPU solvers: clamp the principal stretch of each triangle after integration, 0 is off
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Max Stretch", ClampMin="0", ClampMax="10"))
+	float MaxStretch = 0;
+
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Min Stretch", ClampMin="0", ClampMax="1"))
+	float MinStretch = 0;
+
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Strain Limit Iterations", ClampMin="0", ClampMax="100"))
+	int32 StrainLimitIterations = 4;
+
+	// implicit solver only: refresh the force derivatives every N steps, 1 refreshes every step
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Hessian Refresh Interval", ClampMin="1", ClampMax="100"))
+	int32 HessianRefreshInterval = 1;
+
+	// implicit solver only: refresh early when the strain changed more than this
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Hessian Refresh Strain", ClampMin="0", ClampMax="1"))
+	float HessianRefreshStrain = 0.05;
+
+	// implicit solver only: Broyden updates of the reused derivatives
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Hessian Broyden Update"))
+	bool HessianBroydenUpdate = false;
+
+	// implicit solver only: Newton iterations of each step with a backtracking line search, 1 is the single linearized solve
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Newton Iterations", ClampMin="1", ClampMax="20"))
+	int32 NewtonIterations = 1;
+
+	// implicit solver only: stop the Newton iterations when the largest velocity change is below this
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Newton Tolerance", ClampMin="0"))
+	float NewtonTolerance = 0.1;
+
+	// implicit solver only: halvings of a Newton step before the iterations stop
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Newton Line Search Steps", ClampMin="0", ClampMax="20"))
+	int32 NewtonLineSearchSteps = 5;
+
+	// implicit solver only: partition the mesh into this many subdomains, preconditioned and solved in parallel, for large meshes
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Subdomains", ClampMin="1", ClampMax="256"))
+	int32 Subdomains = 1;
+
+	// implicit solver only: symmetric Gauss-Seidel sweeps of the local solve in each subdomain, fewer iterations for more work each.
+	// 0 keeps the diagonal preconditioner
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Subdomain Sweeps", ClampMin="0", ClampMax="10"))
+	int32 SubdomainSweeps = 1;
+
+	// implicit solver only: quadratic bending with a constant Hessian, for nearly flat cloth, InitTheta is ignored
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Quadratic Bend"))
+	bool QuadraticBend = false;
+
+	// implicit solver only: co-rotational FEM membrane instead of the stretch and shear conditions
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Corotational Membrane"))
+	bool CorotationalMembrane = false;
+
+	// projective dynamics and XPBD solvers: local / global iterations or Gauss-Seidel sweeps per tick
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Solver Iterations", ClampMin="1", ClampMax="100"))
+	int32 SolverIterations = 10;
+
+	// projective dynamics solver only: Chebyshev acceleration of the local / global iterations
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Chebyshev Acceleration"))
+	bool ChebyshevAcceleration = false;
+
+	// spectral radius of the iterations for Chebyshev acceleration, 0 estimates it over the first ticks
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Chebyshev Spectral Radius", ClampMin="0", ClampMax="0.9999"))
+	float ChebyshevSpectralRadius = 0;
+
+	// CPU solvers: scale K and D per vertex by the painted vertex colors of the mesh,
+	// red from Stiffness Map Min to Max, green from Damping Map Min to Max
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Stiffness From Vertex Color"))
+	bool StiffnessFromVertexColor = false;
+
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Stiffness Map Min", ClampMin="0", ClampMax="100"))
+	float StiffnessMapMin = 1;
+
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Stiffness Map Max", ClampMin="0", ClampMax="100"))
+	float StiffnessMapMax = 4;
+
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Damping Map Min", ClampMin="0", ClampMax="100"))
+	float DampingMapMin = 1;
+
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Damping Map Max", ClampMin="0", ClampMax="100"))
+	float DampingMapMax = 4;
+
+	// simulated time per substep, each frame runs the whole substeps of its time and carries the remainder
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Fixed Time Step", ClampMin="0.001", ClampMax="0.05"))
+	float FixedTimeStep = 0.005;
+
+	// substeps per frame at most, a slower frame drops the time it can not catch up with
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Max Sub Steps", ClampMin="1", ClampMax="64"))
+	int32 MaxSubSteps = 8;
+
+	// pick each substep from the motion of the last one, within Min Time Step and Max Time Step,
+	// Fixed Time Step is the first step. not supported by GPU Verlet, which assumes a constant step
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Adaptive Time Step"))
+	bool AdaptiveTimeStep = false;
+
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Min Time Step", ClampMin="0.0005", ClampMax="0.05"))
+	float MinTimeStep = 0.002;
+
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Max Time Step", ClampMin="0.001", ClampMax="0.05"))
+	float MaxTimeStep = 0.02;
+
+	// adaptive time step: largest change of the stretch of an edge per step
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Max Strain Change", ClampMin="0.001", ClampMax="1"))
+	float MaxStrainChange = 0.01;
+
+	// adaptive time step: largest move of a vertex per step, in shortest edges of the mesh
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Max Motion", ClampMin="0.01", ClampMax="10"))
+	float MaxMotion = 0.25;
+
+	// adaptive time step: collisions deeper than this, in shortest edges of the mesh, halve the step
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Max Penetration", ClampMin="0.001", ClampMax="10"))
+	float MaxPenetration = 0.1;
+
+	// CPU solvers: stop simulating and uploading once the cloth stays slower than Sleep Speed for Sleep Frames frames,
+	// a move of the cloth, a change of the wind or a collider wakes it up
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Enable Sleep"))
+	bool EnableSleep = false;
+
+	// rms speed of the vertices below which the cloth counts as resting, cm/s
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Sleep Speed", ClampMin="0", ClampMax="100"))
+	float SleepSpeed = 0.5;
+
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Sleep Frames", ClampMin="1", ClampMax="600"))
+	int32 SleepFrames = 60;
+
+	// CPU solvers: simulate each frame on a worker thread. The game and render threads never wait for it,
+	// they show the last finished frame, which lags the game by a frame
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Async Simulation"))
+	bool AsyncSimulation = true;
+
+	// CPU Verlet and Leapfrog: how parallel force passes write forces. The modes sum forces in different orders,
+	// Fastest can pick another one on the next run, pin a mode for results that repeat
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Scatter Mode"))
+	TEnumAsByte<FRTClothScatterMode> ScatterMode = ScatterFastest;
+
+	// draw the cloth at the display time between simulated frames: blend the two latest frames (one frame behind),
+	// or extrapolate the latest frame along its velocities. Lets a larger Fixed Time Step run below the display rate
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Render Smoothing"))
+	TEnumAsByte<FRTClothRenderSmoothing> RenderSmoothing = RenderLatest;
+
+	// predicted time from the tick to the display of the frame, added to the display time, s
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Display Latency", ClampMin="0", ClampMax="0.1"))
+	float DisplayLatency = 0;
+
+	// extrapolation stops this far past the latest simulated frame, s
+	UPROPERTY(EditAnywhere, Category = ClothParameters, meta=(DisplayName="Max Extrapolation", ClampMin="0", ClampMax="0.1"))
+	float MaxExtrapolation = 0.03;
+
 private:
 	// setup cloth mesh and cloth system in RenderThread
 	bool SetupCloth_CPU(UStaticMesh *OriginalMesh) const;
@@ -104,10 +272,38 @@ private:
 	// Render Data Pass Through
 	virtual void SendRenderDynamicData_Concurrent() override;
 	virtual void CreateRenderState_Concurrent(FRegisterComponentContext* Context) override;
+
+	// substeps of the time since the last frame, then EndFrame and PublishPositions.
+	// runs on the render thread, or on a worker thread when simulating async
+	// FrameEndTime is GameTime at the end of the frame
+	void SimulateFrame(FTransform const& FrameStartTransform, FTransform const& Transform, float DeltaTime, double FrameEndTime);
+	// wait for the frame in flight, call before the game thread touches ClothSystem or ClothMesh
+	void WaitForSimulation();
+	void UpdateHitBox();
+
 	std::shared_ptr<FClothRawMesh> ClothMesh;
 	std::unique_ptr<FRTClothSystemBase> ClothSystem;
 
 	UBoxComponent *HitBox = nullptr;
+
+	// time not simulated yet, less than the current step
+	float TimeAccumulator = 0;
+	// AdaptiveTimeStep with a solver that supports it
+	bool bAdaptive = false;
+	// step of the next substep, FixedTimeStep unless bAdaptive
+	float CurrentTimeStep = 0.005;
+	FRTStepController StepController;
+	// transform of the cloth at the end of the last frame, substeps blend from it to the current one
+	FTransform PreviousTransform;
+
+	// AsyncSimulation with a CPU solver
+	bool bAsync = false;
+	// frame in flight on a worker thread
+	TFuture<void> SimulationTask;
+	// time of the ticks that passed while a frame was in flight, simulated with the next frame
+	float PendingTime = 0;
+	// sum of the tick times since the cloth was set up, the clock of the published frames and the display time
+	double GameTime = 0;
 	
 	UFUNCTION()
 	void OnOverLapBegin(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult & SweepResult);